@@ -0,0 +1,153 @@
+//this file contains a scaling benchmark of the job system. Every workload runs with 1,
+//2, 4 ... threads up to the maximum, rows past the cores of the machine oversubscribe
+//them:
+//	job_bench [-n iterations] [-m max threads] [-s size]
+//	uniform: parallelFor building model matrices, the same work per index
+//	irregular: parallelFor where the work per index varies by 64 times, stealing
+//		has to even it out
+//	jobs: tiny jobs on one counter, the cost of queueing and running a job
+//	regions: many short parallelFor calls, against starting threads for each like the
+//		thread pools the job system replaced
+#include "../include/job_system.h"
+#include "../include/glm/glm.hpp"
+#include "../include/glm/gtc/matrix_transform.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace glm;
+
+static const int REGIONS = 200;
+
+static double now(){
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void uniform(vector<mat4> &models){
+	JobSystem::parallelFor(0, models.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i ++) {
+			mat4 model = translate(mat4(), vec3((float)i, 0.0f, 0.0f));
+			model = rotate(model, radians(0.01f * i), vec3(1.0f, 0.3f, 0.5f));
+			models[i] = scale(model, vec3(0.5f));
+		}
+	});
+}
+
+static void irregular(vector<float> &out){
+	JobSystem::parallelFor(0, out.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i ++) {
+			//blocks of 4096 indices cost from 1 to 64 units
+			int units = 1 + (int)((i / 4096 * 2654435761u) >> 7 & 63);
+			float x = (float)i;
+			for (int u = 0; u < units; u ++)
+				x = x * 0.999f + 0.5f;
+			out[i] = x;
+		}
+	});
+}
+
+static atomic<size_t> ran(0);
+static void tinyJob(void *data){
+	ran.fetch_add(1, memory_order_relaxed);
+}
+
+static void jobs(size_t count){
+	JobCounter counter;
+	for (size_t i = 0; i < count; i ++)
+		JobSystem::run(tinyJob, NULL, &counter);
+	JobSystem::wait(counter);
+}
+
+static void region(vector<float> &data, size_t begin, size_t end){
+	for (size_t i = begin; i < end; i ++)
+		data[i] = data[i] * 0.5f + 1.0f;
+}
+
+//the pattern of the old thread pools, threads started and joined for every call
+static void spawnRegion(vector<float> &data, int threads){
+	atomic<size_t> next(0);
+	const size_t chunk = 4096;
+	auto work = [&]() {
+		for (size_t begin = next.fetch_add(chunk); begin < data.size();
+			begin = next.fetch_add(chunk))
+			region(data, begin, std::min(data.size(), begin + chunk));
+	};
+	vector<thread> workers;
+	for (int t = 1; t < threads; t ++)
+		workers.push_back(thread(work));
+	work();
+	for (size_t t = 0; t < workers.size(); t ++)
+		workers[t].join();
+}
+
+int main(int argc, char **argv){
+	int iterations = 5, max_threads = 64;
+	size_t size = 1 << 20;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			max_threads = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			size = (size_t)std::max(1024, atoi(argv[++i]));
+		else
+		{
+			cout << "usage: job_bench [-n iterations] [-m max threads] [-s size]" << endl;
+			return 1;
+		}
+	}
+	int cores = std::max(1u, thread::hardware_concurrency());
+	vector<mat4> models(size / 4);
+	vector<float> values(size), small(size / 16, 1.0f);
+
+	cout << cores << " cores, best of " << iterations << " runs, speedup against 1 thread"
+		<< endl << fixed;
+	cout << setw(8) << "threads" << setw(21) << "uniform" << setw(21) << "irregular"
+		<< setw(21) << "jobs" << setw(21) << "regions" << setw(21) << "regions spawned"
+		<< endl;
+	double base[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		JobSystem::init(threads);
+		double best[5] = {1e9, 1e9, 1e9, 1e9, 1e9};
+		for (int it = 0; it < iterations; it ++) {
+			double start = now();
+			uniform(models);
+			double t1 = now();
+			irregular(values);
+			double t2 = now();
+			jobs(size / 16);
+			double t3 = now();
+			for (int r = 0; r < REGIONS; r ++)
+				JobSystem::parallelFor(0, small.size(), [&](size_t begin, size_t end) {
+					region(small, begin, end);
+				});
+			double t4 = now();
+			for (int r = 0; r < REGIONS; r ++)
+				spawnRegion(small, threads);
+			double t5 = now();
+			double times[5] = {t1 - start, t2 - t1, t3 - t2, t4 - t3, t5 - t4};
+			for (int w = 0; w < 5; w ++)
+				best[w] = std::min(best[w], times[w]);
+		}
+		JobStats stats = JobSystem::stats();
+		JobSystem::shutdown();
+		if (threads == 1)
+			copy(best, best + 5, base);
+		cout << setw(7) << threads << (threads > cores ? "*" : " ");
+		for (int w = 0; w < 5; w ++)
+			cout << setw(11) << setprecision(2) << best[w] * 1000.0 << " ms "
+				<< setw(5) << setprecision(1) << base[w] / best[w] << "x";
+		cout << "  " << stats.steals << " steals, " << stats.splits << " splits" << endl;
+	}
+	cout << "* more threads than cores" << endl;
+	cout << setprecision(3) << "jobs: " << size / 16 << " per run, "
+		<< base[2] / (size / 16) * 1e9 << " ns per job on 1 thread" << endl;
+	return 0;
+}
@@ -0,0 +1,87 @@
+//this file contains a benchmark of the stb_image JPEG decoder, single threaded
+//against ParallelDecode. Run it from the repository root:
+//	jpeg_bench [-n iterations] [-t threads] file.jpg ...
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb_image.h"
+#include "../include/parallel_decode.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+//best time of a number of decodes from memory, so file IO isn't measured
+static double decodeSeconds(const vector<unsigned char> &file, int iterations,
+	vector<unsigned char> &pixels, int &width, int &height){
+	double best = 1e30;
+	for (int i = 0; i < iterations; i ++) {
+		int channels;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		unsigned char *data = stbi_load_from_memory(&file[0], file.size(), &width, &height,
+			&channels, STBI_rgb_alpha);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (data == NULL)
+			return -1.0;
+		best = min(best, seconds);
+		pixels.assign(data, data + (size_t)width * height * 4);
+		stbi_image_free(data);
+	}
+	return best;
+}
+
+int main(int argc, char **argv){
+	int iterations = 10, threads = 0;
+	vector<string> paths;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+		paths.push_back("resources/textures/container.jpg");
+
+	cout << fixed << setprecision(1);
+	for (size_t p = 0; p < paths.size(); p ++) {
+		ifstream in(paths[p].c_str(), ios::binary);
+		vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		if (file.empty())
+		{
+			cout << "Failed to read " << paths[p] << endl;
+			continue;
+		}
+
+		int width = 0, height = 0;
+		vector<unsigned char> serial_pixels, parallel_pixels;
+		ParallelDecode::disable();
+		double serial = decodeSeconds(file, iterations, serial_pixels, width, height);
+		ParallelDecode::enable(threads);
+		double parallel = decodeSeconds(file, iterations, parallel_pixels, width, height);
+		if (serial < 0.0 || parallel < 0.0)
+		{
+			cout << "Failed to decode " << paths[p] << ": " << stbi_failure_reason() << endl;
+			continue;
+		}
+
+		double mb = file.size() / (1024.0 * 1024.0);
+		double mpixels = (double)width * height / 1e6;
+		cout << paths[p] << " " << width << "x" << height << ", " << ParallelDecode::threads()
+			<< " threads" << endl;
+		cout << "  stock:    " << serial * 1000.0 << " ms, " << mb / serial << " MB/s, "
+			<< mpixels / serial << " Mpixel/s" << endl;
+		cout << "  parallel: " << parallel * 1000.0 << " ms, " << mb / parallel << " MB/s, "
+			<< mpixels / parallel << " Mpixel/s" << endl;
+		cout << "  speedup " << setprecision(2) << serial / parallel << "x, output "
+			<< (serial_pixels == parallel_pixels ? "identical" : "DIFFERS") << endl;
+		cout << setprecision(1);
+	}
+	return 0;
+}
@@ -0,0 +1,135 @@
+//this file contains a benchmark of the mesh importer and of loading cooked meshes. It
+//imports an OBJ file, or writes a sphere of about a million triangles when none is
+//given, on one thread and on every core, then cooks it and loads the result from disk
+//and from a mapped asset pack:
+//	mesh_bench [-n iterations] [-t threads] [-s sphere rings] [mesh.obj|gltf|glb]
+#include "../include/mesh_import.h"
+#include "../include/asset_pack.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+//a UV sphere of rings * 2 rings segments, 4 * rings^2 triangles, with texture
+//coordinates and normals like an exporter writes them
+static void writeSphere(const char *path, int rings){
+	ofstream out(path);
+	int segments = rings * 2;
+	out << fixed << setprecision(6);
+	for (int r = 0; r <= rings; r ++)
+		for (int s = 0; s <= segments; s ++) {
+			double theta = M_PI * r / rings, phi = 2.0 * M_PI * s / segments;
+			double x = sin(theta) * cos(phi), y = cos(theta), z = sin(theta) * sin(phi);
+			out << "v " << x << " " << y << " " << z << "\n";
+			out << "vt " << (double)s / segments << " " << 1.0 - (double)r / rings << "\n";
+			out << "vn " << x << " " << y << " " << z << "\n";
+		}
+	for (int r = 0; r < rings; r ++)
+		for (int s = 0; s < segments; s ++) {
+			int a = r * (segments + 1) + s + 1, b = a + segments + 1;
+			out << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b
+				<< " " << b + 1 << "/" << b + 1 << "/" << b + 1 << "\n";
+			out << "f " << a << "/" << a << "/" << a << " " << b + 1 << "/" << b + 1 << "/"
+				<< b + 1 << " " << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+		}
+}
+
+//best time of reading and checking a cooked mesh
+static double loadSeconds(const string &path, int iterations, size_t &bytes){
+	double best = 1e9;
+	for (int i = 0; i < iterations; i ++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		AssetData data;
+		const MeshFileHeader *header = NULL;
+		if (Vfs::read(path, data))
+			header = MeshFile::validate(data.data(), data.size());
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (header == NULL)
+		{
+			cout << "ERROR::MESH_BENCH::NOT_LOADED: " << path << endl;
+			return 0.0;
+		}
+		bytes = data.size();
+		best = min(best, seconds);
+	}
+	return best;
+}
+
+int main(int argc, char **argv){
+	int iterations = 5, threads = 0, rings = 500;
+	string path;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			rings = max(2, atoi(argv[++i]));
+		else if (argv[i][0] != '-' && path.empty())
+			path = argv[i];
+		else
+		{
+			cout << "usage: mesh_bench [-n iterations] [-t threads] [-s sphere rings] "
+				"[mesh.obj|gltf|glb]" << endl;
+			return 1;
+		}
+	}
+	if (threads <= 0)
+		threads = max(1, (int)thread::hardware_concurrency());
+	bool sphere = path.empty();
+	if (sphere)
+	{
+		path = "mesh_bench_sphere.obj";
+		writeSphere(path.c_str(), rings);
+	}
+
+	MeshData mesh;
+	MeshImportStats stats;
+	int thread_counts[2] = {1, threads};
+	for (int t = 0; t < (threads > 1 ? 2 : 1); t ++) {
+		if (!MeshImporter::import(path.c_str(), mesh, &stats, thread_counts[t]))
+			return 1;
+		stats.report();
+	}
+
+	const char *cooked = "mesh_bench.mesh", *pack = "mesh_bench.pack";
+	if (!MeshFile::write(cooked, mesh))
+	{
+		cout << "ERROR::MESH_FILE::NOT_WRITTEN: " << cooked << endl;
+		return 1;
+	}
+	size_t bytes = 0;
+	double disk = loadSeconds(cooked, iterations, bytes);
+	//the pack stores meshes uncompressed, reading one is a view of the mapping
+	vector<PackSource> files(1);
+	files[0].path = cooked;
+	files[0].name = cooked;
+	if (!AssetPack::write(pack, files, true) || !Vfs::mount(pack, "mesh_bench"))
+	{
+		cout << "ERROR::MESH_BENCH::PACK_NOT_WRITTEN: " << pack << endl;
+		return 1;
+	}
+	double mapped = loadSeconds(string("mesh_bench/") + cooked, iterations, bytes);
+	Vfs::unmount();
+
+	cout << fixed << setprecision(3) << bytes / 1048576.0 << " MB cooked, loaded in "
+		<< disk * 1000.0 << " ms from disk (" << setprecision(2)
+		<< (disk > 0.0 ? bytes / disk / 1e9 : 0.0) << " GB/s), " << setprecision(3)
+		<< mapped * 1000.0 << " ms from the pack, parsing took "
+		<< stats.parseSeconds * 1000.0 << " ms" << endl;
+	remove(cooked);
+	remove(pack);
+	if (sphere)
+		remove(path.c_str());
+	return 0;
+}
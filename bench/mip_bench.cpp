@@ -0,0 +1,74 @@
+//this file contains a benchmark of the CPU mip builder, every filter with and without
+//sRGB conversion. Run it from the repository root:
+//	mip_bench [-n iterations] [-t threads] [-a alpha cutoff] image ...
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb_image.h"
+#include "../include/mip_builder.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+int main(int argc, char **argv){
+	int iterations = 10, threads = 0;
+	float cutoff = 0.0f;
+	vector<string> paths;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+			cutoff = (float)atof(argv[++i]);
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+	{
+		paths.push_back("resources/textures/container.jpg");
+		paths.push_back("resources/textures/face.png");
+		paths.push_back("resources/textures/calm.png");
+	}
+
+	const char *filter_names[2] = {"box", "kaiser"};
+	cout << fixed << setprecision(1);
+	for (size_t p = 0; p < paths.size(); p ++) {
+		int width, height, channels;
+		unsigned char *pixels = stbi_load(paths[p].c_str(), &width, &height, &channels, 0);
+		if (pixels == NULL)
+		{
+			cout << "Failed to load " << paths[p] << endl;
+			continue;
+		}
+		cout << paths[p] << " " << width << "x" << height << ", " << channels << " channels"
+			<< endl;
+		for (int filter = MIP_BOX; filter <= MIP_KAISER; filter ++)
+			for (int srgb = 0; srgb < 2; srgb ++) {
+				MipOptions options;
+				options.filter = (MipFilter)filter;
+				options.srgb = srgb != 0;
+				options.alphaCutoff = cutoff;
+				options.threads = threads;
+				//best of a number of builds
+				MipStats best = {1e30, 0.0};
+				vector<MipLevel> levels;
+				for (int i = 0; i < iterations; i ++) {
+					MipStats stats;
+					MipBuilder::build(pixels, width, height, width * channels, channels, levels,
+						options, &stats);
+					if (stats.seconds < best.seconds)
+						best = stats;
+				}
+				cout << "  " << setw(6) << filter_names[filter] << (srgb ? " srgb:   " : " linear: ")
+					<< best.seconds * 1000.0 << " ms, " << best.mpixelsPerSecond << " Mpixel/s, "
+					<< levels.size() + 1 << " levels" << endl;
+			}
+		stbi_image_free(pixels);
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+//this file contains a benchmark of the CPU occlusion culler, it needs no window or GPU.
+//A camera looks over a row of walls at a field of cubes, the walls are the occluders
+//and every cube of the field is tested:
+//	occlusion_bench [-n frames] [-t threads] [-r width height] [-g grid size]
+#include "../include/occlusion_culler.h"
+#include "../include/glm/gtc/matrix_transform.hpp"
+#include "../include/data.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace glm;
+
+int main(int argc, char **argv){
+	int frames = 200, threads = 0, width = 256, height = 128, grid = 64;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			frames = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc)
+		{
+			width = std::max(8, atoi(argv[++i]));
+			height = std::max(4, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+			grid = std::max(1, atoi(argv[++i]));
+		else
+		{
+			cout << "usage: occlusion_bench [-n frames] [-t threads] [-r width height] "
+				"[-g grid size]" << endl;
+			return 1;
+		}
+	}
+
+	//walls with gaps between them, 4 units in front of the field
+	vector<mat4> walls;
+	for (int i = 0; i < 6; i ++) {
+		mat4 wall = translate(mat4(), vec3(-12.5f + i * 5.0f, 1.5f, -4.0f));
+		walls.push_back(scale(wall, vec3(4.0f, 3.0f, 0.5f)));
+	}
+	//unit cubes on the ground, their boxes are what gets tested
+	vector<vec3> cubes;
+	for (int z = 0; z < grid; z ++)
+		for (int x = 0; x < grid; x ++)
+			cubes.push_back(vec3((x - grid / 2) * 1.5f, 0.5f, -6.0f - z * 1.5f));
+
+	mat4 proj = perspective(radians(45.0f), 2.0f, 0.1f, 200.0f);
+	OcclusionCuller culler(width, height, threads);
+	size_t visible = 0;
+	for (int f = 0; f < frames; f ++) {
+		//sway the camera so that the gaps between the walls move over the field
+		float sway = std::sin(f * 0.05f) * 3.0f;
+		mat4 view = lookAt(vec3(sway, 1.5f, 2.0f), vec3(sway * 0.5f, 1.0f, -20.0f),
+			vec3(0.0f, 1.0f, 0.0f));
+		culler.begin(proj * view);
+		for (size_t w = 0; w < walls.size(); w ++)
+			culler.addOccluder(cube_vertices, 36, 5, walls[w]);
+		culler.rasterize();
+		for (size_t c = 0; c < cubes.size(); c ++)
+			if (culler.visible(cubes[c] - vec3(0.5f), cubes[c] + vec3(0.5f)))
+				visible ++;
+	}
+
+	cout << cubes.size() << " cubes behind " << walls.size() << " walls, " << culler.width()
+		<< "x" << culler.height() << " depth buffer, " << frames << " frames, "
+		<< fixed << setprecision(1) << (double)visible / frames << " cubes visible per frame"
+		<< endl;
+	culler.report();
+	return 0;
+}
@@ -0,0 +1,140 @@
+//this file contains a benchmark of the stb_image PNG decoder: inflate on its own, and
+//whole decodes with the SIMD unfilters against the scalar ones. Run it from the
+//repository root:
+//	png_bench [-n iterations] [-c channels] file.png ...
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb_image.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+//defined in png_scalar.cpp
+unsigned char *loadPngScalar(const unsigned char *file, int size, int *width, int *height,
+	int *channels, int desired);
+
+typedef unsigned char *(*LoadFunction)(const unsigned char *, int, int *, int *, int *, int);
+
+static unsigned char *loadPngSimd(const unsigned char *file, int size, int *width,
+	int *height, int *channels, int desired){
+	return stbi_load_from_memory(file, size, width, height, channels, desired);
+}
+
+//the zlib stream of a PNG, the IDAT chunks joined together
+static vector<unsigned char> idatStream(const vector<unsigned char> &file){
+	vector<unsigned char> stream;
+	size_t pos = 8;
+	while (pos + 12 <= file.size()) {
+		size_t length = (size_t)file[pos] << 24 | file[pos + 1] << 16 | file[pos + 2] << 8 |
+			file[pos + 3];
+		if (pos + 12 + length > file.size())
+			break;
+		if (memcmp(&file[pos + 4], "IDAT", 4) == 0)
+			stream.insert(stream.end(), file.begin() + pos + 8, file.begin() + pos + 8 + length);
+		pos += 12 + length;
+	}
+	return stream;
+}
+
+//best time of a number of inflates, -1 on failure
+static double inflateSeconds(const vector<unsigned char> &stream, int iterations, int &bytes){
+	double best = 1e30;
+	for (int i = 0; i < iterations; i ++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		char *data = stbi_zlib_decode_malloc((const char *)&stream[0], (int)stream.size(), &bytes);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (data == NULL)
+			return -1.0;
+		best = min(best, seconds);
+		free(data);
+	}
+	return best;
+}
+
+//best time of a number of decodes from memory, so file IO isn't measured
+static double decodeSeconds(LoadFunction load, const vector<unsigned char> &file,
+	int iterations, int desired, vector<unsigned char> &pixels, int &width, int &height){
+	double best = 1e30;
+	for (int i = 0; i < iterations; i ++) {
+		int channels;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		unsigned char *data = load(&file[0], (int)file.size(), &width, &height, &channels,
+			desired);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (data == NULL)
+			return -1.0;
+		best = min(best, seconds);
+		int n = desired ? desired : channels;
+		pixels.assign(data, data + (size_t)width * height * n);
+		stbi_image_free(data);
+	}
+	return best;
+}
+
+int main(int argc, char **argv){
+	int iterations = 10, desired = 0;
+	vector<string> paths;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			iterations = max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			desired = atoi(argv[++i]);
+		else
+			paths.push_back(argv[i]);
+	}
+	if (paths.empty())
+	{
+		paths.push_back("resources/textures/face.png");
+		paths.push_back("resources/textures/calm.png");
+	}
+
+	double totalScalar = 0.0, totalSimd = 0.0;
+	cout << fixed << setprecision(1);
+	for (size_t p = 0; p < paths.size(); p ++) {
+		ifstream in(paths[p].c_str(), ios::binary);
+		vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		vector<unsigned char> stream = idatStream(file);
+		if (stream.empty())
+		{
+			cout << "Failed to read " << paths[p] << endl;
+			continue;
+		}
+
+		int width = 0, height = 0, inflated = 0;
+		vector<unsigned char> scalarPixels, simdPixels;
+		double inflate = inflateSeconds(stream, iterations, inflated);
+		double scalar = decodeSeconds(loadPngScalar, file, iterations, desired, scalarPixels,
+			width, height);
+		double simd = decodeSeconds(loadPngSimd, file, iterations, desired, simdPixels,
+			width, height);
+		if (inflate < 0.0 || scalar < 0.0 || simd < 0.0)
+		{
+			cout << "Failed to decode " << paths[p] << ": " << stbi_failure_reason() << endl;
+			continue;
+		}
+		totalScalar += scalar;
+		totalSimd += simd;
+
+		double mpixels = (double)width * height / 1e6;
+		cout << paths[p] << " " << width << "x" << height << endl;
+		cout << "  inflate: " << inflate * 1000.0 << " ms, "
+			<< inflated / (1024.0 * 1024.0) / inflate << " MB/s out" << endl;
+		cout << "  scalar:  " << scalar * 1000.0 << " ms, " << mpixels / scalar
+			<< " Mpixel/s" << endl;
+		cout << "  simd:    " << simd * 1000.0 << " ms, " << mpixels / simd
+			<< " Mpixel/s" << endl;
+		cout << "  speedup " << setprecision(2) << scalar / simd << "x, output "
+			<< (scalarPixels == simdPixels ? "identical" : "DIFFERS") << endl;
+		cout << setprecision(1);
+	}
+	if (totalSimd > 0.0)
+		cout << "corpus: " << setprecision(2) << totalScalar / totalSimd << "x" << endl;
+	return 0;
+}
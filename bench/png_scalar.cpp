@@ -0,0 +1,20 @@
+//this file contains a second copy of stb_image with SIMD turned off, so that png_bench
+//can compare the SIMD unfilters against the scalar loops in one program
+#define STBI_NO_SIMD
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+//a static copy leaves every function png_bench doesn't call unused
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#include "../include/stb_image.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+unsigned char *loadPngScalar(const unsigned char *file, int size, int *width, int *height,
+	int *channels, int desired){
+	return stbi_load_from_memory(file, size, width, height, channels, desired);
+}
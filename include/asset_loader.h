@@ -0,0 +1,284 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+//this file contains asynchronous asset loading written as C++20 coroutines. A loader is
+//a coroutine returning Task<bool> that reads like the blocking code it replaces and
+//moves between threads at every co_await:
+//	AssetData file;
+//	if (!co_await AssetLoader::read(path, file))	//AsyncIO, no thread waits for it
+//		co_return false;
+//	co_await AssetLoader::onWorker();	//continue on a job system worker
+//	...decode...
+//	co_await AssetLoader::onGlThread();	//continue in pump() on the GL thread
+//	...upload...
+//	co_return true;
+//load() queues a loader as an AssetLoad. Loads start highest priority first while fewer
+//than maxLoads are running, so dozens of them overlap reading, decoding and uploading.
+//The GL thread calls pump() once per frame: it starts queued loads and resumes the
+//steps waiting for the GL thread, highest priority first, until its time budget is
+//spent. onGlThread() always waits for the next step, so a long upload can yield
+//between parts and spread over frames.
+//A cancelled load stops at its next co_await. Finished and cancelled loads are
+//destroyed in pump(), on the GL thread, so the locals of a loader may own GL objects.
+//Loaders and the tasks they await start suspended and run when they are awaited. Take
+//their parameters by value, a reference would outlive what it refers to.
+//Everything here needs C++20, the build enables it with -DASYNC_LOADING=ON.
+#ifdef ASYNC_LOADING
+#ifndef __cpp_impl_coroutine
+#error "ASYNC_LOADING needs a compiler with C++20 coroutines"
+#endif
+#include "asset_pack.h"
+#include "resource_manager.h"
+#include "mip_builder.h"
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+using namespace std;
+
+class AssetLoad;
+
+//what every Task promise has, the load the task runs for and the task awaiting it
+struct TaskPromise {
+	AssetLoad *load = NULL;
+	coroutine_handle<> continuation;
+
+	//resume the awaiting task, or hand a finished load back to pump()
+	struct FinalAwaiter {
+		bool await_ready() noexcept { return false; }
+		template <class Promise>
+		coroutine_handle<> await_suspend(coroutine_handle<Promise> task) noexcept;
+		void await_resume() noexcept {}
+	};
+	suspend_always initial_suspend() noexcept { return {}; }
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { terminate(); }
+};
+
+//a coroutine returning T. It starts when it is awaited and resumes the awaiting
+//coroutine when it returns, both run for the same load
+template <class T>
+class Task {
+public:
+	struct promise_type : TaskPromise {
+		T value = T();
+		Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+		void return_value(T result) { value = std::move(result); }
+	};
+
+	Task() {}
+	Task(Task &&other) : _handle(other._handle) { other._handle = nullptr; }
+	Task &operator=(Task &&other){
+		if (this != &other)
+		{
+			if (_handle)
+				_handle.destroy();
+			_handle = other._handle;
+			other._handle = nullptr;
+		}
+		return *this;
+	}
+	//destroying a task that didn't return destroys the tasks it awaits with it
+	~Task() { if (_handle) _handle.destroy(); }
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	bool valid() const { return (bool)_handle; }
+	bool done() const { return _handle && _handle.done(); }
+	//the returned value, once done()
+	T &result() { return _handle.promise().value; }
+
+	bool await_ready() const noexcept { return false; }
+	template <class Promise>
+	coroutine_handle<> await_suspend(coroutine_handle<Promise> caller) noexcept {
+		_handle.promise().load = caller.promise().load;
+		_handle.promise().continuation = caller;
+		return _handle;
+	}
+	T await_resume() { return std::move(_handle.promise().value); }
+
+private:
+	friend class AssetLoader;
+	explicit Task(coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+	coroutine_handle<promise_type> _handle;
+};
+
+enum LoadStatus {
+	LOAD_QUEUED,	//waiting for one of the maxLoads slots
+	LOAD_RUNNING,
+	LOAD_DONE,	//the loader returned true
+	LOAD_FAILED,	//the loader returned false
+	LOAD_CANCELLED
+};
+
+//called on the GL thread once a load is done, failed or was cancelled
+typedef function<void(AssetLoad &load)> LoadCallback;
+
+//one load, shared by its handle and the loader
+class AssetLoad {
+public:
+	const string &name() const { return _name; }
+	LoadStatus status() const { return (LoadStatus)_status.load(); }
+	bool finished() const { return status() >= LOAD_DONE; }
+	int priority() const { return _priority.load(); }
+	//higher runs first, it counts the next time the load waits to start or for the GL
+	//thread
+	void setPriority(int priority) { _priority.store(priority); }
+	//stop at the next co_await, a load that didn't start never runs
+	void cancel() { _cancelled.store(true); }
+	bool cancelled() const { return _cancelled.load(); }
+
+private:
+	friend class AssetLoader;
+	AssetLoad() : _priority(0), _cancelled(false), _status(LOAD_QUEUED), _finished(false) {}
+	AssetLoad(const AssetLoad &);
+	AssetLoad &operator=(const AssetLoad &);
+
+	string _name;
+	atomic<int> _priority;
+	atomic<bool> _cancelled;
+	atomic<int> _status;
+	Task<bool> _task;
+	LoadCallback _done;
+	coroutine_handle<> _resume;	//the innermost task, where the load continues
+	bool _finished;	//the outermost task returned
+	unsigned _order;	//of queueing, breaks priority ties
+	chrono::steady_clock::time_point _queued;
+};
+typedef shared_ptr<AssetLoad> LoadHandle;
+
+//counters since init()
+struct AssetLoaderStats {
+	size_t loads;	//queued with load()
+	size_t done, failed, cancelled;
+	int maxRunning;	//most loads running at once
+	size_t glSteps;	//steps pump() resumed on the GL thread
+	double glSeconds;	//time spent in those steps
+	double longestGlStep;
+	size_t jobsRun;	//jobs pump() ran because the job system had no other worker
+	double loadSeconds;	//summed time from load() to done of the loads that are done
+};
+
+class AssetLoader {
+public:
+	//PRE:
+	//	call it on the GL thread with the context current, after JobSystem::init()
+	//	maxLoads: loads running at once, the others wait by priority
+	static void init(int maxLoads = 32);
+	//cancel every load and pump until their tasks are destroyed, before
+	//JobSystem::shutdown() and while the context is current
+	static void shutdown();
+	static bool running();
+
+	//queue a loader, on the GL thread. It starts right away if a slot is free
+	//PRE:
+	//	name: shown in errors and the report
+	//	task: a coroutine that wasn't awaited, true when the asset is loaded
+	//	done: may be empty
+	static LoadHandle load(const string &name, Task<bool> task, int priority = 0,
+		LoadCallback done = LoadCallback());
+	//load a texture like ResourceManager::texture with CPU built mips, without the
+	//cache: read with AsyncIO, decoded and filtered on a worker and uploaded in pump()
+	//one level per step
+	//POST:
+	//	done gets the texture, an empty handle when it failed or was cancelled
+	static LoadHandle loadTexture(const string &path, function<void(const TextureHandle &texture)> done,
+		int priority = 0, bool srgb = false, MipFilter mipFilter = MIP_BOX);
+
+	//start queued loads and resume GL thread steps until seconds have passed, at
+	//least one step runs. Call it once per frame on the GL thread
+	static void pump(double seconds = 0.002);
+	//loads queued or running
+	static int pending();
+
+	static AssetLoaderStats stats();
+	static void report(ostream &out = cout);
+
+	//-----------------------------awaitables-------------------------------//
+
+	struct ReadAwaiter {
+		string path;
+		AssetData &data;
+		bool ok;
+		atomic<bool> arrived;	//set by the first of the completion and await_suspend
+		bool await_ready() const { return false; }
+		template <class Promise>
+		bool await_suspend(coroutine_handle<Promise> task){
+			return startRead(task.promise().load, task, *this);
+		}
+		bool await_resume() const { return ok; }
+	};
+	struct WorkerAwaiter {
+		//without the job system the load stays on its thread
+		bool await_ready() const;
+		template <class Promise>
+		void await_suspend(coroutine_handle<Promise> task){
+			schedule(task.promise().load, task, false);
+		}
+		void await_resume() const {}
+	};
+	struct GlThreadAwaiter {
+		bool await_ready() const { return false; }
+		template <class Promise>
+		void await_suspend(coroutine_handle<Promise> task){
+			schedule(task.promise().load, task, true);
+		}
+		void await_resume() const {}
+	};
+
+	//read a whole file with AsyncIO, the load continues on the thread that completed
+	//it, or on a worker when the job system runs
+	//POST:
+	//	data: the file, give it back with recycle() once it is decoded
+	//	co_await returns false if the file couldn't be read
+	static ReadAwaiter read(const string &path, AssetData &data){
+		return ReadAwaiter{path, data, false, {false}};
+	}
+	//continue on a job system worker, where decoding and other CPU work belong
+	static WorkerAwaiter onWorker() { return WorkerAwaiter(); }
+	//continue in the next step of pump() on the GL thread
+	static GlThreadAwaiter onGlThread() { return GlThreadAwaiter(); }
+	//give the buffer of a read back to the next reads
+	static void recycle(AssetData &data);
+
+	//the loader of loadTexture()
+	static Task<bool> texture(string path, shared_ptr<TextureHandle> out, bool srgb,
+		MipFilter mipFilter);
+
+private:
+	friend struct TaskPromise;
+
+	static bool startRead(AssetLoad *load, coroutine_handle<> task, ReadAwaiter &read);
+	//continue the load at task on a worker or the GL thread, cancelled loads go to
+	//the GL thread to be destroyed
+	static void schedule(AssetLoad *load, coroutine_handle<> task, bool glThread);
+	static void resumeJob(void *data);
+	//the outermost task of the load returned
+	static void finished(AssetLoad *load);
+	static void startLoads();
+	//run the callback of a load and destroy its tasks, on the GL thread
+	static void complete(AssetLoad *load, LoadStatus status);
+	template <class Load>
+	static size_t highest(const vector<Load> &loads);
+};
+
+template <class Promise>
+coroutine_handle<> TaskPromise::FinalAwaiter::await_suspend(coroutine_handle<Promise> task) noexcept {
+	TaskPromise &promise = task.promise();
+	if (promise.continuation)
+		return promise.continuation;
+	//the frame stays suspended until pump() destroys it, it isn't touched after this
+	if (promise.load != NULL)
+		AssetLoader::finished(promise.load);
+	return noop_coroutine();
+}
+
+#endif
+#endif
@@ -0,0 +1,170 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+//this file contains the asset pack, every file under resources/ in one archive that is
+//read through a memory mapping, and the Vfs that every asset read goes through.
+//A pack is laid out as
+//	PackHeader
+//	PackEntry[count], sorted by the hash of the name so a lookup is a binary search
+//	names, paths relative to the packed directory with '/' separators
+//	data of every entry, each starting at a multiple of PackHeader::alignment
+//Entries are stored as they are, or LZ4 compressed when that saves enough. Stored
+//entries are served straight from the mapping without a copy, cooked .mesh files are
+//always stored. Integers are little endian.
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+#define PACK_MAGIC "HPAK"
+static const uint32_t PACK_VERSION = 1;
+//entries start on cache lines
+static const uint32_t PACK_ALIGNMENT = 64;
+
+enum PackFlags {
+	PACK_COMPRESSED = 1	//LZ4 block, see lz4.h
+};
+
+struct PackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;	//entries
+	uint32_t alignment;	//of the entry data
+	uint64_t namesOffset;
+	uint64_t namesSize;
+};
+
+struct PackEntry {
+	uint64_t hash;	//hash64 of the name
+	uint64_t offset;	//of the data from the start of the pack
+	uint64_t size;	//bytes in the pack
+	uint64_t rawSize;	//bytes once decompressed
+	uint32_t nameOffset;	//into the names
+	uint32_t nameLength;
+	uint32_t flags;	//PackFlags
+	uint32_t reserved;
+};
+
+//bytes of an asset, either a view of a mapped pack or a buffer of its own
+class AssetData {
+public:
+	AssetData() : _data(NULL), _size(0) {}
+	const unsigned char *data() const { return _data; }
+	size_t size() const { return _size; }
+	//whether the bytes are a view of the pack, valid until it is closed
+	bool mapped() const { return _data != NULL && _buffer.empty(); }
+	void clear();
+	//exchange the bytes of two assets without copying them
+	void swap(AssetData &other);
+
+private:
+	//_data may point into _buffer
+	AssetData(const AssetData &);
+	AssetData &operator=(const AssetData &);
+
+	const unsigned char *_data;
+	size_t _size;
+	vector<unsigned char> _buffer;
+	friend class AssetPack;
+	friend class Vfs;
+	friend class AsyncIO;
+};
+
+//a file to put in a pack
+struct PackSource {
+	string path;	//on disk
+	string name;	//in the pack
+};
+
+class AssetPack {
+public:
+	AssetPack();
+	~AssetPack();
+
+	//map a pack and check its table of contents
+	//POST:
+	//	return false if the file is missing or isn't a valid pack
+	bool open(const char *path);
+	void close();
+	bool isOpen() const { return _base != NULL; }
+
+	//entry of a name, NULL if the pack doesn't have it
+	const PackEntry *find(const string &name) const;
+	//read an entry, stored entries are a view of the mapping
+	//POST:
+	//	return false if a compressed entry is corrupt
+	bool read(const PackEntry &entry, AssetData &out) const;
+	string name(const PackEntry &entry) const;
+	int count() const { return _header ? (int)_header->count : 0; }
+	const PackEntry *entries() const { return _entries; }
+	size_t mappedBytes() const { return _size; }
+
+	//write a pack
+	//PRE:
+	//	files: names must be unique
+	//	compress: LZ4 compress the entries that shrink by at least an eighth, except
+	//	.mesh files
+	//POST:
+	//	return false if a file can't be read or the pack can't be written
+	static bool write(const char *path, const vector<PackSource> &files, bool compress,
+		ostream &log = cout);
+
+private:
+	AssetPack(const AssetPack &);
+	AssetPack &operator=(const AssetPack &);
+
+	const unsigned char *_base;
+	size_t _size;
+	const PackHeader *_header;
+	const PackEntry *_entries;
+	const char *_names;
+#ifdef _WIN32
+	void *_file, *_mapping;
+#endif
+};
+
+//counters since the start of the program
+struct VfsStats {
+	size_t packReads;	//assets served from the pack
+	size_t mappedBytes;	//bytes served without a copy
+	size_t decompressedBytes;	//bytes of compressed entries after decompression
+	size_t diskReads;	//assets read from loose files
+	size_t diskBytes;
+	size_t prefetched;	//reads served by a prefetch, see expect()
+};
+
+class Vfs {
+public:
+	//mount a pack built from the directory root, "root/a/b.png" is then read from its
+	//entry "a/b.png". Paths outside root and files the pack doesn't have are still read
+	//from disk. Don't mount or unmount while other threads read
+	//PRE:
+	//	root: directory as the program names it, eg. "../resources"
+	static bool mount(const char *packPath, const string &root);
+	static void unmount();
+
+	//read a whole file, from the pack if it has it. Safe to call from any thread
+	static bool read(const string &path, AssetData &out);
+	//read a file only if the mounted pack has it
+	static bool readPacked(const string &path, AssetData &out);
+
+	//announce that a read of path is in flight elsewhere, eg. AsyncIO::prefetch. The
+	//next read() of the path waits for fulfill() and takes its bytes instead of
+	//reading the file again
+	static void expect(const string &path);
+	static void fulfill(const string &path, AssetData &data, bool ok);
+	//forget the expected reads no read() took, once the loads that were prefetched for
+	//are done. Their bytes are freed and later reads skip the lookup again. Reads still
+	//in flight are dropped when they are fulfilled
+	static void clearExpected();
+
+	//"a/./b/../c" -> "a/c", backslashes become slashes
+	static string normalize(const string &path);
+
+	static VfsStats stats();
+	static void report(ostream &out = cout);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+//this file contains asynchronous whole-file reads. Reads are queued with read() and
+//handed over in one batch with submit(), so many files are in flight at once instead
+//of one blocking read after the other. On Linux they go to the kernel through
+//io_uring; where io_uring isn't available (old kernels, seccomp filters, other
+//systems) a few worker threads do blocking preads instead.
+//Files in the mounted asset pack are already mapped and complete immediately.
+//Completed files land in buffers that are recycled between reads.
+#include "asset_pack.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+//counters since the AsyncIO was created
+struct AsyncIOStats {
+	size_t reads;	//files read, from disk or from the pack
+	size_t failed;
+	size_t bytes;
+	int maxQueueDepth;	//most reads that were in flight at once
+	double busySeconds;	//time with at least one read in flight
+	double bytesPerSecond() const { return busySeconds > 0.0 ? bytes / busySeconds : 0.0; }
+};
+
+class AsyncIO {
+public:
+	//called once per read on the thread that completed it, data is empty if the read
+	//failed. Take the bytes with data.swap() to keep them after the call
+	typedef function<void(const string &path, AssetData &data, bool ok)> Callback;
+
+	//PRE:
+	//	queueDepth: reads in flight at most, more are queued until one completes
+	//	threads: workers of the pread fallback, each has one read in flight
+	//	useUring: false always uses the fallback
+	AsyncIO(int queueDepth = 32, int threads = 4, bool useUring = true);
+	//waits for the reads in flight
+	~AsyncIO();
+
+	//queue a read of a whole file, it starts with the next submit()
+	void read(const string &path, Callback done);
+	//start every queued read
+	void submit();
+	//block until every submitted read has completed
+	void wait();
+
+	//read files in one batch for code that reads them with Vfs::read later, which
+	//then waits for the prefetch instead of reading the file itself
+	void prefetch(const vector<string> &paths);
+
+	//give the buffer of a completed read back for the next reads
+	void recycle(AssetData &data);
+
+	bool usesUring() const { return _ring_fd >= 0; }
+	//reads submitted and not completed yet
+	int queueDepth();
+	AsyncIOStats stats();
+	void report(ostream &out = cout);
+
+private:
+	AsyncIO(const AsyncIO &);
+	AsyncIO &operator=(const AsyncIO &);
+
+	struct Pending;
+	typedef chrono::steady_clock Clock;
+
+	int _queue_depth;
+	mutex _lock;
+	condition_variable _wake;	//workers: reads were queued
+	condition_variable _idle;	//wait(): the last read completed
+	deque<Pending *> _queued;	//read() but not submitted yet
+	deque<Pending *> _ready;	//submitted, waiting for a free slot
+	int _in_flight;
+	bool _quit;
+	vector<thread> _threads;
+	vector<vector<unsigned char> > _buffers;	//recycled
+	AsyncIOStats _stats;
+	Clock::time_point _busy_since;
+
+	//io_uring, _ring_fd is -1 when the fallback is used
+	int _ring_fd;
+	unsigned _sq_entries;
+	void *_sq_ring, *_cq_ring, *_sqes;
+	size_t _sq_ring_size, _cq_ring_size;
+	unsigned *_sq_head, *_sq_tail, *_sq_mask, *_sq_array;
+	unsigned *_cq_head, *_cq_tail, *_cq_mask;
+	void *_cqes;
+
+	bool setupRing(unsigned entries);
+	void closeRing();
+	bool open(Pending *pending);
+	void fill();
+	void queueRead(Pending *pending);
+	void enterRing(unsigned submitted);
+	void reapLoop();
+	void workerLoop();
+	void finish(Pending *pending, bool ok);
+	void started();
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef BC_ENCODER_H
+#define BC_ENCODER_H
+//this file contains a CPU encoder for block compressed textures.
+//	BC1 (DXT1): RGB + 1 bit alpha, 8 bytes per 4x4 block
+//	BC3 (DXT5): RGBA, 16 bytes per 4x4 block
+//	BC7: RGBA, 16 bytes per 4x4 block, encoded with mode 6 only (one subset,
+//		4 bit indices), the quality setting controls how hard endpoints are refined
+//The encoder doesn't need OpenGL, so it can run while loading or in a cook step,
+//uploading is done by uploadCompressed() in config.h.
+//Blocks are split between threads by rows, the palette search uses SSE2 if available.
+#include "glad/glad.h"
+
+#include <vector>
+
+using namespace std;
+
+enum BCFormat {
+	BC_NONE,	//not compressed, RGBA8
+	BC1,
+	BC3,
+	BC7
+};
+
+//compressed texture formats, these tokens are not in our glad loader
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#define GL_COMPRESSED_RGBA_BPTC_UNORM_ARB 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB 0x8E8D
+
+//statistics of the last encode
+struct BCStats {
+	double seconds;
+	double mpixelsPerSecond;
+	double psnr;	//RGBA PSNR in dB against the source, 0 if not measured
+};
+
+class BlockCompressor {
+public:
+	//encode an RGBA8 image
+	//PRE:
+	//	rgba: width * height * 4 bytes, rows are tightly packed
+	//	threads: number of threads, 0 uses every core
+	//	quality: 0 is fastest, 1 refines endpoints once, 2 and up refine more and
+	//		search more BC7 p-bits
+	//POST:
+	//	out holds blocks row by row, partial blocks at the right/bottom edge are
+	//	padded by repeating the last pixel
+	static void encode(const unsigned char *rgba, int width, int height, BCFormat format,
+		vector<unsigned char> &out, int threads = 0, int quality = 1, BCStats *stats = NULL);
+
+	//decode blocks back to RGBA8, used to measure quality and as a fallback when the
+	//GPU can't sample the format
+	static void decode(const unsigned char *blocks, int width, int height, BCFormat format,
+		unsigned char *rgba);
+
+	//PSNR of blocks against the source image, over all 4 channels
+	static double psnr(const unsigned char *rgba, const unsigned char *blocks,
+		int width, int height, BCFormat format);
+
+	//size in bytes of an encoded image
+	static size_t encodedSize(int width, int height, BCFormat format);
+
+	//OpenGL internal format of a block format
+	static GLenum glFormat(BCFormat format, bool srgb = false);
+};
+
+#endif
@@ -1,11 +1,14 @@
 // this is the header file of a camera class
 // this camera is able to detect user's certain input. eg. wsad and mouse movement
+// the orientation is a quaternion, the matrices and frustum planes are cached and
+// only rebuilt after the camera moved, turned, zoomed or the window was resized
 #ifndef CAMERA_H
 #define CAMERA_H
 
 #include "glad/glad.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 #include <iostream>
 using namespace std;
@@ -24,12 +27,35 @@ const float INIT_YAW = -90.0;
 const float INIT_PITCH = 0.0;
 const float INIT_SPEED = 2.5;
 const float INIT_MOUSE_SENSITIVITY = 0.05;
+const float INIT_NEAR = 0.1;
+const float INIT_FAR = 100.0;
+
+//planes of a view frustum in world space, ax + by + cz + d >= 0 inside, normalized
+//so that the distance to a plane is its value
+enum FrustumPlane {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+struct Frustum {
+	glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+
+	//extract the planes of a projection * view matrix
+	void fromMatrix(const glm::mat4 &viewProj);
+	//whether a sphere or box may be visible, conservative near the corners
+	bool sphereVisible(const glm::vec3 &center, float radius) const;
+	bool boxVisible(const glm::vec3 &min, const glm::vec3 &max) const;
+};
 
 class Camera {
 public:
 	GLboolean MOUSE_VERTICAL_INVERSE;
 	GLboolean MOUSE_HORIZONTAL_INVERSE;
-	glm::vec3 cameraPos, cameraFront, cameraUp; //used to generate lookat matrix
 
 	//construct camera with vectors
 	//the camera obeject requires a initial position vector, a front vector indicating 
@@ -38,6 +64,7 @@ public:
 	//if no parameter is provieded, the camera will generated at world's (0, 0, 0) position,
 	//pointing to negative z-axis
 	//mouse move inversing is set to false by default
+	//the initial direction comes from yaw and pitch, front is not used
 	// input arguments: (position, front, up, yaw, pitch)
 	Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), 
 		glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f), 
@@ -72,9 +99,34 @@ public:
 	//to the vertex shader
 	//POST:
 	//	a matrix will be returned as view matrix (presenting current camera direction and position)
-	glm::mat4 getView();
+	const glm::mat4 &getView();
+	//perspective projection of the fov, aspect and clip planes
+	const glm::mat4 &getProjection();
+	//projection * view
+	const glm::mat4 &getViewProjection();
+	const glm::mat4 &getInverseView();
+	const glm::mat4 &getInverseViewProjection();
+	//planes of getViewProjection()
+	const Frustum &getFrustum();
+	//changes every time one of the matrices does, so a caller can skip work when the
+	//camera didn't change since it last looked
+	unsigned int getRevision() const;
+
+	//position and direction getters
+	glm::vec3 getPosition() const;
+	glm::vec3 getFront() const;
+	glm::vec3 getRight() const;
+	glm::vec3 getUp() const;
+	glm::quat getOrientation() const;
+	void setPosition(const glm::vec3 &position);
 	//fov getter
 	float getFOV();
+	//aspect ratio of the viewport, width / height. Call it whenever the framebuffer
+	//is resized
+	void setAspect(float aspect);
+	float getAspect() const;
+	//distance of the near and far clip planes
+	void setClipPlanes(float near_plane, float far_plane);
 	//speed setter, note original camera speed is 2.5f
 	void setSpeed(float speed);
 	//mouse sensitivity setter
@@ -85,13 +137,28 @@ public:
 	void setMouseVerticalInverse(GLboolean inverse);
 
 private:
-	float _yaw, _pitch; //yaw and pitch should be updated every time user moves it's mouse
+	glm::vec3 _position;
+	glm::quat _orientation;	//turns the camera's -z axis to where it looks
+	glm::vec3 _world_up;	//the camera turns around this for yaw
+	float _pitch; //kept to constrain the pitch
 	float _fov;	//current camera fov (field of view)
+	float _aspect;
+	float _near, _far;
 	float _speed;
 	float _mouse_sens;
 
-	//update camera's vectors, this function is called everytime the mouse is moved
-	void updateCamera();
+	//cached matrices, rebuilt by the getters when they are dirty
+	glm::mat4 _view, _inverse_view;
+	glm::mat4 _projection;
+	glm::mat4 _view_projection, _inverse_view_projection;
+	Frustum _frustum;
+	bool _view_dirty, _projection_dirty, _view_projection_dirty;
+	unsigned int _revision;
+
+	//the position or orientation changed
+	void viewChanged();
+	//the fov, aspect or clip planes changed
+	void projectionChanged();
 
 };
 
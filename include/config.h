@@ -10,6 +10,9 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "stb_image.h"
 #include "camera.h"
+#include "bc_encoder.h"
+#include "mip_builder.h"
+#include "asset_pack.h"
 
 using namespace std;
 //load texture and configure it as GL_REPEAT and GL_LINEAR for magnification and 
@@ -17,14 +20,83 @@ using namespace std;
 //PRE:
 //	path: path of the texture file, should be a image file
 //	texture: texture int created by OpenGL function
-void configTexture(const char *path, int texture);
+//	compression: block compress the texture on load, falls back to RGBA8 if the
+//		format is not supported by the GPU
+//	srgb: the image holds sRGB colors, uncompressed textures use GL_SRGB8(_ALPHA8)
+//	cpuMips: build the mip chain of uncompressed textures with MipBuilder instead of
+//		glGenerateMipmap
+//	mipFilter: filter of the CPU built mips
+//POST:
+//	uncompressed textures keep the channel count of the file, see channelFormat()
+void configTexture(const char *path, int texture, BCFormat compression = BC_NONE,
+	bool srgb = false, bool cpuMips = true, MipFilter mipFilter = MIP_BOX);
+//the same with the bytes of the file already read, eg. by a prefetch. path only names
+//the texture in messages
+void configTexture(const char *path, const AssetData &file, int texture,
+	BCFormat compression = BC_NONE, bool srgb = false, bool cpuMips = true,
+	MipFilter mipFilter = MIP_BOX);
 
-//process user input in the render loop
+//compact GL format for an 8 bit image with 1 to 4 channels
+struct ChannelFormat {
+	int channels;		//channels to decode, grey is expanded to RGB for sRGB
+	GLint internalFormat;	//GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 or an sRGB variant
+	GLenum format;
+	GLint swizzle[4];	//GL_TEXTURE_SWIZZLE_RGBA so that shaders still see RGBA
+};
+ChannelFormat channelFormat(int channels, bool srgb = false);
+
+//decode an image straight into a mapped pixel unpack buffer and upload it to level 0
+//of the texture bound to GL_TEXTURE_2D, without an intermediate image. Rows are
+//padded to GL_UNPACK_ALIGNMENT.
+//PRE:
+//	path: names the upload buffer
+//	file: bytes of the image file
+//POST:
+//	width, height: size of the image
+//	channels: channels that were uploaded, see channelFormat()
+//	return false if the image can't be decoded or the mapping was lost
+bool loadTextureMapped(const char *path, const AssetData &file, unsigned int texture,
+	int *width, int *height, int *channels, bool srgb = false);
+
+//decode an image, build its mip chain on the CPU and upload every level of the
+//texture bound to GL_TEXTURE_2D. Rows are padded to GL_UNPACK_ALIGNMENT, the texture
+//is set to sample the mips with trilinear filtering.
+//PRE:
+//	file: bytes of the image file
+//	options: filter, alpha cutoff and threads of the mip builder, srgb and the
+//		alignment are taken from the arguments and the GL state
+//POST:
+//	width, height: size of level 0
+//	channels: channels that were uploaded, see channelFormat()
+//	return false if the image can't be decoded
+bool loadTextureMips(const AssetData &file, unsigned int texture, int *width, int *height,
+	int *channels, bool srgb = false, const MipOptions &options = MipOptions(),
+	MipStats *stats = NULL);
+
+//check whether the current OpenGL context supports an extension
+//PRE:
+//	name: full extension name, eg. "GL_ARB_get_program_binary"
+bool hasExtension(const char *name);
+
+//whether the current context can sample a block format. BC1/BC3 need
+//GL_EXT_texture_compression_s3tc, BC7 needs GL_ARB_texture_compression_bptc
+bool compressionSupported(BCFormat format);
+
+//encode and upload one level of the texture bound to GL_TEXTURE_2D. When the format
+//isn't supported the uncompressed image is uploaded instead.
+//POST:
+//	return the format that was uploaded
+BCFormat uploadCompressed(unsigned int texture, int level, const unsigned char *rgba,
+	int width, int height, BCFormat format, int quality = 1, BCStats *stats = NULL);
+
+//process user input in the render loop, see input.h. Input::attach must have been
+//called on the window
 //PRE:
 // window: user's window
 extern Camera camera;
 extern float delta_time;
 extern float mix_value; // variable declared in main.cpp, used to mix two textures
+extern bool depth_prepass; // variable declared in main.cpp, switched with p
 void processInput(GLFWwindow *window);
 
 //this function is automatically called every time the window is resized
@@ -34,12 +106,4 @@ void processInput(GLFWwindow *window);
 //  height: new window's height
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
-//this function is automatically called every time the window is resized
-extern GLboolean MOUSE_FIRST;
-extern float MOUSE_X, MOUSE_Y; //mouse's position
-void mouse_callback(GLFWwindow *window, double x, double y);
-
-//this function is automatically called every time the mouse is scrolled
-void scroll_callback(GLFWwindow *window, double x, double y);
-
 #endif 
\ No newline at end of file
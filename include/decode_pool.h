@@ -0,0 +1,52 @@
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+//this file contains the allocator stb_image uses for its scratch buffers and output
+//images. Every thread keeps lists of freed blocks by size class and hands them out
+//again, so decoding one texture after another reuses the same zlib, JPEG component
+//and output buffers instead of going through malloc/free each time.
+//Blocks may be freed on another thread than the one that allocated them, they then
+//go to the pool of the freeing thread.
+//Route stb_image to the pool by defining, before STB_IMAGE_IMPLEMENTATION is included:
+//	#define STBI_MALLOC(size) DecodePool::allocate(size)
+//	#define STBI_REALLOC(p, size) DecodePool::reallocate(p, size)
+//	#define STBI_FREE(p) DecodePool::release(p)
+#include <stddef.h>
+#include <iostream>
+
+using namespace std;
+
+//counters over every thread since the start of the program
+struct DecodePoolStats {
+	size_t allocations;	//allocate calls, including reallocs that had to move
+	size_t pooled;	//allocations big enough to be pooled
+	size_t reused;	//pooled allocations served from a free list
+	size_t bytesAllocated;	//total bytes requested
+	size_t liveBytes;	//bytes currently handed out
+	size_t peakBytes;	//most bytes handed out at once
+	size_t cachedBytes;	//bytes kept in free lists
+	double reuseRate() const { return pooled ? (double)reused / pooled : 0.0; }
+};
+
+class DecodePool {
+public:
+	//16 byte aligned block of at least size bytes, NULL if out of memory
+	static void *allocate(size_t size);
+	//grow or shrink a block, stays in place when the block is big enough
+	static void *reallocate(void *p, size_t size);
+	//return a block to the calling thread's pool, NULL is ignored
+	static void release(void *p);
+
+	//bytes each thread may keep in its free lists, blocks freed beyond this go
+	//back to the system. 0 turns pooling off
+	static void setLimit(size_t bytes);
+	//give the calling thread's free lists back to the system
+	static void trim();
+
+	static DecodePoolStats stats();
+	static void report(ostream &out = cout);
+
+	//allocations up to this size go straight to malloc, they are too small to fragment
+	static const size_t MIN_POOLED = 4096;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef GL_PROFILER_H
+#define GL_PROFILER_H
+//this file contains a profiler of the GL calls. It hooks the glad debug callbacks, so
+//it only sees calls when the build has -DGLAD_DEBUG=ON, see glad_debug.h. For every
+//GL function it counts the calls of each frame and times them on the CPU, ie. the
+//time the driver takes to queue the call, not the GPU time. Uploads through
+//glBufferData, glBufferSubData and the glTexImage2D family are added up in bytes.
+//Calls that make the CPU wait for the GPU or for the driver thread, ie. glGet*,
+//glReadPixels, glFinish, glClientWaitSync and mapping without
+//GL_MAP_UNSYNCHRONIZED_BIT, flag the frame unless they were allowed with allowSync().
+//GL has to be called from one thread only.
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+//the calls of one frame
+struct GLFrameStats {
+	size_t calls;
+	double seconds;	//spent inside the GL functions
+	size_t uploadBytes;
+	size_t syncCalls;	//synchronizing calls that were not allowed
+};
+
+//the calls of one GL function since attach()
+struct GLCallStats {
+	string name;
+	size_t calls;
+	size_t maxFrameCalls;
+	double seconds, maxSeconds;	//maxSeconds: slowest single call
+	size_t uploadBytes;
+	bool sync;	//the function synchronizes
+	size_t syncFrames;	//frames it was called in while not allowed
+};
+
+class GLProfiler {
+public:
+	//install the glad callbacks and start counting
+	//POST:
+	//	return false if glad was built without GLAD_DEBUG, nothing is counted then
+	static bool attach();
+	static void detach();
+	static bool attached();
+
+	//don't flag frames for calls of a synchronizing function, eg. glFinish when the
+	//frame waits for the GPU on purpose
+	static void allowSync(const char *name);
+
+	//close the counters of the frame, call once per frame, eg. after glfwSwapBuffers
+	static void endFrame();
+	static GLFrameStats lastFrame();
+	static size_t frames();
+	//frames with synchronizing calls that were not allowed
+	static size_t syncFrames();
+
+	//GL functions that were called, the most expensive first
+	static vector<GLCallStats> calls();
+	//per frame averages and the top functions by time
+	static void report(ostream &out = cout, size_t top = 10);
+};
+
+#endif
@@ -87,6 +87,23 @@ GLAPI int gladLoadGL(void);
 
 GLAPI int gladLoadGLLoader(GLADloadproc);
 
+#ifdef GLAD_LOAD_USED_ONLY
+/* resolve only the entry points listed in the generated glad_used.h,
+ * every other glad_gl* pointer stays NULL. returns the number of entry points
+ * that were resolved, 0 on failure */
+GLAPI int gladLoadGLUsed(GLADloadproc);
+#endif
+
+#ifdef GLAD_DEBUG
+/* the entry points listed in the generated glad_debug.h call the pre callback,
+ * the GL function and then the post callback. both get the name of the function,
+ * the resolved pointer and the number of arguments followed by the arguments.
+ * the default callbacks do nothing */
+typedef void (* GLADcallback)(const char *name, void *funcptr, int len_args, ...);
+GLAPI void glad_set_pre_callback(GLADcallback cb);
+GLAPI void glad_set_post_callback(GLADcallback cb);
+#endif
+
 #include <stddef.h>
 #include <KHR/khrplatform.h>
 #ifndef GLEXT_64_TYPES_DEFINED
@@ -3659,6 +3676,10 @@ GLAPI PFNGLSECONDARYCOLORP3UIVPROC glad_glSecondaryColorP3uiv;
 #define glSecondaryColorP3uiv glad_glSecondaryColorP3uiv
 #endif
 
+#ifdef GLAD_DEBUG
+#include "glad_debug.h"
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,92 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+//this file contains a registry of every buffer and texture we create, so that we know
+//how much video memory the program uses. Create and fill GL resources through the
+//functions below instead of calling glGenBuffers/glBufferData/glTexImage2D directly.
+//Sizes are estimates of what the driver allocates, eg. GL_RGB8 textures are counted
+//as 4 bytes per texel because drivers pad them to RGBA.
+#include "glad/glad.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+
+using namespace std;
+
+enum GpuCategory {
+	GPU_GEOMETRY,	//vertex and index buffers
+	GPU_TEXTURE,	//sampled textures
+	GPU_RENDER_TARGET, //textures and renderbuffers that are rendered to
+	GPU_OTHER,
+	GPU_CATEGORY_COUNT
+};
+
+//GL_NVX_gpu_memory_info and GL_ATI_meminfo are not in our glad loader
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_VBO_FREE_MEMORY_ATI 0x87FB
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#define GL_RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+
+class GpuMemory {
+public:
+	//create a buffer and register it
+	//PRE:
+	//	label: name shown in the memory report
+	static unsigned int genBuffer(GpuCategory category, const string &label);
+	//glBufferData on a registered buffer, the buffer must be bound to target
+	static void bufferData(GLenum target, unsigned int buffer, size_t size,
+		const void *data, GLenum usage);
+	static void deleteBuffer(unsigned int buffer);
+
+	//create a texture and register it
+	static unsigned int genTexture(GpuCategory category, const string &label);
+	//glTexImage2D on a registered texture, the texture must be bound to target.
+	//a level with 0 width or height releases the level
+	static void texImage2D(GLenum target, unsigned int texture, int level,
+		GLint internalFormat, int width, int height, GLenum format, GLenum type,
+		const void *pixels);
+	//glGenerateMipmap on a registered texture, records levels 1..n from level 0
+	static void generateMipmap(GLenum target, unsigned int texture);
+	//record the size of a level that was specified some other way, eg. with
+	//glCompressedTexImage2D
+	static void trackLevel(unsigned int texture, int level, GLint internalFormat,
+		int width, int height, size_t bytes);
+	static void deleteTexture(unsigned int texture);
+
+	//register a resource that is created elsewhere, eg. a renderbuffer
+	static void trackOther(unsigned int name, GpuCategory category, const string &label,
+		size_t bytes);
+	static void untrackOther(unsigned int name);
+
+	//bytes the driver allocates for one level of a texture
+	static size_t levelBytes(GLint internalFormat, int width, int height);
+
+	//tracked bytes of one buffer or texture, 0 if it isn't registered
+	static size_t bufferBytes(unsigned int buffer);
+	static size_t textureBytes(unsigned int texture);
+
+	//total of tracked bytes of a category, or of everything with GPU_CATEGORY_COUNT
+	static size_t totalBytes(GpuCategory category = GPU_CATEGORY_COUNT);
+
+	//print every resource, totals per category and what the driver reports when
+	//GL_NVX_gpu_memory_info or GL_ATI_meminfo is available
+	static void report(ostream &out = cout);
+
+private:
+	struct Resource {
+		GpuCategory category;
+		string label;
+		GLint format;
+		int width, height;
+		vector<size_t> levels; //bytes of each texture level, buffers use levels[0]
+		size_t bytes();
+	};
+	static map<unsigned int, Resource> &buffers();
+	static map<unsigned int, Resource> &textures();
+	static map<unsigned int, Resource> &others();
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HASH_H
+#define HASH_H
+//this file contains the 64 bit content hash used to key caches and the asset pack.
+//It is XXH64, so hashes can be checked against any other xxHash implementation.
+#include <stddef.h>
+#include <stdint.h>
+
+//XXH64 of a buffer
+uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
+
+#endif
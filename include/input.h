@@ -0,0 +1,123 @@
+#ifndef INPUT_H
+#define INPUT_H
+//this file contains the input layer. GLFW calls our key, mouse button and scroll
+//callbacks while it polls events, they only append the event to a lock-free queue.
+//update() drains the queue once per simulation tick and turns the events into the
+//state of actions through a binding table, so a frame never asks GLFW for the state
+//of a key and adding bindings doesn't add polling.
+//Cursor movement is summed into an accumulator instead, a fast mouse sends hundreds
+//of motion events per frame. The frame takes the sum with latchMouse() right before
+//it builds the view, so the camera turns once per frame with the newest movement.
+//The cursor is captured once in attach() instead of every frame.
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include <stddef.h>
+#include <iostream>
+
+using namespace std;
+
+//what the program does with input, keys and mouse buttons are bound to these
+enum InputAction {
+	ACTION_QUIT,
+	ACTION_MIX_UP,	//show more of the second texture
+	ACTION_MIX_DOWN,
+	ACTION_MEMORY_REPORT,
+	ACTION_FORWARD,
+	ACTION_BACKWARD,
+	ACTION_LEFT,
+	ACTION_RIGHT,
+	ACTION_DEPTH_PREPASS,	//switch the depth pre-pass on and off
+	ACTION_COUNT
+};
+
+enum InputEventType {
+	INPUT_KEY,	//code is a GLFW_KEY_*, action GLFW_PRESS/GLFW_RELEASE/GLFW_REPEAT
+	INPUT_MOUSE_BUTTON,	//code is a GLFW_MOUSE_BUTTON_*
+	INPUT_SCROLL	//x and y are the scroll offsets
+};
+
+struct InputEvent {
+	InputEventType type;
+	int code;
+	int action;
+	float x, y;
+};
+
+//cursor movement since the last latchMouse()
+struct MouseDelta {
+	double x, y;	//pixels, with the sub-pixel precision of the platform
+	int events;	//motion events summed
+	double age;	//seconds since the oldest of them, 0 without movement
+};
+
+//counters since attach()
+struct InputStats {
+	size_t events;	//events queued
+	size_t dropped;	//events lost because the queue was full
+	size_t maxQueued;	//most events drained by one update()
+	size_t updates;
+	size_t motionEvents;	//cursor events summed into the accumulator
+	size_t mouseLatches;	//latchMouse() calls that had movement
+	//with measureLatency(), seconds from the oldest motion event of a latch to the
+	//latch and to presented()
+	size_t latencySamples;
+	double latchSeconds, presentSeconds, maxPresentSeconds;
+};
+
+class Input {
+public:
+	//install the callbacks and capture the cursor, then bind the default keys
+	//PRE:
+	//	captureCursor: hide the cursor and give unlimited mouse movement
+	static void attach(GLFWwindow *window, bool captureCursor = true);
+
+	//the default bindings: escape quits, up/down mix the textures, m prints the gpu
+	//memory report, wsad walk, p switches the depth pre-pass
+	static void bindDefaults();
+	//bind a key or mouse button to an action, an input can drive several actions and
+	//an action can have several inputs. Bind on the thread that runs update()
+	static void bindKey(int key, InputAction action);
+	static void bindMouseButton(int button, InputAction action);
+	static void unbindAll();
+
+	//queue an event, safe to call from one thread while another runs update()
+	//POST:
+	//	return false if the queue was full and the event was dropped
+	static bool post(const InputEvent &event);
+
+	//apply every queued event, call once per simulation tick
+	static void update();
+	//whether one of the inputs of an action is held down
+	static bool held(InputAction action);
+	//whether the action went down or up during the last update()
+	static bool pressed(InputAction action);
+	static bool released(InputAction action);
+	//scrolling during the last update()
+	static float scrollX();
+	static float scrollY();
+
+	//add a cursor position from GLFW, the first one after attach() or resetCursor()
+	//only sets where movement is measured from. Safe to call from one thread while
+	//another latches
+	static void moveCursor(double x, double y);
+	static void resetCursor();
+	//add movement that didn't come from the cursor, eg. a replay
+	static void addMouseDelta(double x, double y);
+	//take the movement summed since the last latch, call once per frame as late as
+	//possible before the view is built
+	static MouseDelta latchMouse();
+
+	//measure how long motion events wait: call presented() once the frame that latched
+	//them is on screen, eg. after glfwSwapBuffers and glFinish
+	static void measureLatency(bool enable);
+	static void presented();
+
+	static InputStats stats();
+	static void report(ostream &out = cout);
+
+	//events the queue holds, a power of two
+	static const size_t QUEUE_SIZE = 1024;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+//this file contains the recorder that makes runs of the program repeatable. While
+//recording, every frame's time step, the input events Input::update applied and the
+//mouse movement Input::latchMouse took are kept and written to a file at stop().
+//A replay feeds them back frame by frame instead of the live input, with the recorded
+//time steps or a fixed one, so two builds can be compared on the same camera path.
+//Live input is ignored during a replay, except that the quit keys still quit.
+//Both modes collect the real frame times for report() and writeFrameTimes().
+//A recording is
+//	RecordingHeader
+//	for every frame: float time step, uint8 flags, uint16 event count, two floats of
+//		mouse movement if flags has RECORD_MOUSE, then every event as uint8 type,
+//		uint8 action, int16 code and two floats for INPUT_SCROLL
+//little endian and packed, a minute at 60 fps takes about 55 KB.
+#include "input.h"
+
+#include <stdint.h>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+#define RECORDING_MAGIC "HREC"
+static const uint32_t RECORDING_VERSION = 1;
+
+struct RecordingHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t frames;
+};
+
+enum RecordFlags {
+	RECORD_MOUSE = 1	//the frame latched mouse movement
+};
+
+enum RecorderMode {
+	RECORDER_OFF,
+	RECORDER_RECORDING,
+	RECORDER_REPLAYING
+};
+
+//distribution of the real frame times
+struct FrameTimeStats {
+	size_t frames;
+	double mean, p50, p90, p99, max;	//seconds
+};
+
+class InputRecorder {
+public:
+	//start recording, the file is written by stop()
+	static void record(const char *path);
+	//load a recording and replay it from the next frame() on
+	//PRE:
+	//	fixedDelta: time step of every frame, 0 uses the recorded ones
+	//POST:
+	//	return false if the file is missing or isn't a recording
+	static bool replay(const char *path, float fixedDelta = 0.0f);
+	//write the recording
+	//POST:
+	//	return false if it was recording and the file can't be written
+	static bool stop();
+	static RecorderMode mode();
+
+	//start the next frame, call once per frame before the input is processed
+	//PRE:
+	//	delta_time: the measured time step of the frame
+	//POST:
+	//	delta_time: the recorded or fixed time step during a replay
+	//	return false once a replay has no frames left
+	static bool frame(float &delta_time);
+
+	//used by Input: keep what was applied while recording, and hand out the events
+	//and mouse movement of the replayed frame, each once
+	static void recordEvent(const InputEvent &event);
+	static void recordMouse(const MouseDelta &delta);
+	static vector<InputEvent> replayEvents();
+	static bool replayMouse(MouseDelta &delta);
+
+	static FrameTimeStats frameTimes();
+	static void report(ostream &out = cout);
+	//write one frame time in milliseconds per line, to compare runs elsewhere
+	static bool writeFrameTimes(const char *path);
+};
+
+#endif
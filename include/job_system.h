@@ -0,0 +1,105 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+//this file contains the job system every part of the engine shares its threads
+//through. init() starts a worker per core besides the calling thread, which becomes
+//worker 0 and runs jobs whenever it waits for them.
+//Every worker owns a Chase-Lev deque (Chase and Lev 2005, with the memory orderings of
+//Le et al. 2013): it pushes and pops its own jobs at the bottom, newest first, while
+//idle workers steal the oldest job at the top of another deque, starting at a random
+//one. Threads outside the pool, eg. AsyncIO completions, queue their jobs in a shared
+//locked queue instead. Workers that find nothing spin a little, then sleep until the
+//next job is queued.
+//A JobCounter counts the unfinished jobs of a batch. wait() runs other jobs until the
+//counter drops to 0, and a job can be held back until a counter is done.
+//parallelFor() splits its range lazily: a job runs its range grain by grain and hands
+//the upper half of what is left to a new job whenever its own deque has run dry, which
+//only happens when idle workers stole from it. Ranges are split as often as there are
+//idle workers and no more.
+//Without init() every job runs on the calling thread when it is queued.
+#include <stddef.h>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+
+typedef void (*JobFunction)(void *data);
+//a chunk [begin, end) of a parallelFor range
+typedef void (*RangeFunction)(void *data, size_t begin, size_t end);
+
+class JobCounter {
+public:
+	JobCounter() : _pending(0) {}
+	bool done() const { return _pending.load() == 0; }
+	int pending() const { return _pending.load(); }
+	//add jobs to the count, negative when they are done
+	//POST:
+	//	return the count before
+	int add(int jobs){ return _pending.fetch_add(jobs); }
+
+private:
+	JobCounter(const JobCounter &);
+	JobCounter &operator=(const JobCounter &);
+
+	atomic<int> _pending;
+};
+
+//counters over every thread since init()
+struct JobStats {
+	size_t jobs;	//jobs run
+	size_t steals;	//jobs taken from the deque of another worker
+	size_t failedSteals;	//steals that found an empty deque or lost a race
+	size_t splits;	//parallelFor ranges handed to a new job
+	size_t sleeps;	//times a worker ran out of jobs and slept
+};
+
+class JobSystem {
+public:
+	//start the workers
+	//PRE:
+	//	threads: workers including the caller, 0 uses every core. Call it from the
+	//		thread that waits for jobs the most, eg. main
+	static void init(int threads = 0);
+	//run every queued job and stop the workers, on the thread that called init()
+	static void shutdown();
+	static bool running();
+	//workers including the caller of init(), 1 when not running
+	static int threads();
+
+	//queue function(data)
+	//PRE:
+	//	counter: incremented now and decremented when the job is done, may be NULL
+	//	after: the job starts once this counter is done, NULL starts it right away.
+	//		It has to live until the job started
+	static void run(JobFunction function, void *data, JobCounter *counter = NULL,
+		JobCounter *after = NULL);
+	//run jobs until the counter is done, on any thread
+	static void wait(JobCounter &counter);
+	//run one queued job on the calling thread, for a thread with time left over, eg.
+	//the GL thread at the end of a frame when there are no other workers
+	//POST:
+	//	return false if no job was queued
+	static bool runOne();
+
+	//call function on chunks of [begin, end) and return when every chunk is done
+	//PRE:
+	//	grain: fewest indices a chunk has, except the last one. 0 picks one from the
+	//		size of the range and the threads
+	static void parallelFor(size_t begin, size_t end, RangeFunction function, void *data,
+		size_t grain = 0);
+	//the same with a callable taking (size_t begin, size_t end)
+	template <class Body>
+	static void parallelFor(size_t begin, size_t end, const Body &body, size_t grain = 0){
+		parallelFor(begin, end, &callBody<Body>, (void *)&body, grain);
+	}
+
+	static JobStats stats();
+	static void report(ostream &out = cout);
+
+private:
+	template <class Body>
+	static void callBody(void *data, size_t begin, size_t end){
+		(*(const Body *)data)(begin, end);
+	}
+};
+
+#endif
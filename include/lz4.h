@@ -0,0 +1,32 @@
+#ifndef LZ4_H
+#define LZ4_H
+//this file contains a compressor and decompressor for the LZ4 block format, used for
+//the entries of the asset pack. A block is a list of sequences: a token byte with the
+//literal count in the high 4 bits and the match length - 4 in the low 4 bits, more
+//length bytes when a count is 15, the literals, and a 2 byte little endian offset back
+//into the output. The last sequence is literals only. Decompression is a few copies
+//per sequence and runs at memory speed.
+#include <stddef.h>
+
+class Lz4 {
+public:
+	//largest block compress can produce for size bytes
+	static size_t compressBound(size_t size);
+
+	//greedy compression with a hash table of the last position of every 4 bytes
+	//POST:
+	//	return the size of the block written to dst, 0 if it doesn't fit in capacity
+	static size_t compress(const unsigned char *src, size_t size, unsigned char *dst,
+		size_t capacity);
+
+	//decompress a whole block, checks every length and offset so a corrupt block
+	//can't write or read out of bounds
+	//PRE:
+	//	rawSize: exact size of the decompressed data
+	//POST:
+	//	return false if the block is corrupt or doesn't decompress to rawSize bytes
+	static bool decompress(const unsigned char *src, size_t size, unsigned char *dst,
+		size_t rawSize);
+};
+
+#endif
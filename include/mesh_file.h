@@ -0,0 +1,76 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+//this file contains the cooked mesh format. mesh_cooker turns OBJ and glTF files into
+//it, see mesh_import.h, and the program uploads its blobs as they are, there is
+//nothing to parse at load time. A mesh file is laid out as
+//	MeshFileHeader
+//	vertex blob, interleaved floats, at a multiple of MESH_ALIGNMENT
+//	index blob, triangles of uint16 or uint32 indices, at a multiple of MESH_ALIGNMENT
+//Integers and floats are little endian. The asset packer stores .mesh files
+//uncompressed, so a packed mesh is uploaded straight from the mapping.
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define MESH_MAGIC "HMSH"
+static const uint32_t MESH_VERSION = 1;
+//the blobs start on cache lines, like the entries of the asset pack
+static const uint32_t MESH_ALIGNMENT = 64;
+
+//the attributes in the order they are interleaved, each is bound to the location of
+//its slot, so meshes without texture coordinates still have normals at location 2
+enum MeshAttribute {
+	MESH_POSITION,	//3 floats
+	MESH_TEXCOORD,	//2 floats
+	MESH_NORMAL,	//3 floats
+	MESH_ATTRIBUTE_COUNT
+};
+
+struct MeshFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;	//2 or 4 bytes
+	uint32_t layout[MESH_ATTRIBUTE_COUNT];	//floats of each attribute, 0 if it is missing
+	float boundsMin[3], boundsMax[3];
+	uint64_t hash;	//hash64 of both blobs, written by the cooker
+	uint64_t vertexOffset, vertexBytes;
+	uint64_t indexOffset, indexBytes;
+};
+
+//a mesh in memory, what the importer produces and the cooker writes
+struct MeshData {
+	uint32_t layout[MESH_ATTRIBUTE_COUNT];
+	vector<float> vertices;	//interleaved in the order of MeshAttribute
+	vector<uint32_t> indices;	//triangles
+	float boundsMin[3], boundsMax[3];
+
+	MeshData();
+	int stride() const;	//floats per vertex
+	size_t vertexCount() const;
+	//bounds of the positions
+	void computeBounds();
+};
+
+class MeshFile {
+public:
+	//write a mesh, with 16 bit indices when it has few enough vertices
+	//POST:
+	//	return false if the file can't be written
+	static bool write(const char *path, const MeshData &mesh);
+
+	//check a mesh file in memory, eg. the bytes Vfs::read returned
+	//POST:
+	//	return the header, NULL if the bytes aren't a valid mesh file or an index is
+	//	past the vertices
+	static const MeshFileHeader *validate(const unsigned char *data, size_t size);
+	static const float *vertices(const MeshFileHeader *header);
+	static const void *indices(const MeshFileHeader *header);
+	static int stride(const MeshFileHeader *header);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+//this file contains the mesh importer behind mesh_cooker. It reads Wavefront OBJ and
+//glTF 2.0 (.gltf with its buffers, or .glb) into a MeshData, welds vertices that are
+//the same and orders the triangles for the vertex cache, see mesh_file.h for what is
+//written afterwards.
+//OBJ text is split into chunks at line ends that are parsed on several threads, numbers
+//are read straight from the text without strtod or a copy of the line. Faces with more
+//than 3 corners are fanned, groups, objects and materials are ignored.
+//Only triangle primitives of glTF are read, every node of the default scene is baked
+//into one mesh with its transform. glTF texture coordinates are flipped to the bottom
+//left origin OBJ and GL use.
+#include "mesh_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+struct MeshImportStats {
+	size_t sourceBytes;	//bytes of the file, without external glTF buffers
+	size_t corners;	//triangle corners read, the vertices before welding
+	size_t vertices, triangles;
+	int threads;
+	double parseSeconds, weldSeconds, optimizeSeconds;
+	double acmrBefore, acmrAfter;	//vertex cache misses per triangle
+	void report(ostream &out = cout) const;
+};
+
+class MeshImporter {
+public:
+	//import, weld and optimize a mesh file
+	//PRE:
+	//	path: .obj, .gltf or .glb
+	//	threads: threads parsing OBJ text including the caller, 0 uses every core
+	//POST:
+	//	return false if the file can't be read or parsed, the reason is printed
+	static bool import(const char *path, MeshData &out, MeshImportStats *stats = NULL,
+		int threads = 0);
+
+	//parse OBJ text, corners with the same position, texture coordinate and normal
+	//indices share a vertex, equal values under different indices are left to weld()
+	static bool parseObj(const char *text, size_t size, MeshData &out, int threads = 0);
+	//parse a glTF document, .gltf JSON or a .glb container
+	//PRE:
+	//	directory: where external buffers are looked up, with a trailing separator
+	static bool parseGltf(const unsigned char *data, size_t size, const string &directory,
+		MeshData &out);
+
+	//merge vertices whose floats are all equal
+	static void weld(MeshData &mesh);
+	//order the triangles for a post-transform cache of cacheSize vertices (Tipsify,
+	//Sander et al. 2007), then the vertices by first use so they are fetched in order
+	static void optimize(MeshData &mesh, int cacheSize = 16);
+	//misses per triangle of a FIFO vertex cache, 0.5 is ideal for a regular grid and 3
+	//the worst
+	static double acmr(const vector<uint32_t> &indices, int cacheSize = 16);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef MIP_BUILDER_H
+#define MIP_BUILDER_H
+//this file contains a CPU mipmap builder, so loading doesn't need glGenerateMipmap on
+//the GL thread. Every level is filtered in floating point from the level above it:
+//	MIP_BOX: area weighted box, 2x2 texels for even sizes and 3 wide for odd sizes
+//	MIP_KAISER: Kaiser windowed sinc reaching 3 texels of the smaller level, keeps
+//		more detail than the box at the cost of slight ringing
+//Color channels of sRGB images are filtered in linear space through lookup tables,
+//alpha is always linear. Alpha tested cutouts can keep their coverage: the alpha of
+//every level is scaled so that as many texels pass the cutoff as in level 0.
+//Rows of a level are split between threads, the filters use SSE2 and AVX if available.
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+enum MipFilter {
+	MIP_BOX,
+	MIP_KAISER
+};
+
+struct MipOptions {
+	MipFilter filter = MIP_BOX;
+	bool srgb = false;	//color channels hold sRGB values
+	float alphaCutoff = 0.0f;	//alpha test reference of a cutout, 0 leaves alpha alone
+	int alignment = 1;	//rows of the built levels are padded to this many bytes
+	int threads = 0;	//0 uses every core
+};
+
+struct MipLevel {
+	int width, height;
+	int stride;	//bytes per row
+	vector<unsigned char> pixels;
+};
+
+//statistics of the last build
+struct MipStats {
+	double seconds;
+	double mpixelsPerSecond;	//level 0 pixels per second
+};
+
+class MipBuilder {
+public:
+	//build levels 1 to n of an 8 bit image
+	//PRE:
+	//	pixels: level 0, height rows of stride bytes
+	//	channels: 1 to 4, the last channel of 2 and 4 channel images is alpha
+	//POST:
+	//	levels[i] holds level i + 1 with the same channels, the last level is 1x1
+	static void build(const unsigned char *pixels, int width, int height, int stride,
+		int channels, vector<MipLevel> &levels, const MipOptions &options = MipOptions(),
+		MipStats *stats = NULL);
+
+	//number of levels of a full chain, including level 0
+	static int levelCount(int width, int height);
+};
+
+#endif
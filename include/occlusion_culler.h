@@ -0,0 +1,105 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+//this file contains a CPU occlusion culler. Selected occluders, eg. the closest
+//meshes, are rasterized into a small depth buffer, then the bounding boxes of the
+//other meshes are tested against it before they are drawn. Nothing here touches GL,
+//so it runs and can be measured without a GPU, see bench/occlusion_bench.cpp.
+//The buffer is split into tiles of 8x4 pixels and keeps the farthest depth of each
+//tile next to the depths of its pixels, so most boxes are decided by a few tiles.
+//Rows of tiles are rasterized by several threads, 8 pixels at a time with AVX or 4
+//with SSE2. Both sides are conservative:
+//	an occluder only covers pixels that are entirely inside its triangles, at the
+//	farthest depth the triangle reaches in the pixel
+//	a box covers every pixel its screen rectangle touches, at its closest corner
+//so a box is only reported hidden when it really is.
+#include "glm/glm.hpp"
+
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+using namespace std;
+
+//counters since the culler was created
+struct OcclusionStats {
+	size_t frames;
+	size_t occluderTriangles;	//triangles rasterized, after clipping
+	size_t tested;	//boxes tested
+	size_t occluded;	//boxes found hidden
+	double rasterSeconds;	//clearing and rasterizing
+	double testSeconds;
+};
+
+class OcclusionCuller {
+public:
+	//PRE:
+	//	width, height: size of the depth buffer, rounded up to whole tiles. A quarter of
+	//		the window or less is plenty
+	//	threads: threads rasterizing rows of tiles including the caller, 0 uses every core
+	OcclusionCuller(int width = 256, int height = 128, int threads = 0);
+	~OcclusionCuller();
+
+	//start a frame seen through viewProj, the occluders of the last frame are dropped
+	void begin(const glm::mat4 &viewProj);
+	//add the triangles of an occluder
+	//PRE:
+	//	positions: 3 floats per vertex, every 3 vertices are a triangle, in any winding
+	//	stride: floats from one vertex to the next, eg. 5 for position and texture
+	//		coordinates
+	//	model: model matrix of the occluder
+	void addOccluder(const float *positions, int vertexCount, int stride,
+		const glm::mat4 &model);
+	//clear the buffer and rasterize every occluder added since begin()
+	void rasterize();
+
+	//whether a world space box may be visible, call after rasterize(). Boxes that
+	//reach behind the camera are always visible, frustum culling is up to the caller
+	bool visible(const glm::vec3 &min, const glm::vec3 &max);
+
+	//1 / w of the closest occluder in a pixel, 0 where there is none
+	float depth(int x, int y) const;
+	int width() const { return _width; }
+	int height() const { return _height; }
+	int threads() const { return (int)_workers.size() + 1; }
+
+	OcclusionStats stats() const { return _stats; }
+	//per frame averages
+	void report(ostream &out = cout);
+
+	static const int TILE_WIDTH = 8;
+	static const int TILE_HEIGHT = 4;
+
+private:
+	OcclusionCuller(const OcclusionCuller &);
+	OcclusionCuller &operator=(const OcclusionCuller &);
+
+	//a triangle in pixels, z is 1 / w and interpolates linearly on the screen
+	struct Triangle {
+		float x[3], y[3], z[3];
+	};
+
+	int _width, _height;
+	int _tiles_x, _tiles_y;
+	vector<float> _depth;	//tile after tile, rows of 8 pixels in a tile
+	vector<float> _tile_far;	//smallest 1 / w of each tile
+	glm::mat4 _view_proj;
+	vector<Triangle> _triangles;
+	OcclusionStats _stats;
+
+	//persistent workers, each rasterizes its own rows of tiles
+	vector<thread> _workers;
+	mutex _lock;
+	condition_variable _start, _done;
+	unsigned _generation;
+	int _running;
+	bool _quit;
+
+	void addClipped(const glm::vec4 *clip, int count);
+	void rasterizeBand(int band);
+	void workerLoop(int band);
+};
+
+#endif
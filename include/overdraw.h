@@ -0,0 +1,41 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+//this file contains an overdraw counter. Between begin() and end() every fragment that
+//passes the depth test increments the stencil buffer, end() reads the stencil back and
+//counts how many fragments were shaded for every pixel that was covered. Reading the
+//stencil stalls until the GPU is done, count a frame now and then, not every frame.
+//The framebuffer needs a stencil buffer, eg. glfwWindowHint(GLFW_STENCIL_BITS, 8).
+#include "glad/glad.h"
+
+#include <stddef.h>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+//fragments counted over one or more frames
+struct OverdrawSample {
+	size_t frames;
+	size_t fragments;	//fragments that passed the depth test
+	size_t pixels;	//pixels with at least one of them
+	int maxLayers;	//most fragments of one pixel, saturates at 255
+	double perPixel() const { return pixels ? (double)fragments / pixels : 0.0; }
+	void add(const OverdrawSample &other);
+};
+
+class OverdrawCounter {
+public:
+	//clear the stencil and count the fragments of the draws that follow
+	//POST:
+	//	return false if the framebuffer has no stencil buffer, nothing is counted then
+	static bool begin();
+	//stop counting and read the counts back
+	//PRE:
+	//	width, height: size of the framebuffer
+	static OverdrawSample end(int width, int height);
+
+	//eg. "overdraw (pre-pass on): 1.08 fragments per pixel, ..."
+	static void report(const OverdrawSample &sample, const char *label, ostream &out = cout);
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PARALLEL_DECODE_H
+#define PARALLEL_DECODE_H
+//this file contains the thread hook that lets stb_image decode large JPEGs on several
+//cores. Restart intervals are entropy decoded in parallel, the IDCT, upsampling and
+//color conversion are split between threads for every JPEG, see stbi_set_parallel_for
+//in stb_image.h. Images smaller than STBI_JPEG_PARALLEL_MIN_PIXELS stay on one thread.
+
+class ParallelDecode {
+public:
+	//install the hook for every following stbi_load* call, on any thread
+	//PRE:
+	//	threads: threads per image including the caller, 0 uses every core
+	static void enable(int threads = 0);
+	//decode on the calling thread only
+	static void disable();
+	//threads per image, 1 when disabled
+	static int threads();
+
+private:
+	static int _threads;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+//this file contains the cache textures and meshes are loaded through, so that nothing
+//is decoded or uploaded twice. A request is looked up by canonical path first, so
+//"textures/../textures/a.png" and "textures/a.png" are the same file, and then by a
+//64 bit hash of the content (XXH64), so a copy of a file under another name or the
+//same vertices given twice share one GL object. Meshes given from memory have no path
+//and are matched by content only.
+//Handles are reference counted and the GL object is deleted with the last handle, the
+//cache only keeps weak references. Use it on the GL thread and release every handle
+//before the context is destroyed.
+#include "glad/glad.h"
+#include "bc_encoder.h"
+#include "mip_builder.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+using namespace std;
+
+struct TextureResource {
+	unsigned int id;	//GL texture
+	string path;	//canonical path of the file it was first loaded from
+	uint64_t hash;	//content hash of the file and the load settings
+	size_t fileBytes;
+	~TextureResource();
+};
+typedef shared_ptr<TextureResource> TextureHandle;
+
+struct MeshResource {
+	unsigned int vao, vbo;
+	int vertexCount;
+	uint64_t hash;	//content hash of the vertices and their layout
+	//cooked meshes are indexed, the others are drawn with glDrawArrays
+	unsigned int ebo;	//0 if there are no indices
+	int indexCount;
+	GLenum indexType;	//GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	float boundsMin[3], boundsMax[3];	//of the positions, only set for cooked meshes
+	~MeshResource();
+};
+typedef shared_ptr<MeshResource> MeshHandle;
+
+//counters since the start of the program
+struct ResourceStats {
+	size_t loads;	//resources that were created
+	size_t pathHits;	//requests for a path that is already loaded
+	size_t contentHits;	//requests for another path or buffer with the same content
+	size_t bytesSaved;	//video memory the duplicates would have taken
+	size_t decodeBytesSaved;	//file bytes that weren't decoded again
+};
+
+class ResourceManager {
+public:
+	//load a texture with configTexture, or share the one already loaded from the same
+	//file or from a file with the same content and settings
+	//PRE:
+	//	path: image file, see configTexture for the other arguments
+	//POST:
+	//	return a handle to the texture, a texture that failed to load is empty and
+	//	isn't cached
+	static TextureHandle texture(const char *path, BCFormat compression = BC_NONE,
+		bool srgb = false, MipFilter mipFilter = MIP_BOX);
+
+	//upload interleaved float vertices into a vertex array, or share the one already
+	//holding the same vertices
+	//PRE:
+	//	label: name of the vertex buffer in the memory report
+	//	layout: floats of each attribute, attribute i is bound to location i
+	static MeshHandle mesh(const string &label, const float *vertices, int vertexCount,
+		const vector<int> &layout);
+	//upload one attribute of interleaved vertices tightly packed and bound to location
+	//0, eg. the positions for a depth-only pass
+	//POST:
+	//	return an empty handle if attribute isn't in the layout
+	static MeshHandle meshAttribute(const string &label, const float *vertices,
+		int vertexCount, const vector<int> &layout, int attribute);
+	//upload a mesh cooked by mesh_cooker, see mesh_file.h. The blobs are uploaded as
+	//they are read, from the pack mapping when the pack has the file. Attribute i of
+	//MeshAttribute is bound to location i
+	//POST:
+	//	return an empty handle if the file is missing or isn't a valid mesh file
+	static MeshHandle meshFile(const char *path);
+
+	static ResourceStats textureStats();
+	static ResourceStats meshStats();
+	static void report(ostream &out = cout);
+
+	//absolute path with symbolic links, "." and ".." resolved, the path itself if it
+	//doesn't exist
+	static string canonicalPath(const char *path);
+};
+
+#endif
@@ -14,12 +14,29 @@
 using namespace std;
 using namespace glm;
 
+//GL_ARB_get_program_binary is core in OpenGL 4.1 and is not part of our 3.3 glad loader,
+//these entry points stay NULL unless ShaderCache finds the extension and loads them
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, 
+	GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, 
+	const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern PFNGLGETPROGRAMBINARYPROC glGetProgramBinaryPtr;
+extern PFNGLPROGRAMBINARYPROC glProgramBinaryPtr;
+extern PFNGLPROGRAMPARAMETERIPROC glProgramParameteriPtr;
+
 class Shader{
 
 public: 
 	//constructor that builds and reads the shader
 	Shader(const char* vertexPath, const char* fragmentPath);
 
+	//constructor that creates an empty shader, the program should be built later 
+	//with compile() or loadBinary()
+	Shader();
+
 	//shader program ID
 	int ID;
 
@@ -38,12 +55,26 @@ public:
 	//set a mat4 unifrom in the shader
 	void setMat4(const string &name, mat4 value) const;
 
+	//compile and link the program from shader source code that is already in memory
+	//PRE:
+	//	vShaderCode, fShaderCode: complete glsl source of vertex and fragment shader
+	//	retrievable: whether the driver should keep the program binary, so that it 
+	//		can be read back with glGetProgramBinary later
+	//POST:
+	//	return true if the program is linked successfully
+	bool compile(const char *vShaderCode, const char *fShaderCode, bool retrievable = false);
+
+	//build the program from a binary returned by glGetProgramBinary
+	//POST:
+	//	return false if the driver rejects the binary, the shader then needs compile()
+	bool loadBinary(GLenum format, const void *binary, int length);
+
 
 private:
 	// check whether shader is compiled succesfully
-	void checkShaderSuccess(unsigned int shader);
+	bool checkShaderSuccess(unsigned int shader);
 	// check whether shader program is succesfully linked
-	void checkLinkSuccess(unsigned int ID);
+	bool checkLinkSuccess(unsigned int ID);
 
 };
 
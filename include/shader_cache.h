@@ -0,0 +1,84 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+//this file contains a glsl preprocessor and a cache of compiled shader variants.
+//a variant is a vertex/fragment file pair plus a list of #define lines, eg.
+//{"INSTANCED", "LIGHT_COUNT 4"}. Each variant is expanded (#include resolved and
+//#define lines injected after #version), hashed, and compiled only the first time it
+//is used. Variants that expand to the same source share one program.
+#include "shader.h"
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+struct ShaderVariant {
+	string vertexPath;
+	string fragmentPath;
+	vector<string> defines; //each entry is "NAME" or "NAME VALUE"
+
+	ShaderVariant(const string &vertex, const string &fragment,
+		const vector<string> &defs = vector<string>());
+};
+
+class ShaderPreprocessor {
+public:
+	//expand a glsl file
+	//	#include "file" is resolved relative to the including file, every file is
+	//	included at most once, #line directives keep compiler errors pointing at the
+	//	right line. defines are inserted right after the #version line.
+	//PRE:
+	//	path: path of the glsl file
+	//	defines: list of "NAME" or "NAME VALUE"
+	//POST:
+	//	return false and set error if a file cannot be read or includes nest too deep
+	static bool expand(const string &path, const vector<string> &defines,
+		string &out, string &error);
+
+	//64 bit FNV-1a hash of a string, used as the variant key
+	static uint64_t hash(const string &text, uint64_t seed = 14695981039346656037ULL);
+
+private:
+	static bool expandFile(const string &path, int depth, vector<string> &files,
+		string &out, string &error);
+};
+
+class ShaderCache {
+public:
+	//create a shader cache
+	//PRE:
+	//	diskCacheDir: directory used to store program binaries between runs, NULL to
+	//		only cache in memory. The disk cache needs GL_ARB_get_program_binary and
+	//		is silently disabled without it.
+	ShaderCache(const char *diskCacheDir = NULL);
+	~ShaderCache();
+
+	//get the shader of a variant, compile it if this is the first time it is used
+	//POST:
+	//	return NULL if the source cannot be expanded
+	Shader *get(const ShaderVariant &variant);
+
+	//compile every variant in the list now, so the first frame that uses them
+	//doesn't have to wait for the compiler
+	void prewarm(const vector<ShaderVariant> &variants);
+
+	//number of programs that are compiled
+	int size();
+	//number of programs loaded from the disk cache / compiled from source
+	int diskHits();
+	int compiled();
+
+private:
+	string _disk_dir;
+	bool _binary_supported;
+	int _disk_hits;
+	int _compiled;
+	map<string, uint64_t> _variant_hash; //variant description -> expanded source hash
+	map<uint64_t, Shader*> _programs; //expanded source hash -> program
+
+	static string variantKey(const ShaderVariant &variant);
+	string binaryPath(uint64_t hash);
+	Shader *loadFromDisk(uint64_t hash);
+	void saveToDisk(uint64_t hash, Shader *shader);
+};
+
+#endif
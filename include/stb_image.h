@@ -366,6 +366,38 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+////////////////////////////////////
+//
+// decode into caller-provided memory
+//
+// The image is written to 'dest' (e.g. a mapped pixel buffer object), rows are
+// 'dest_stride' bytes apart and 'dest_size' is the size of the whole buffer.
+// stbi_set_flip_vertically_on_load is applied while rows are written, not as a
+// separate pass. JPEG is decoded straight into 'dest'; other formats are decoded
+// to a temporary image and copied once. Use stbi_info first to size 'dest'.
+// Returns 1 on success, 0 on failure (see stbi_failure_reason).
+
+STBIDEF int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *channels_in_file, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into            (char const *filename, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
+////////////////////////////////////
+//
+// reduced size decode
+//
+// Decode at 1/2, 1/4 or 1/8 of the size, 'scale_log2' is 1, 2 or 3 (0 decodes at
+// full size). Sizes are rounded up, e.g. 1027 wide at 1/8 gives 129. JPEGs run a
+// 4x4, 2x2 or DC only IDCT per block, so they decode faster and never hold the
+// full size image; other formats are decoded at full size and box filtered.
+
+STBIDEF stbi_uc *stbi_load_scaled_from_memory(stbi_uc const *buffer, int len, int scale_log2, int *x, int *y, int *channels_in_file, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_scaled            (char const *filename, int scale_log2, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_scaled_from_file  (FILE *f, int scale_log2, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_file  (FILE *f, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
 ////////////////////////////////////
 //
 // 16-bits-per-channel interface
@@ -446,6 +478,18 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// decode large JPEGs on several threads. parallel_for must call task(task_user, i)
+// for every i in [0, count), in any order and on any threads, and return once every
+// call has finished. Baseline scans with restart markers are entropy decoded in
+// parallel; other scans decode Huffman data on the calling thread and run the IDCT
+// in parallel afterwards. Upsampling and color conversion are split by rows. Pass
+// NULL to decode on the calling thread only (the default). To find the restart
+// markers, a JPEG read from a file or callbacks is read to its end, so
+// stbi_load_from_file may leave the file past the image.
+typedef void stbi_parallel_task(void *task_user, int index);
+typedef void stbi_parallel_for(void *user, int count, stbi_parallel_task *task, void *task_user);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for, void *user);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -702,6 +746,14 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   // caller-provided output for stbi_load_into*, NULL otherwise
+   stbi_uc *out_dest;
+   int out_stride;
+   size_t out_size;
+
+   // stbi_load_scaled*: log2 of the reduction, and whether the loader applied it
+   int scale, scaled;
 } stbi__context;
 
 
@@ -712,6 +764,8 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
    s->io.read = NULL;
    s->read_from_callbacks = 0;
+   s->out_dest = NULL;
+   s->scale = s->scaled = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
 }
@@ -723,6 +777,8 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
+   s->out_dest = NULL;
+   s->scale = s->scaled = 0;
    s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
@@ -969,6 +1025,15 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static stbi_parallel_for *stbi__parallel_for = NULL;
+static void *stbi__parallel_user = NULL;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for, void *user)
+{
+   stbi__parallel_for = parallel_for;
+   stbi__parallel_user = user;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1106,6 +1171,95 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
    return (unsigned char *) result;
 }
 
+static int stbi__load_into_8bit(stbi__context *s, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__result_info ri;
+   void *result;
+   int channels, row;
+   size_t row_bytes;
+
+   s->out_dest = dest;
+   s->out_stride = dest_stride;
+   s->out_size = dest_size;
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   s->out_dest = NULL;
+   if (result == NULL)
+      return 0;
+   // the decoder already wrote (and flipped) the rows into dest
+   if (result == dest)
+      return 1;
+
+   if (ri.bits_per_channel != 8) {
+      STBI_ASSERT(ri.bits_per_channel == 16);
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, req_comp == 0 ? *comp : req_comp);
+      if (result == NULL) return 0;
+   }
+
+   channels = req_comp ? req_comp : *comp;
+   row_bytes = (size_t) *x * channels;
+   if ((size_t) dest_stride < row_bytes || (size_t) dest_stride * (*y - 1) + row_bytes > dest_size) {
+      STBI_FREE(result);
+      return stbi__err("dest too small", "Destination buffer too small");
+   }
+   // copy once, flipping as we go
+   for (row = 0; row < *y; ++row) {
+      int dest_row = stbi__vertically_flip_on_load ? *y - 1 - row : row;
+      memcpy(dest + (size_t) dest_row * dest_stride, (stbi_uc *) result + row * row_bytes, row_bytes);
+   }
+   STBI_FREE(result);
+   return 1;
+}
+
+// average 2^scale x 2^scale boxes, boxes on the right and bottom edge may be smaller
+static stbi_uc *stbi__box_downsample(stbi_uc *image, int *x, int *y, int channels, int scale)
+{
+   int w = (*x + (1 << scale) - 1) >> scale, h = (*y + (1 << scale) - 1) >> scale;
+   int i,j,c,bx,by;
+   stbi_uc *result = (stbi_uc *) stbi__malloc_mad3(w, h, channels, 0);
+   if (result == NULL) {
+      STBI_FREE(image);
+      return stbi__errpuc("outofmem", "Out of memory");
+   }
+   for (j=0; j < h; ++j) {
+      int y0 = j << scale, y1 = y0 + (1 << scale) < *y ? y0 + (1 << scale) : *y;
+      for (i=0; i < w; ++i) {
+         int x0 = i << scale, x1 = x0 + (1 << scale) < *x ? x0 + (1 << scale) : *x;
+         int count = (x1 - x0) * (y1 - y0);
+         for (c=0; c < channels; ++c) {
+            int sum = count / 2;
+            for (by=y0; by < y1; ++by)
+               for (bx=x0; bx < x1; ++bx)
+                  sum += image[((size_t) by * *x + bx) * channels + c];
+            result[((size_t) j * w + i) * channels + c] = (stbi_uc) (sum / count);
+         }
+      }
+   }
+   STBI_FREE(image);
+   *x = w;
+   *y = h;
+   return result;
+}
+
+static stbi_uc *stbi__load_scaled_8bit(stbi__context *s, int scale, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_uc *result;
+   if (scale < 0 || scale > 3) return stbi__errpuc("bad scale", "Scale must be 0 to 3");
+   s->scale = scale;
+   result = stbi__load_and_postprocess_8bit(s, x, y, comp, req_comp);
+   // loaders that can't decode at a reduced size return the full image. It is
+   // downsampled in file order, so a partial last row ends up where the decoders
+   // that scale put it: at the bottom, or first in memory when flipped
+   if (result && scale && !s->scaled) {
+      int channels = req_comp ? req_comp : *comp;
+      if (stbi__vertically_flip_on_load)
+         stbi__vertical_flip(result, *x, *y, channels);
+      result = stbi__box_downsample(result, x, y, channels, scale);
+      if (result && stbi__vertically_flip_on_load)
+         stbi__vertical_flip(result, *x, *y, channels);
+   }
+   return result;
+}
+
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
@@ -1179,6 +1333,52 @@ STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req
    return result;
 }
 
+STBIDEF stbi_uc *stbi_load_scaled(char const *filename, int scale_log2, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_load_scaled_from_file(f,scale_log2,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_scaled_from_file(FILE *f, int scale_log2, int *x, int *y, int *comp, int req_comp)
+{
+   unsigned char *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_scaled_8bit(&s,scale_log2,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_into_from_file(f,dest,dest_stride,dest_size,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_into_from_file(FILE *f, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *comp, int req_comp)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_into_8bit(&s,dest,dest_stride,dest_size,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
 STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp, int req_comp)
 {
    stbi__uint16 *result;
@@ -1233,6 +1433,20 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_scaled_from_memory(stbi_uc const *buffer, int len, int scale_log2, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_scaled_8bit(&s,scale_log2,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *dest, int dest_stride, size_t dest_size, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into_8bit(&s,dest,dest_stride,dest_size,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -1745,6 +1959,10 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+   int parallel;         // split work with stbi__parallel_for
+   int scale;            // log2 of the reduction, blocks decode to (8 >> scale) pixels
+   stbi_uc *stream_copy; // rest of a callback stream, read to find restart markers
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -2201,6 +2419,69 @@ stbi_inline static stbi_uc stbi__clamp(int x)
    t1 += p2+p4;                                \
    t0 += p1+p3;
 
+// reduced size idct: an N point idct of the top-left NxN coefficients gives the
+// block scaled down by 8/N, output x = sum over u of C(u)/2 cos((2x+1)u pi / 2N) F(u)
+// in both directions. the 4 point idct splits into even and odd halves
+#define STBI__IDCT_4(s0,s1,s2,s3, x0,x1,x2,x3) \
+   { \
+   int e0 = ((s0) + (s2)) * stbi__f2f(0.353553391f); \
+   int e1 = ((s0) - (s2)) * stbi__f2f(0.353553391f); \
+   int o0 = (s1) * stbi__f2f(0.461939766f) + (s3) * stbi__f2f(0.191341716f); \
+   int o1 = (s1) * stbi__f2f(0.191341716f) - (s3) * stbi__f2f(0.461939766f); \
+   x0 = e0 + o0; x1 = e1 + o1; x2 = e1 - o1; x3 = e0 - o0; \
+   }
+
+static void stbi__idct_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   int tmp[16], i, dc;
+   // flat blocks are common, they only need the average
+   if (!(data[1]|data[2]|data[3]|data[8]|data[9]|data[10]|data[11]|data[16]|data[17]|data[18]|data[19]|data[24]|data[25]|data[26]|data[27])) {
+      dc = data[0] + 1024 + 4;
+      dc = stbi__clamp(dc < 0 ? 0 : dc >> 3);
+      for (i=0; i < 4; ++i)
+         out[i*out_stride] = out[i*out_stride+1] = out[i*out_stride+2] = out[i*out_stride+3] = (stbi_uc) dc;
+      return;
+   }
+   // columns, keeping 2 fractional bits
+   for (i=0; i < 4; ++i) {
+      int x0,x1,x2,x3;
+      STBI__IDCT_4(data[i], data[8+i], data[16+i], data[24+i], x0,x1,x2,x3)
+      tmp[i]    = (x0 + 512) >> 10;
+      tmp[4+i]  = (x1 + 512) >> 10;
+      tmp[8+i]  = (x2 + 512) >> 10;
+      tmp[12+i] = (x3 + 512) >> 10;
+   }
+   // rows, with the level shift and rounding folded into one bias
+   for (i=0; i < 4; ++i, out += out_stride) {
+      int x0,x1,x2,x3, bias = (128 << 14) + (1 << 13);
+      STBI__IDCT_4(tmp[i*4], tmp[i*4+1], tmp[i*4+2], tmp[i*4+3], x0,x1,x2,x3)
+      out[0] = stbi__clamp((x0 + bias) >> 14);
+      out[1] = stbi__clamp((x1 + bias) >> 14);
+      out[2] = stbi__clamp((x2 + bias) >> 14);
+      out[3] = stbi__clamp((x3 + bias) >> 14);
+   }
+}
+
+static void stbi__idct_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   // both directions are (a +- b) / sqrt(8), so each pixel is a sum of 4 terms / 8
+   int a = data[0] + data[8], b = data[0] - data[8];
+   int c = data[1] + data[9], d = data[1] - data[9];
+   int bias = 1024 + 4;
+   out[0]            = stbi__clamp((a + c + bias) >> 3);
+   out[1]            = stbi__clamp((a - c + bias) >> 3);
+   out[out_stride]   = stbi__clamp((b + d + bias) >> 3);
+   out[out_stride+1] = stbi__clamp((b - d + bias) >> 3);
+}
+
+static void stbi__idct_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // the block average is DC/8, plus the level shift
+   int v = data[0] + 1024 + 4;
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(v < 0 ? 0 : v >> 3);
+}
+
 static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
 {
    int i,val[64],*v=val;
@@ -2683,9 +2964,211 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+#ifndef STBI_JPEG_PARALLEL_MIN_PIXELS
+#define STBI_JPEG_PARALLEL_MIN_PIXELS (512*512) // smaller images aren't worth the threads
+#endif
+#define STBI__JPEG_MAX_TASKS 32
+
+// run task for [0, count) with the parallel_for hook, or on this thread when the
+// image is decoded serially
+static void stbi__jpeg_run(stbi__jpeg *z, int count, stbi_parallel_task *task, void *task_user)
+{
+   int i;
+   if (z->parallel && stbi__parallel_for && count > 1)
+      stbi__parallel_for(stbi__parallel_user, count, task, task_user);
+   else
+      for (i=0; i < count; ++i)
+         task(task_user, i);
+}
+
+// where the idct of block (bx,by) of component n goes, planes of a reduced size
+// decode hold (8 >> scale) pixels per block
+static stbi_uc *stbi__jpeg_block_out(stbi__jpeg *z, int n, int bx, int by)
+{
+   int size = 8 >> z->scale;
+   return z->img_comp[n].data + (z->img_comp[n].w2 >> z->scale)*by*size + bx*size;
+}
+
+// decode one baseline block at block coordinates (bx,by) of component n. it goes
+// through the IDCT right away, or is kept for stbi__jpeg_finish if the component
+// has a coefficient buffer
+static int stbi__jpeg_decode_block_at(stbi__jpeg *z, int n, int bx, int by, short *block)
+{
+   int ha = z->img_comp[n].ha;
+   short *data = z->img_comp[n].coeff ? z->img_comp[n].coeff + 64 * (bx + by * z->img_comp[n].coeff_w) : block;
+   if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+   if (!z->img_comp[n].coeff)
+      z->idct_block_kernel(stbi__jpeg_block_out(z, n, bx, by), z->img_comp[n].w2 >> z->scale, data);
+   return 1;
+}
+
+// number of MCUs in the current scan, single component scans have one block per MCU
+static int stbi__jpeg_scan_mcus(stbi__jpeg *z)
+{
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      return ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   }
+   return z->img_mcu_x * z->img_mcu_y;
+}
+
+// decode baseline MCUs [first, first+count) of the current scan, without looking
+// for restart markers
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int count)
+{
+   STBI_SIMD_ALIGN(short, block[64]);
+   int m,k,x,y;
+   for (m=first; m < first+count; ++m) {
+      if (z->scan_n == 1) {
+         int n = z->order[0];
+         int w = (z->img_comp[n].x+7) >> 3;
+         if (!stbi__jpeg_decode_block_at(z, n, m % w, m / w, block)) return 0;
+      } else {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y=0; y < z->img_comp[n].v; ++y)
+               for (x=0; x < z->img_comp[n].h; ++x)
+                  if (!stbi__jpeg_decode_block_at(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y, block)) return 0;
+         }
+      }
+   }
+   return 1;
+}
+
+// read the rest of a callback stream into memory, the context reads from that copy
+// afterwards. it is freed by stbi__jpeg_load
+static int stbi__jpeg_buffer_stream(stbi__jpeg *z)
+{
+   stbi__context *s = z->s;
+   int len = (int) (s->img_buffer_end - s->img_buffer);
+   int cap = len + 65536, count;
+   stbi_uc *buffer;
+   if (!s->io.read) return 1;
+   buffer = (stbi_uc *) stbi__malloc(cap);
+   if (!buffer) return stbi__err("outofmem", "Out of memory");
+   memcpy(buffer, s->img_buffer, len);
+   if (s->read_from_callbacks) {
+      while ((count = (s->io.read)(s->io_user_data, (char *) buffer + len, cap - len)) > 0) {
+         len += count;
+         if (len == cap) {
+            stbi_uc *grown;
+            if (cap > (1 << 29)) { STBI_FREE(buffer); return stbi__err("too large", "JPEG too large"); }
+            grown = (stbi_uc *) STBI_REALLOC_SIZED(buffer, cap, cap * 2);
+            if (!grown) { STBI_FREE(buffer); return stbi__err("outofmem", "Out of memory"); }
+            buffer = grown;
+            cap *= 2;
+         }
+      }
+   }
+   z->stream_copy = buffer;
+   s->io.read = NULL;
+   s->read_from_callbacks = 0;
+   s->img_buffer = buffer;
+   s->img_buffer_end = buffer + len;
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **segments; // start of each restart interval, and the end of the scan
+   int intervals, tasks, mcus;
+   volatile int failed;
+} stbi__jpeg_scan_job;
+
+static void stbi__jpeg_scan_task(void *user, int index)
+{
+   stbi__jpeg_scan_job *job = (stbi__jpeg_scan_job *) user;
+   int first = (int) ((stbi__uint32) index * job->intervals / job->tasks);
+   int last = (int) ((stbi__uint32) (index+1) * job->intervals / job->tasks);
+   int k, ri = job->z->restart_interval;
+   stbi__context s;
+   // every task needs its own bit reader and dc predictions
+   stbi__jpeg *j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) { job->failed = 1; return; }
+   memcpy(j, job->z, sizeof(stbi__jpeg));
+   j->s = &s;
+   for (k=first; k < last && !job->failed; ++k) {
+      int count = job->mcus - k * ri < ri ? job->mcus - k * ri : ri;
+      stbi__start_mem(&s, job->segments[k], (int) (job->segments[k+1] - job->segments[k]));
+      stbi__jpeg_reset(j);
+      if (!stbi__jpeg_decode_mcus(j, k * ri, count)) job->failed = 1;
+   }
+   STBI_FREE(j);
+}
+
+// decode a baseline scan with the parallel_for hook. returns -1 when the scan has
+// to be decoded serially
+static int stbi__jpeg_parallel_scan(stbi__jpeg *z)
+{
+   stbi__context *s = z->s;
+   stbi__jpeg_scan_job job;
+   stbi_uc *p, *end, marker = STBI__MARKER_none;
+   int mcus = stbi__jpeg_scan_mcus(z), found, k;
+
+   if (!z->restart_interval) {
+      // no independent intervals: Huffman decode here, the IDCT runs in parallel in
+      // stbi__jpeg_finish
+      for (k=0; k < z->scan_n; ++k) {
+         int n = z->order[k];
+         if (z->img_comp[n].coeff) continue;
+         z->img_comp[n].coeff_w = z->img_comp[n].w2 / 8;
+         z->img_comp[n].coeff_h = z->img_comp[n].h2 / 8;
+         z->img_comp[n].raw_coeff = stbi__malloc_mad3(z->img_comp[n].w2, z->img_comp[n].h2, sizeof(short), 15);
+         if (z->img_comp[n].raw_coeff == NULL) return stbi__err("outofmem", "Out of memory");
+         z->img_comp[n].coeff = (short*) (((size_t) z->img_comp[n].raw_coeff + 15) & ~15);
+      }
+      return stbi__jpeg_decode_mcus(z, 0, mcus);
+   }
+
+   job.intervals = (mcus + z->restart_interval - 1) / z->restart_interval;
+   if (job.intervals < 2) return -1;
+   if (!stbi__jpeg_buffer_stream(z)) return 0;
+   job.segments = (stbi_uc **) stbi__malloc_mad2(job.intervals + 1, sizeof(stbi_uc *), 0);
+   if (!job.segments) return -1;
+
+   // find the RSTn markers and the marker that ends the scan
+   p = s->img_buffer;
+   end = s->img_buffer_end;
+   job.segments[0] = p;
+   found = 1;
+   while (p < end) {
+      stbi_uc *q;
+      if (*p++ != 0xff) continue;
+      q = p;
+      while (q < end && *q == 0xff) ++q; // fill bytes
+      if (q == end) break;
+      if (*q == 0) { p = q + 1; continue; } // stuffed zero
+      if (!STBI__RESTART(*q)) { marker = *q; end = p - 1; p = q + 1; break; }
+      if (found > job.intervals) break;
+      job.segments[found++] = q + 1;
+      p = q + 1;
+   }
+   if (found != job.intervals) { STBI_FREE(job.segments); return -1; }
+   job.segments[found] = end;
+
+   job.z = z;
+   job.mcus = mcus;
+   job.tasks = job.intervals < STBI__JPEG_MAX_TASKS ? job.intervals : STBI__JPEG_MAX_TASKS;
+   job.failed = 0;
+   stbi__jpeg_run(z, job.tasks, stbi__jpeg_scan_task, &job);
+   STBI_FREE(job.segments);
+   if (job.failed) return 0;
+
+   // continue after the scan as if it had been read serially
+   s->img_buffer = p;
+   z->marker = marker;
+   return 1;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
+   if (!z->progressive && z->parallel) {
+      int r = stbi__jpeg_parallel_scan(z);
+      if (r >= 0) return r;
+   }
    if (!z->progressive) {
       if (z->scan_n == 1) {
          int i,j;
@@ -2701,7 +3184,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, j), z->img_comp[n].w2 >> z->scale, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2725,11 +3208,11 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = i*z->img_comp[n].h + x;
+                        int y2 = j*z->img_comp[n].v + y;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        z->idct_block_kernel(stbi__jpeg_block_out(z, n, x2, y2), z->img_comp[n].w2 >> z->scale, data);
                      }
                   }
                }
@@ -2814,25 +3297,38 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
+// one task per row of blocks of every component with coefficients
+static void stbi__jpeg_finish_task(void *user, int index)
 {
-   if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-               stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
-         }
+   stbi__jpeg *z = (stbi__jpeg *) user;
+   int i,n;
+   for (n=0; n < z->s->img_n; ++n) {
+      int w = (z->img_comp[n].x+7) >> 3;
+      int h = (z->img_comp[n].y+7) >> 3;
+      if (!z->img_comp[n].coeff) continue;
+      if (index >= h) { index -= h; continue; }
+      for (i=0; i < w; ++i) {
+         short *data = z->img_comp[n].coeff + 64 * (i + index * z->img_comp[n].coeff_w);
+         // baseline blocks were dequantized while decoding
+         if (z->progressive)
+            stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+         z->idct_block_kernel(stbi__jpeg_block_out(z, n, i, index), z->img_comp[n].w2 >> z->scale, data);
       }
+      return;
    }
 }
 
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+   // dequantize and idct the data of progressive images, and of baseline scans
+   // that were kept as coefficients for a parallel idct
+   int n, rows = 0;
+   for (n=0; n < z->s->img_n; ++n)
+      if (z->img_comp[n].coeff)
+         rows += (z->img_comp[n].y+7) >> 3;
+   stbi__jpeg_run(z, rows, stbi__jpeg_finish_task, z);
+}
+
 static int stbi__process_marker(stbi__jpeg *z, int m)
 {
    int L;
@@ -3061,7 +3557,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale, z->img_comp[i].h2 >> z->scale, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3122,7 +3618,9 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       j->img_comp[m].raw_coeff = NULL;
    }
    j->restart_interval = 0;
+   j->parallel = 0;
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
+   j->parallel = stbi__parallel_for != NULL && (size_t) j->s->img_x * j->s->img_y >= STBI_JPEG_PARALLEL_MIN_PIXELS;
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
@@ -3149,8 +3647,7 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       }
       m = stbi__get_marker(j);
    }
-   if (j->progressive)
-      stbi__jpeg_finish(j);
+   stbi__jpeg_finish(j);
    return 1;
 }
 
@@ -3385,7 +3882,7 @@ static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc
       out[0] = (stbi_uc)r;
       out[1] = (stbi_uc)g;
       out[2] = (stbi_uc)b;
-      out[3] = 255;
+      if (step == 4) out[3] = 255; // don't write past the row, it may end a caller's buffer
       out += step;
    }
 }
@@ -3519,7 +4016,7 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
       out[0] = (stbi_uc)r;
       out[1] = (stbi_uc)g;
       out[2] = (stbi_uc)b;
-      out[3] = 255;
+      if (step == 4) out[3] = 255;
       out += step;
    }
 }
@@ -3531,6 +4028,9 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->parallel = 0;
+   j->scale = 0;
+   j->stream_copy = NULL;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3570,6 +4070,155 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *output;
+   stbi_uc *linebuf; // decode_n line buffers per task
+   int n, decode_n, is_rgb, tasks;
+} stbi__jpeg_output_job;
+
+static void stbi__jpeg_resample_advance(stbi__resample *r, int comp_y, int w2)
+{
+   if (++r->ystep >= r->vs) {
+      r->ystep = 0;
+      r->line0 = r->line1;
+      if (++r->ypos < comp_y)
+         r->line1 += w2;
+   }
+}
+
+// resample and color-convert a band of output rows
+static void stbi__jpeg_output_task(void *user, int index)
+{
+   stbi__jpeg_output_job *job = (stbi__jpeg_output_job *) user;
+   stbi__jpeg *z = job->z;
+   int n = job->n, decode_n = job->decode_n, is_rgb = job->is_rgb, k;
+   unsigned int i,j;
+   unsigned int first = (unsigned int) ((size_t) index * z->s->img_y / job->tasks);
+   unsigned int last = (unsigned int) ((size_t) (index+1) * z->s->img_y / job->tasks);
+   stbi_uc *output = job->output;
+   stbi_uc *coutput[4];
+   stbi_uc *linebuf[4];
+   stbi__resample res_comp[4];
+
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+      linebuf[k] = job->linebuf + (size_t) (index * decode_n + k) * (z->s->img_x + 3);
+
+      r->hs      = z->img_h_max / z->img_comp[k].h;
+      r->vs      = z->img_v_max / z->img_comp[k].v;
+      r->ystep   = r->vs >> 1;
+      r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
+      r->ypos    = 0;
+      r->line0   = r->line1 = z->img_comp[k].data;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+      else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+      else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+      else                               r->resample = stbi__resample_row_generic;
+
+      // skip to the first row of the band
+      for (j=0; j < first; ++j)
+         stbi__jpeg_resample_advance(r, z->img_comp[k].y, z->img_comp[k].w2);
+   }
+
+   for (j=first; j < last; ++j) {
+      stbi_uc *out;
+      if (z->s->out_dest)
+         out = output + (size_t) z->s->out_stride * (stbi__vertically_flip_on_load ? z->s->img_y - 1 - j : j);
+      else
+         out = output + n * z->s->img_x * j;
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         stbi__jpeg_resample_advance(r, z->img_comp[k].y, z->img_comp[k].w2);
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  if (n == 4) out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  if (n == 4) out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               if (n == 4) out[3] = 255;
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+         }
+      }
+   }
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3581,6 +4230,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   if (z->scale) {
+      // the component planes hold the image at its reduced size
+      int k, round = (1 << z->scale) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale;
+      z->s->img_y = (z->s->img_y + round) >> z->scale;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].y = (z->img_comp[k].y + round) >> z->scale;
+         z->img_comp[k].w2 >>= z->scale;
+      }
+      z->s->scaled = 1;
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3593,134 +4254,40 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
+      stbi__jpeg_output_job job;
       stbi_uc *output;
-      stbi_uc *coutput[4];
-
-      stbi__resample res_comp[4];
 
-      for (k=0; k < decode_n; ++k) {
-         stbi__resample *r = &res_comp[k];
+      job.z = z;
+      job.n = n;
+      job.decode_n = decode_n;
+      job.is_rgb = is_rgb;
+      job.tasks = z->parallel ? STBI__JPEG_MAX_TASKS : 1;
+      if (job.tasks > (int) z->s->img_y) job.tasks = z->s->img_y;
 
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
-      }
+      // allocate line buffers big enough for upsampling off the edges
+      // with upsample factor of 4
+      job.linebuf = (stbi_uc *) stbi__malloc_mad3(job.tasks * decode_n, z->s->img_x + 3, 1, 0);
+      if (!job.linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-            }
+      if (z->s->out_dest) {
+         // write rows straight into the caller's buffer, flipped if requested
+         size_t row_bytes = (size_t) n * z->s->img_x;
+         if ((size_t) z->s->out_stride < row_bytes || (size_t) z->s->out_stride * (z->s->img_y - 1) + row_bytes > z->s->out_size) {
+            STBI_FREE(job.linebuf);
+            stbi__cleanup_jpeg(z);
+            return stbi__errpuc("dest too small", "Destination buffer too small");
          }
+         output = z->s->out_dest;
+      } else {
+         output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+         if (!output) { STBI_FREE(job.linebuf); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
       }
+
+      // now go ahead and resample
+      job.output = output;
+      stbi__jpeg_run(z, job.tasks, stbi__jpeg_output_task, &job);
+      STBI_FREE(job.linebuf);
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
@@ -3736,7 +4303,17 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   if (s->scale) {
+      static void (*const kernels[4])(stbi_uc *out, int out_stride, short data[64]) = { NULL, stbi__idct_4x4, stbi__idct_2x2, stbi__idct_1x1 };
+      j->scale = s->scale;
+      j->idct_block_kernel = kernels[s->scale];
+   }
    result = load_jpeg_image(j, x,y,comp,req_comp);
+   if (j->stream_copy) {
+      // the context pointed into the copy, leave it at the end of the stream
+      STBI_FREE(j->stream_copy);
+      s->img_buffer = s->img_buffer_end = s->buffer_start;
+   }
    STBI_FREE(j);
    return result;
 }
@@ -3786,7 +4363,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  11 // codes up to 11 bits take one lookup, 9 covers the default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
 // zlib-style huffman encoding
@@ -3893,6 +4470,15 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+   if (z->zbuffer_end - z->zbuffer >= 4) {
+      // enough input left that the end check can be skipped per byte
+      do {
+         STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
+         z->code_buffer |= (unsigned int) *z->zbuffer++ << z->num_bits;
+         z->num_bits += 8;
+      } while (z->num_bits <= 24);
+      return;
+   }
    do {
       STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
       z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
@@ -4008,8 +4594,22 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
          }
          p = (stbi_uc *) (zout - dist);
          if (dist == 1) { // run of one byte; common in images.
-            stbi_uc v = *p;
-            if (len) { do *zout++ = v; while (--len); }
+            memset(zout, *p, len);
+            zout += len;
+         } else if (dist >= len) { // source and destination don't overlap
+            memcpy(zout, p, len);
+            zout += len;
+         } else if (dist >= 8 && a->zout_end - zout >= len + 8) {
+            // repeating pattern at least 8 bytes long: copy 8 bytes at a time, each
+            // chunk only reads bytes that are already written. this may write up to
+            // 7 bytes past the match, which the next symbols overwrite
+            char *end = zout + len;
+            do {
+               memcpy(zout, p, 8);
+               zout += 8;
+               p += 8;
+            } while (zout < end);
+            zout = end;
          } else {
             if (len) { do *zout++ = *p++; while (--len); }
          }
@@ -4324,6 +4924,215 @@ static int stbi__paeth(int a, int b, int c)
    return c;
 }
 
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+// SIMD unfiltering of 8-bit RGBA rows, and of RGB rows expanded to RGBA. sub, avg
+// and paeth depend on the pixel to the left, so they can't be vectorized along the
+// row; instead every channel of one pixel is processed at once, the same way libpng
+// does it. up has no such dependency and runs 16 bytes at a time. pixels are loaded
+// and stored with memcpy; a 3 byte pixel is moved as 4 bytes except at the end of the
+// row, the extra byte belongs to the next pixel which is written afterwards. RGB rows
+// that stay RGB take the scalar loops, the per-pixel path measured slower on them.
+#if defined(__GNUC__) && !defined(_MSC_VER)
+// the row loop must be inlined into each caller for the memcpy sizes to be constant
+#define stbi__px_inline __inline__ __attribute__((always_inline))
+#else
+#define stbi__px_inline stbi_inline
+#endif
+
+#ifdef STBI_SSE2
+typedef __m128i stbi__px;
+
+stbi__px_inline static stbi__px stbi__px_load(const stbi_uc *p, int n, int last)
+{
+   int v = 0;
+   if (n == 4 || !last) memcpy(&v, p, 4); else memcpy(&v, p, 3);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi__px_inline static void stbi__px_store(stbi_uc *p, stbi__px v, int n, int last)
+{
+   int w = _mm_cvtsi128_si32(v);
+   if (n == 4 || !last) memcpy(p, &w, 4); else memcpy(p, &w, 3);
+}
+
+#define stbi__px_zero()    _mm_setzero_si128()
+
+#define stbi__px_add(a,b)  _mm_add_epi8(a,b)
+#define stbi__px_or(a,b)   _mm_or_si128(a,b)
+
+stbi_inline static stbi__px stbi__px_avg(stbi__px a, stbi__px b)
+{
+   // pavgb rounds up, (a+b)>>1 rounds down
+   stbi__px odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+   return _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+}
+
+stbi_inline static stbi__px stbi__px_abs16(stbi__px v)
+{
+   return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+stbi_inline static stbi__px stbi__px_select(stbi__px mask, stbi__px t, stbi__px e)
+{
+   return _mm_or_si128(_mm_and_si128(mask, t), _mm_andnot_si128(mask, e));
+}
+
+stbi_inline static stbi__px stbi__px_paeth(stbi__px a8, stbi__px b8, stbi__px c8)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = _mm_unpacklo_epi8(a8, zero);
+   __m128i b = _mm_unpacklo_epi8(b8, zero);
+   __m128i c = _mm_unpacklo_epi8(c8, zero);
+   // p = a+b-c, so p-a = b-c, p-b = a-c and p-c = (b-c)+(a-c)
+   __m128i pa = _mm_sub_epi16(b, c);
+   __m128i pb = _mm_sub_epi16(a, c);
+   __m128i pc = _mm_add_epi16(pa, pb);
+   __m128i smallest, pred;
+   pa = stbi__px_abs16(pa);
+   pb = stbi__px_abs16(pb);
+   pc = stbi__px_abs16(pc);
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+   // ties favor a over b over c
+   pred = stbi__px_select(_mm_cmpeq_epi16(smallest, pa), a,
+          stbi__px_select(_mm_cmpeq_epi16(smallest, pb), b, c));
+   return _mm_packus_epi16(pred, zero);
+}
+
+stbi_inline static void stbi__unfilter_up16(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior)
+{
+   __m128i r = _mm_loadu_si128((const __m128i *) raw);
+   __m128i p = _mm_loadu_si128((const __m128i *) prior);
+   _mm_storeu_si128((__m128i *) cur, _mm_add_epi8(r, p));
+}
+#else // STBI_NEON
+typedef uint8x8_t stbi__px;
+
+stbi__px_inline static stbi__px stbi__px_load(const stbi_uc *p, int n, int last)
+{
+   stbi__uint32 v = 0;
+   if (n == 4 || !last) memcpy(&v, p, 4); else memcpy(&v, p, 3);
+   return vreinterpret_u8_u32(vdup_n_u32(v));
+}
+
+stbi__px_inline static void stbi__px_store(stbi_uc *p, stbi__px v, int n, int last)
+{
+   stbi__uint32 w = vget_lane_u32(vreinterpret_u32_u8(v), 0);
+   if (n == 4 || !last) memcpy(p, &w, 4); else memcpy(p, &w, 3);
+}
+
+#define stbi__px_zero()    vdup_n_u8(0)
+
+#define stbi__px_add(a,b)  vadd_u8(a,b)
+#define stbi__px_or(a,b)   vorr_u8(a,b)
+#define stbi__px_avg(a,b)  vhadd_u8(a,b) // halving add rounds down, like (a+b)>>1
+
+stbi_inline static stbi__px stbi__px_paeth(stbi__px a8, stbi__px b8, stbi__px c8)
+{
+   int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(a8));
+   int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(b8));
+   int16x8_t c = vreinterpretq_s16_u16(vmovl_u8(c8));
+   int16x8_t pa = vsubq_s16(b, c);
+   int16x8_t pb = vsubq_s16(a, c);
+   int16x8_t pc = vabsq_s16(vaddq_s16(pa, pb));
+   uint16x8_t use_a, use_b;
+   int16x8_t pred;
+   pa = vabsq_s16(pa);
+   pb = vabsq_s16(pb);
+   use_a = vandq_u16(vcleq_s16(pa, pb), vcleq_s16(pa, pc));
+   use_b = vcleq_s16(pb, pc);
+   pred = vbslq_s16(use_a, a, vbslq_s16(use_b, b, c));
+   return vmovn_u16(vreinterpretq_u16_s16(pred));
+}
+
+stbi_inline static void stbi__unfilter_up16(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior)
+{
+   vst1q_u8(cur, vaddq_u8(vld1q_u8(raw), vld1q_u8(prior)));
+}
+#endif
+
+// unfilter n pixels; cur[-out_n] and prior[-out_n] are the pixels to the left.
+// when out_n == img_n+1 the extra channel is set to 255. img_n and out_n are
+// constants at every call site so the memcpys become plain moves.
+stbi__px_inline static void stbi__unfilter_px_row(int filter, stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, stbi__uint32 n, int img_n, int out_n)
+{
+   static const stbi_uc opaque[4] = { 0,0,0,255 };
+   stbi__px alpha = out_n != img_n ? stbi__px_load(opaque, 4, 1) : stbi__px_zero();
+   stbi__px a = stbi__px_load(cur - out_n, img_n, 1), b, c;
+   stbi__uint32 i;
+   int last;
+
+   // last is set for the final pixel, which must not be moved as 4 bytes
+   #define STBI__PX_LOOP(step_prior) \
+      for (i=0, last = n == 1; i < n; ++i, last = i+1 == n, raw += img_n, cur += out_n, prior += step_prior)
+   #define STBI__PX_STORE(v) stbi__px_store(cur, stbi__px_or(v, alpha), out_n, last)
+   switch (filter) {
+      case STBI__F_none:
+         STBI__PX_LOOP(0) STBI__PX_STORE(stbi__px_load(raw, img_n, last));
+         break;
+      case STBI__F_sub:
+      case STBI__F_paeth_first: // paeth(a,0,0) is always a
+         STBI__PX_LOOP(0) {
+            a = stbi__px_add(stbi__px_load(raw, img_n, last), a);
+            STBI__PX_STORE(a);
+         }
+         break;
+      case STBI__F_up:
+         if (img_n == out_n) {
+            stbi__uint32 k = 0, nk = n*img_n;
+            for (; k + 16 <= nk; k += 16)
+               stbi__unfilter_up16(cur+k, raw+k, prior+k);
+            for (; k < nk; ++k)
+               cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+         } else {
+            STBI__PX_LOOP(out_n) {
+               a = stbi__px_add(stbi__px_load(raw, img_n, last), stbi__px_load(prior, img_n, last));
+               STBI__PX_STORE(a);
+            }
+         }
+         break;
+      case STBI__F_avg:
+         STBI__PX_LOOP(out_n) {
+            a = stbi__px_add(stbi__px_load(raw, img_n, last), stbi__px_avg(a, stbi__px_load(prior, img_n, last)));
+            STBI__PX_STORE(a);
+         }
+         break;
+      case STBI__F_avg_first:
+         c = stbi__px_zero();
+         STBI__PX_LOOP(0) {
+            a = stbi__px_add(stbi__px_load(raw, img_n, last), stbi__px_avg(a, c));
+            STBI__PX_STORE(a);
+         }
+         break;
+      case STBI__F_paeth:
+         c = stbi__px_load(prior - out_n, img_n, 1);
+         STBI__PX_LOOP(out_n) {
+            b = stbi__px_load(prior, img_n, last);
+            a = stbi__px_add(stbi__px_load(raw, img_n, last), stbi__px_paeth(a, b, c));
+            STBI__PX_STORE(a);
+            c = b;
+         }
+         break;
+   }
+   #undef STBI__PX_LOOP
+   #undef STBI__PX_STORE
+}
+
+// returns 0 if the row has to take the scalar path
+static int stbi__unfilter_row_simd(int filter, stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, stbi__uint32 n, int img_n, int out_n)
+{
+#ifdef STBI_SSE2
+   if (!stbi__sse2_available()) return 0;
+#endif
+   if (img_n == 3 && out_n == 4)
+      stbi__unfilter_px_row(filter, cur, raw, prior, n, 3, 4);
+   else if (img_n == 4 && out_n == 4)
+      stbi__unfilter_px_row(filter, cur, raw, prior, n, 4, 4);
+   else
+      return 0;
+   return 1;
+}
+#endif // STBI_SSE2 || STBI_NEON
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4405,6 +5214,14 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          prior += 1;
       }
 
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+      if (depth == 8 && !(filter == STBI__F_none && img_n == out_n) &&
+          stbi__unfilter_row_simd(filter, cur, raw, prior, x-1, img_n, out_n)) {
+         raw += (x-1)*img_n;
+         continue;
+      }
+#endif
+
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
@@ -0,0 +1,132 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+//this file contains a texture streamer. Textures start with only their smallest mips
+//resident, each frame the user reports how big a texture is on screen and the streamer
+//loads the finer mips it needs: the files are read with AsyncIO and decoded on a
+//background thread as they arrive. When the resident mips are over
+//the memory budget, the finest mips of the least recently used textures are dropped.
+//Resident mips are always a contiguous range [base, levels - 1], GL_TEXTURE_BASE_LEVEL
+//is moved so that the texture is always complete.
+#include "glad/glad.h"
+#include "async_io.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+//by default keep the 4 smallest mips (8x8 and smaller) resident at all time
+const int STREAM_INIT_MIPS = 4;
+//default amount of texel data uploaded per frame, so streaming doesn't cause hitches
+const size_t STREAM_UPLOAD_PER_FRAME = 4 * 1024 * 1024;
+
+class TextureStreamer {
+public:
+	//PRE:
+	//	budgetBytes: how many bytes of texture mips may be resident
+	//	initialMips: number of the smallest mips that are loaded first and never evicted
+	//	uploadPerFrame: bytes uploaded to GL per update() at most
+	TextureStreamer(size_t budgetBytes, int initialMips = STREAM_INIT_MIPS,
+		size_t uploadPerFrame = STREAM_UPLOAD_PER_FRAME);
+	~TextureStreamer();
+
+	//register a texture, its smallest mips are streamed in first
+	//POST:
+	//	return a handle used by the other functions, -1 if the file can't be read
+	int load(const char *path);
+
+	//tell the streamer how big a texture is on screen this frame, this marks the
+	//texture as used. Call this before update() every frame the texture is drawn.
+	//PRE:
+	//	screenPixels: size in pixels of the texture's largest side on screen
+	void requestSize(int handle, float screenPixels);
+
+	//call once per frame on the GL thread. Uploads finished mips, evicts mips when
+	//over budget, and queues loads for textures that need finer mips
+	void update();
+
+	//OpenGL texture name of a streamed texture
+	unsigned int textureID(int handle);
+
+	//finest mip that is resident, 0 means full resolution
+	int residentLevel(int handle);
+
+	//bytes of mips that are resident on the GPU
+	size_t residentBytes();
+
+	//number of mip loads that are waiting, being decoded or waiting for upload
+	int queueDepth();
+
+	//number of mip loads whose file couldn't be read or decoded, the texture keeps the
+	//mips it has and isn't streamed again
+	int failedLoads();
+
+	void setBudget(size_t budgetBytes);
+
+	//on-screen size of an object
+	//PRE:
+	//	worldSize: size of the object in world units
+	//	distance: distance from the camera to the object
+	//	fov: vertical field of view in radians
+	//	viewportHeight: height of the framebuffer in pixels
+	static float projectedSize(float worldSize, float distance, float fov, int viewportHeight);
+
+private:
+	struct Texture {
+		string path;
+		unsigned int id;
+		int width, height, levels;
+		int resident;	//finest resident level
+		int desired;	//finest level wanted this frame
+		int requested;	//finest level in flight, levels if nothing is in flight
+		unsigned long lastUsed; //frame the texture was last requested
+		size_t bytes;	//bytes that are resident
+		bool placeholder;	//the coarsest level still holds the grey texel of load()
+		bool failed;	//a load of its file failed, it won't be read again
+	};
+	struct Request {
+		int handle;
+		string path;
+		int width, height; //size of level 0
+		int first, last; //mip levels to load
+		shared_ptr<AssetData> file; //bytes of the file once it is read
+	};
+	struct Result {
+		int handle;
+		int first, last;
+		vector<vector<unsigned char> > mips; //mips[0] is level first
+	};
+
+	vector<Texture> _textures;
+	size_t _budget;
+	size_t _upload_per_frame;
+	size_t _resident_bytes;
+	int _failed_loads;
+	int _init_mips;
+	unsigned long _frame;
+
+	//shared with the worker thread
+	mutex _lock;
+	condition_variable _wake;
+	deque<Request> _requests;
+	deque<Result> _results;
+	int _in_flight;
+	bool _quit;
+	thread _worker;
+	//declared last so that it is destroyed first, its callbacks use the members above
+	AsyncIO _io;
+
+	void workerLoop();
+	void decode(const Request &request, Result &result);
+	void upload(Result &result);
+	void evict(size_t target);
+	static size_t levelBytes(const Texture &texture, int level);
+	static int lastMissing(const Texture &texture);
+};
+
+#endif
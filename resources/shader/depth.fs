@@ -0,0 +1,6 @@
+#version 330 core
+
+//the depth pre-pass only writes depth, color writes are off
+void main()
+{
+}
\ No newline at end of file
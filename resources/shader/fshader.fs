@@ -9,5 +9,9 @@ uniform float mix_value;
 
 void main()
 {
+#ifdef SINGLE_TEXTURE
+	FragColor = texture(texture1, texCoord);
+#else
 	FragColor = mix(texture(texture1, texCoord), texture(texture2, texCoord), mix_value);
+#endif
 }
\ No newline at end of file
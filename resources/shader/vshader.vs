@@ -1,9 +1,15 @@
 #version 330 core
 
 layout (location = 0) in vec3 aPos;
+#ifndef DEPTH_ONLY
 layout (location = 1) in vec2 aTexCoord;
 
 out vec2 texCoord;
+#endif
+
+//the depth pre-pass and the shading pass compare depths with GL_EQUAL, both programs
+//have to compute the exact same positions
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -12,5 +18,7 @@ uniform mat4 proj;
 void main()
 {
 	gl_Position = proj * view * model * vec4(aPos, 1.0);
+#ifndef DEPTH_ONLY
 	texCoord = aTexCoord;
+#endif
 }
\ No newline at end of file
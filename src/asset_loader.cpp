@@ -0,0 +1,386 @@
+//this file contains the coroutine asset loader, see asset_loader.h
+#include "../include/asset_loader.h"
+
+#ifdef ASYNC_LOADING
+#include "../include/async_io.h"
+#include "../include/job_system.h"
+#include "../include/gpu_memory.h"
+#include "../include/config.h"
+#include "../include/hash.h"
+
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <iomanip>
+
+typedef chrono::steady_clock Clock;
+
+struct LoaderState {
+	AsyncIO *io;
+	int max_loads;
+	int alignment;	//GL_UNPACK_ALIGNMENT at init(), workers can't ask GL
+	unsigned order;
+	vector<LoadHandle> queued;	//not started, in the order they were queued
+	vector<LoadHandle> running;
+	mutex lock;	//gl_steps and stats
+	vector<AssetLoad *> gl_steps;	//loads waiting for the GL thread
+	AssetLoaderStats stats;
+	LoaderState() : io(NULL), max_loads(32), alignment(4), order(0) {}
+};
+
+static LoaderState &state(){
+	static LoaderState loader;
+	return loader;
+}
+
+static double secondsSince(Clock::time_point start){
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+//the highest priority entry, the first one of equal priorities. Priorities change while
+//loads wait, so the queues are searched instead of kept sorted, they hold dozens
+template <class Load>
+size_t AssetLoader::highest(const vector<Load> &loads){
+	size_t best = 0;
+	for (size_t i = 1; i < loads.size(); i ++)
+		if (loads[i]->priority() > loads[best]->priority() ||
+			(loads[i]->priority() == loads[best]->priority() &&
+			(int)(loads[i]->_order - loads[best]->_order) < 0))
+			best = i;
+	return best;
+}
+
+void AssetLoader::init(int maxLoads){
+	LoaderState &loader = state();
+	if (loader.io != NULL)
+		return;
+	loader.io = new AsyncIO();
+	loader.max_loads = max(1, maxLoads);
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &loader.alignment);
+	//textures are flipped like configTexture does, the flag is global in stb_image
+	stbi_set_flip_vertically_on_load(true);
+	loader.stats = AssetLoaderStats();
+}
+
+void AssetLoader::shutdown(){
+	LoaderState &loader = state();
+	if (loader.io == NULL)
+		return;
+	for (size_t i = 0; i < loader.queued.size(); i ++)
+		loader.queued[i]->cancel();
+	for (size_t i = 0; i < loader.running.size(); i ++)
+		loader.running[i]->cancel();
+	//reads in flight and queued jobs still have to reach their next co_await
+	while (pending() > 0) {
+		pump(1.0);
+		this_thread::yield();
+	}
+	delete loader.io;
+	loader.io = NULL;
+}
+
+bool AssetLoader::running(){
+	return state().io != NULL;
+}
+
+int AssetLoader::pending(){
+	LoaderState &loader = state();
+	return (int)(loader.queued.size() + loader.running.size());
+}
+
+//---------------------------------loads------------------------------------//
+
+void AssetLoader::complete(AssetLoad *load, LoadStatus status){
+	LoaderState &loader = state();
+	LoadHandle handle;
+	for (size_t i = 0; i < loader.running.size(); i ++)
+		if (loader.running[i].get() == load)
+		{
+			handle = loader.running[i];
+			loader.running.erase(loader.running.begin() + i);
+			break;
+		}
+	handle->_task = Task<bool>();
+	handle->_status.store(status);
+	{
+		lock_guard<mutex> guard(loader.lock);
+		if (status == LOAD_DONE)
+		{
+			loader.stats.done ++;
+			loader.stats.loadSeconds += secondsSince(handle->_queued);
+		}
+		else if (status == LOAD_FAILED)
+			loader.stats.failed ++;
+		else
+			loader.stats.cancelled ++;
+	}
+	if (status == LOAD_FAILED)
+		cout << "ERROR::ASSET_LOADER::LOAD_FAILED: " << handle->_name << endl;
+	if (handle->_done)
+		handle->_done(*handle);
+}
+
+void AssetLoader::startLoads(){
+	LoaderState &loader = state();
+	while (!loader.queued.empty() && (int)loader.running.size() < loader.max_loads) {
+		size_t next = highest(loader.queued);
+		LoadHandle load = loader.queued[next];
+		loader.queued.erase(loader.queued.begin() + next);
+		loader.running.push_back(load);
+		if (load->cancelled())
+		{
+			complete(load.get(), LOAD_CANCELLED);
+			continue;
+		}
+		{
+			lock_guard<mutex> guard(loader.lock);
+			loader.stats.maxRunning = max(loader.stats.maxRunning, (int)loader.running.size());
+		}
+		load->_status.store(LOAD_RUNNING);
+		load->_task._handle.promise().load = load.get();
+		//it runs here until its first co_await
+		load->_task._handle.resume();
+	}
+}
+
+LoadHandle AssetLoader::load(const string &name, Task<bool> task, int priority,
+	LoadCallback done){
+	LoaderState &loader = state();
+	LoadHandle load(new AssetLoad());
+	load->_name = name;
+	load->_priority.store(priority);
+	load->_task = std::move(task);
+	load->_done = done;
+	load->_order = loader.order ++;
+	load->_queued = Clock::now();
+	{
+		lock_guard<mutex> guard(loader.lock);
+		loader.stats.loads ++;
+	}
+	if (loader.io == NULL || !load->_task.valid())
+	{
+		cout << "ERROR::ASSET_LOADER::NOT_STARTED: " << name << endl;
+		//failed like any other load, done is still called
+		loader.running.push_back(load);
+		complete(load.get(), LOAD_FAILED);
+		return load;
+	}
+	loader.queued.push_back(load);
+	startLoads();
+	return load;
+}
+
+void AssetLoader::pump(double seconds){
+	LoaderState &loader = state();
+	if (loader.io == NULL)
+		return;
+	Clock::time_point start = Clock::now();
+	startLoads();
+	for (;;) {
+		AssetLoad *load = NULL;
+		{
+			lock_guard<mutex> guard(loader.lock);
+			if (!loader.gl_steps.empty())
+			{
+				size_t next = highest(loader.gl_steps);
+				load = loader.gl_steps[next];
+				loader.gl_steps.erase(loader.gl_steps.begin() + next);
+			}
+		}
+		if (load != NULL)
+		{
+			Clock::time_point step = Clock::now();
+			if (load->_finished)
+				complete(load, load->_task.result() ? LOAD_DONE : LOAD_FAILED);
+			else if (load->cancelled())
+				complete(load, LOAD_CANCELLED);
+			else
+				load->_resume.resume();
+			double step_seconds = secondsSince(step);
+			lock_guard<mutex> guard(loader.lock);
+			loader.stats.glSteps ++;
+			loader.stats.glSeconds += step_seconds;
+			loader.stats.longestGlStep = max(loader.stats.longestGlStep, step_seconds);
+		}
+		//without other workers the decoding waits for this thread
+		else if (JobSystem::threads() == 1 && JobSystem::runOne())
+		{
+			lock_guard<mutex> guard(loader.lock);
+			loader.stats.jobsRun ++;
+		}
+		else
+			break;
+		if (secondsSince(start) >= seconds)
+			break;
+	}
+	//finished loads freed their slots
+	startLoads();
+}
+
+//-------------------------------awaitables---------------------------------//
+
+bool AssetLoader::WorkerAwaiter::await_ready() const {
+	return !JobSystem::running();
+}
+
+void AssetLoader::schedule(AssetLoad *load, coroutine_handle<> task, bool glThread){
+	load->_resume = task;
+	if (glThread || load->cancelled())
+	{
+		LoaderState &loader = state();
+		lock_guard<mutex> guard(loader.lock);
+		loader.gl_steps.push_back(load);
+	}
+	else
+		JobSystem::run(resumeJob, load);
+}
+
+void AssetLoader::resumeJob(void *data){
+	AssetLoad *load = (AssetLoad *)data;
+	if (load->cancelled())
+		schedule(load, load->_resume, true);
+	else
+		load->_resume.resume();
+}
+
+void AssetLoader::finished(AssetLoad *load){
+	load->_finished = true;
+	LoaderState &loader = state();
+	lock_guard<mutex> guard(loader.lock);
+	loader.gl_steps.push_back(load);
+}
+
+bool AssetLoader::startRead(AssetLoad *load, coroutine_handle<> task, ReadAwaiter &read){
+	if (load->cancelled())
+	{
+		schedule(load, task, true);
+		return true;
+	}
+	load->_resume = task;
+	ReadAwaiter *awaiter = &read;
+	state().io->read(read.path, [load, awaiter](const string &path, AssetData &data, bool ok) {
+		awaiter->data.swap(data);
+		awaiter->ok = ok;
+		//the second of this and startRead() continues the load, files in the pack
+		//complete before startRead() returns
+		if (awaiter->arrived.exchange(true))
+			schedule(load, load->_resume, false);
+	});
+	state().io->submit();
+	return !read.arrived.exchange(true);
+}
+
+void AssetLoader::recycle(AssetData &data){
+	LoaderState &loader = state();
+	if (loader.io != NULL)
+		loader.io->recycle(data);
+	else
+		data.clear();
+}
+
+//--------------------------------textures----------------------------------//
+
+LoadHandle AssetLoader::loadTexture(const string &path,
+	function<void(const TextureHandle &texture)> done, int priority, bool srgb,
+	MipFilter mipFilter){
+	shared_ptr<TextureHandle> result = make_shared<TextureHandle>();
+	return load(path, texture(path, result, srgb, mipFilter), priority,
+		[result, done](AssetLoad &load) {
+			if (done)
+				done(load.status() == LOAD_DONE ? *result : TextureHandle());
+		});
+}
+
+Task<bool> AssetLoader::texture(string path, shared_ptr<TextureHandle> out, bool srgb,
+	MipFilter mipFilter){
+	AssetData file;
+	if (!co_await read(path, file))
+		co_return false;
+	co_await onWorker();
+
+	int width, height, file_channels;
+	if (!stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &file_channels))
+		co_return false;
+	ChannelFormat format = channelFormat(file_channels, srgb);
+	int alignment = state().alignment;
+	int stride = (width * format.channels + alignment - 1) / alignment * alignment;
+	size_t size = (size_t)stride * height;
+	vector<unsigned char> pixels(size);
+	if (!stbi_load_into_from_memory(file.data(), (int)file.size(), &pixels[0], stride, size,
+		&width, &height, &file_channels, format.channels))
+		co_return false;
+	string canonical = ResourceManager::canonicalPath(path.c_str());
+	uint64_t settings = (uint64_t)srgb << 4 | (uint64_t)mipFilter;
+	uint64_t content = hash64(file.data(), file.size(), settings);
+	size_t file_bytes = file.size();
+	recycle(file);
+
+	MipOptions options;
+	options.filter = mipFilter;
+	options.srgb = srgb;
+	options.alignment = alignment;
+	vector<MipLevel> levels;
+	MipBuilder::build(&pixels[0], width, height, stride, format.channels, levels, options);
+
+	co_await onGlThread();
+	//destroyed on the GL thread with the load if it is cancelled between the levels
+	TextureHandle handle = make_shared<TextureResource>();
+	handle->id = GpuMemory::genTexture(GPU_TEXTURE, canonical);
+	handle->path = canonical;
+	handle->hash = content;
+	handle->fileBytes = file_bytes;
+	glBindTexture(GL_TEXTURE_2D, handle->id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	//the levels arrive one step at a time, the texture stays complete in between
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	//shaders keep reading RGBA
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+	GpuMemory::texImage2D(GL_TEXTURE_2D, handle->id, 0, format.internalFormat, width, height,
+		format.format, GL_UNSIGNED_BYTE, &pixels[0]);
+	vector<unsigned char>().swap(pixels);
+	for (size_t i = 0; i < levels.size(); i ++) {
+		co_await onGlThread();
+		//another step may have bound its own texture in between
+		glBindTexture(GL_TEXTURE_2D, handle->id);
+		GpuMemory::texImage2D(GL_TEXTURE_2D, handle->id, (int)i + 1, format.internalFormat,
+			levels[i].width, levels[i].height, format.format, GL_UNSIGNED_BYTE,
+			&levels[i].pixels[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)i + 1);
+		vector<unsigned char>().swap(levels[i].pixels);
+	}
+	*out = handle;
+	co_return true;
+}
+
+//---------------------------------stats------------------------------------//
+
+AssetLoaderStats AssetLoader::stats(){
+	LoaderState &loader = state();
+	lock_guard<mutex> guard(loader.lock);
+	return loader.stats;
+}
+
+void AssetLoader::report(ostream &out){
+	AssetLoaderStats stats = AssetLoader::stats();
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(2);
+	out << "asset loader: " << stats.loads << " loads, " << stats.done << " done, "
+		<< stats.failed << " failed, " << stats.cancelled << " cancelled, up to "
+		<< stats.maxRunning << " at once" << endl;
+	if (stats.done > 0)
+		out << "\taverage " << stats.loadSeconds / stats.done * 1000.0
+			<< " ms from load() to done" << endl;
+	if (stats.glSteps > 0)
+		out << "\t" << stats.glSteps << " GL thread steps, " << stats.glSeconds * 1000.0
+			<< " ms in total, longest " << stats.longestGlStep * 1000.0 << " ms" << endl;
+	if (stats.jobsRun > 0)
+		out << "\t" << stats.jobsRun << " jobs run by pump() without other workers" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+#endif
@@ -0,0 +1,504 @@
+//this file contains the asset pack reader and writer, and the Vfs
+#include "../include/asset_pack.h"
+#include "../include/hash.h"
+#include "../include/lz4.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//the structs are written as they are, on little endian machines
+static_assert(sizeof(PackHeader) == 32, "PackHeader must not be padded");
+static_assert(sizeof(PackEntry) == 48, "PackEntry must not be padded");
+
+void AssetData::clear(){
+	_data = NULL;
+	_size = 0;
+	_buffer.clear();
+}
+
+void AssetData::swap(AssetData &other){
+	//the buffers change owners but not addresses, so _data stays valid
+	_buffer.swap(other._buffer);
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+}
+
+//read a whole file into a buffer
+static bool readFile(const string &path, vector<unsigned char> &bytes){
+	ifstream file(path.c_str(), ios::binary | ios::ate);
+	if (!file)
+		return false;
+	streamsize size = file.tellg();
+	if (size < 0)
+		return false;
+	bytes.resize((size_t)size);
+	file.seekg(0);
+	return size == 0 || (bool)file.read((char *)&bytes[0], size);
+}
+
+//--------------------------------reading-----------------------------------//
+
+AssetPack::AssetPack(){
+	_base = NULL;
+	_size = 0;
+	_header = NULL;
+	_entries = NULL;
+	_names = NULL;
+#ifdef _WIN32
+	_file = _mapping = NULL;
+#endif
+}
+
+AssetPack::~AssetPack(){
+	close();
+}
+
+bool AssetPack::open(const char *path){
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void *base = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL)
+		base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (base == NULL)
+	{
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	_file = file;
+	_mapping = mapping;
+	_base = (const unsigned char *)base;
+	_size = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	void *base = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping keeps the file open
+	::close(fd);
+	if (base == MAP_FAILED)
+		return false;
+	//most of the pack is read at startup, have the kernel read it ahead in one
+	//sequential pass instead of faulting in page by page
+	madvise(base, (size_t)st.st_size, MADV_WILLNEED);
+	_base = (const unsigned char *)base;
+	_size = (size_t)st.st_size;
+#endif
+
+	//check everything a lookup or a read relies on, so a truncated or foreign file
+	//is rejected here
+	const PackHeader *header = (const PackHeader *)_base;
+	bool valid = _size >= sizeof(PackHeader) && memcmp(header->magic, PACK_MAGIC, 4) == 0 &&
+		header->version == PACK_VERSION && header->alignment > 0 &&
+		sizeof(PackHeader) + (size_t)header->count * sizeof(PackEntry) <= _size &&
+		header->namesOffset <= _size && header->namesSize <= _size - header->namesOffset;
+	const PackEntry *entries = (const PackEntry *)(_base + sizeof(PackHeader));
+	for (uint32_t i = 0; valid && i < header->count; i ++) {
+		const PackEntry &entry = entries[i];
+		valid = entry.offset <= _size && entry.size <= _size - entry.offset &&
+			(uint64_t)entry.nameOffset + entry.nameLength <= header->namesSize &&
+			//LZ4 expands a byte to at most 255
+			((entry.flags & PACK_COMPRESSED) ? entry.rawSize / 256 <= entry.size :
+				entry.rawSize == entry.size) &&
+			(i == 0 || entries[i - 1].hash <= entry.hash);
+	}
+	if (!valid)
+	{
+		cout << "ERROR::ASSET_PACK::INVALID: " << path << endl;
+		close();
+		return false;
+	}
+	_header = header;
+	_entries = entries;
+	_names = (const char *)_base + header->namesOffset;
+	return true;
+}
+
+void AssetPack::close(){
+	if (_base == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(_base);
+	CloseHandle((HANDLE)_mapping);
+	CloseHandle((HANDLE)_file);
+	_file = _mapping = NULL;
+#else
+	munmap((void *)_base, _size);
+#endif
+	_base = NULL;
+	_size = 0;
+	_header = NULL;
+	_entries = NULL;
+	_names = NULL;
+}
+
+static bool hashLess(const PackEntry &entry, uint64_t hash){
+	return entry.hash < hash;
+}
+
+const PackEntry *AssetPack::find(const string &name) const {
+	if (_header == NULL)
+		return NULL;
+	uint64_t hash = hash64(name.data(), name.size());
+	const PackEntry *end = _entries + _header->count;
+	//names with the same hash are next to each other
+	for (const PackEntry *entry = lower_bound(_entries, end, hash, hashLess);
+		entry != end && entry->hash == hash; ++ entry)
+		if (entry->nameLength == name.size() &&
+			memcmp(_names + entry->nameOffset, name.data(), name.size()) == 0)
+			return entry;
+	return NULL;
+}
+
+string AssetPack::name(const PackEntry &entry) const {
+	return string(_names + entry.nameOffset, entry.nameLength);
+}
+
+bool AssetPack::read(const PackEntry &entry, AssetData &out) const {
+	out.clear();
+	const unsigned char *data = _base + entry.offset;
+	if (!(entry.flags & PACK_COMPRESSED))
+	{
+		out._data = data;
+		out._size = (size_t)entry.size;
+		return true;
+	}
+	out._buffer.resize((size_t)entry.rawSize);
+	if (entry.rawSize > 0 &&
+		!Lz4::decompress(data, (size_t)entry.size, &out._buffer[0], (size_t)entry.rawSize))
+	{
+		cout << "ERROR::ASSET_PACK::CORRUPT_ENTRY: " << name(entry) << endl;
+		out.clear();
+		return false;
+	}
+	out._data = out._buffer.empty() ? NULL : &out._buffer[0];
+	out._size = out._buffer.size();
+	return true;
+}
+
+//--------------------------------writing-----------------------------------//
+
+struct PendingEntry {
+	PackEntry entry;
+	string name;
+	vector<unsigned char> data;
+};
+
+static bool entryLess(const PendingEntry *a, const PendingEntry *b){
+	return a->entry.hash != b->entry.hash ? a->entry.hash < b->entry.hash : a->name < b->name;
+}
+
+bool AssetPack::write(const char *path, const vector<PackSource> &files, bool compress,
+	ostream &log){
+	vector<PendingEntry> pending(files.size());
+	size_t raw_total = 0, packed_total = 0, compressed = 0;
+	for (size_t i = 0; i < files.size(); i ++) {
+		PendingEntry &p = pending[i];
+		p.name = files[i].name;
+		if (!readFile(files[i].path, p.data))
+		{
+			log << "ERROR::ASSET_PACK::FILE_NOT_SUCCESFULLY_READ: " << files[i].path << endl;
+			return false;
+		}
+		memset(&p.entry, 0, sizeof(PackEntry));
+		p.entry.hash = hash64(p.name.data(), p.name.size());
+		p.entry.rawSize = p.data.size();
+		//images are compressed already, LZ4 only pays off on text and raw data. Cooked
+		//meshes are uploaded straight from the mapping, see mesh_file.h
+		bool cooked_mesh = p.name.size() >= 5 &&
+			p.name.compare(p.name.size() - 5, 5, ".mesh") == 0;
+		if (compress && !cooked_mesh && !p.data.empty())
+		{
+			vector<unsigned char> block(Lz4::compressBound(p.data.size()));
+			size_t size = Lz4::compress(&p.data[0], p.data.size(), &block[0], block.size());
+			if (size > 0 && size <= p.data.size() - p.data.size() / 8)
+			{
+				block.resize(size);
+				p.data.swap(block);
+				p.entry.flags |= PACK_COMPRESSED;
+				compressed ++;
+			}
+		}
+		p.entry.size = p.data.size();
+		raw_total += (size_t)p.entry.rawSize;
+		packed_total += (size_t)p.entry.size;
+	}
+
+	//the table is sorted by hash, the data stays in the order of files so that
+	//neighbouring files are read in one sweep
+	vector<PendingEntry *> table(pending.size());
+	for (size_t i = 0; i < pending.size(); i ++)
+		table[i] = &pending[i];
+	sort(table.begin(), table.end(), entryLess);
+	for (size_t i = 1; i < table.size(); i ++)
+		if (table[i]->name == table[i - 1]->name)
+		{
+			log << "ERROR::ASSET_PACK::DUPLICATE_NAME: " << table[i]->name << endl;
+			return false;
+		}
+
+	PackHeader header;
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = PACK_VERSION;
+	header.count = (uint32_t)table.size();
+	header.alignment = PACK_ALIGNMENT;
+	header.namesOffset = sizeof(PackHeader) + table.size() * sizeof(PackEntry);
+	string names;
+	for (size_t i = 0; i < table.size(); i ++) {
+		table[i]->entry.nameOffset = (uint32_t)names.size();
+		table[i]->entry.nameLength = (uint32_t)table[i]->name.size();
+		names += table[i]->name;
+	}
+	header.namesSize = names.size();
+	uint64_t offset = header.namesOffset + header.namesSize;
+	for (size_t i = 0; i < pending.size(); i ++) {
+		offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		pending[i].entry.offset = offset;
+		offset += pending[i].entry.size;
+	}
+
+	//write next to the pack and rename, a running program may have the old one mapped
+	string temp = string(path) + ".tmp";
+	{
+		ofstream out(temp.c_str(), ios::binary | ios::trunc);
+		out.write((const char *)&header, sizeof(PackHeader));
+		for (size_t i = 0; i < table.size(); i ++)
+			out.write((const char *)&table[i]->entry, sizeof(PackEntry));
+		out.write(names.data(), names.size());
+		static const char zeros[PACK_ALIGNMENT] = {0};
+		uint64_t position = header.namesOffset + header.namesSize;
+		for (size_t i = 0; i < pending.size(); i ++) {
+			out.write(zeros, (streamsize)(pending[i].entry.offset - position));
+			if (!pending[i].data.empty())
+				out.write((const char *)&pending[i].data[0], pending[i].data.size());
+			position = pending[i].entry.offset + pending[i].entry.size;
+		}
+		if (!out)
+		{
+			log << "ERROR::ASSET_PACK::WRITE_FAILED: " << temp << endl;
+			return false;
+		}
+	}
+#ifdef _WIN32
+	remove(path);
+#endif
+	if (rename(temp.c_str(), path) != 0)
+	{
+		log << "ERROR::ASSET_PACK::WRITE_FAILED: " << path << endl;
+		return false;
+	}
+	log << "packed " << files.size() << " files into " << path << ", " << raw_total / 1024
+		<< " KB -> " << packed_total / 1024 << " KB, " << compressed << " compressed" << endl;
+	return true;
+}
+
+//----------------------------------vfs-------------------------------------//
+
+static AssetPack mounted_pack;
+static string mounted_root;	//normalized, with a trailing slash
+static atomic<size_t> pack_reads(0), mapped_bytes(0), decompressed_bytes(0);
+static atomic<size_t> disk_reads(0), disk_bytes(0), prefetched(0);
+
+//reads announced with expect(), by normalized path
+struct ExpectedRead {
+	bool done, ok;
+	bool dropped;	//cleared before it was fulfilled, nobody takes the data
+	AssetData data;
+};
+static mutex expected_lock;
+static condition_variable expected_done;
+static map<string, shared_ptr<ExpectedRead> > expected_reads;
+static atomic<int> expected_count(0);	//lets read() skip the lock when nothing is expected
+
+string Vfs::normalize(const string &path){
+	vector<string> parts;
+	bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+	size_t start = 0;
+	while (start <= path.size()) {
+		size_t end = path.find_first_of("/\\", start);
+		if (end == string::npos)
+			end = path.size();
+		string part = path.substr(start, end - start);
+		if (part == "..")
+		{
+			if (!parts.empty() && parts.back() != "..")
+				parts.pop_back();
+			else if (!absolute)
+				parts.push_back(part);
+		}
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+		start = end + 1;
+	}
+	string result = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i ++) {
+		if (i > 0)
+			result += '/';
+		result += parts[i];
+	}
+	return result;
+}
+
+bool Vfs::mount(const char *packPath, const string &root){
+	if (!mounted_pack.open(packPath))
+		return false;
+	mounted_root = normalize(root) + "/";
+	cout << "mounted " << packPath << " (" << mounted_pack.count() << " entries, "
+		<< mounted_pack.mappedBytes() / 1024 << " KB) as " << root << endl;
+	return true;
+}
+
+void Vfs::unmount(){
+	mounted_pack.close();
+	mounted_root.clear();
+}
+
+bool Vfs::readPacked(const string &path, AssetData &out){
+	out.clear();
+	if (!mounted_pack.isOpen())
+		return false;
+	string full = normalize(path);
+	if (full.compare(0, mounted_root.size(), mounted_root) != 0)
+		return false;
+	const PackEntry *entry = mounted_pack.find(full.substr(mounted_root.size()));
+	if (entry == NULL || !mounted_pack.read(*entry, out))
+		return false;
+	pack_reads ++;
+	if (out.mapped())
+		mapped_bytes += out.size();
+	else
+		decompressed_bytes += out.size();
+	return true;
+}
+
+void Vfs::expect(const string &path){
+	shared_ptr<ExpectedRead> read = make_shared<ExpectedRead>();
+	read->done = read->ok = read->dropped = false;
+	lock_guard<mutex> guard(expected_lock);
+	if (expected_reads.insert(make_pair(normalize(path), read)).second)
+		expected_count ++;
+}
+
+void Vfs::fulfill(const string &path, AssetData &data, bool ok){
+	{
+		lock_guard<mutex> guard(expected_lock);
+		map<string, shared_ptr<ExpectedRead> >::iterator it = expected_reads.find(normalize(path));
+		if (it == expected_reads.end())
+			return;
+		it->second->done = true;
+		it->second->ok = ok;
+		//a waiter that found it before it was cleared reads the file itself
+		if (it->second->dropped)
+		{
+			expected_reads.erase(it);
+			expected_count --;
+		}
+		else
+			it->second->data.swap(data);
+	}
+	expected_done.notify_all();
+}
+
+void Vfs::clearExpected(){
+	lock_guard<mutex> guard(expected_lock);
+	map<string, shared_ptr<ExpectedRead> >::iterator it = expected_reads.begin();
+	while (it != expected_reads.end()) {
+		//fulfill() still needs to find the reads in flight, to wake their waiters
+		if (!it->second->done)
+		{
+			it->second->dropped = true;
+			++ it;
+			continue;
+		}
+		expected_reads.erase(it ++);
+		expected_count --;
+	}
+}
+
+bool Vfs::read(const string &path, AssetData &out){
+	if (expected_count > 0)
+	{
+		unique_lock<mutex> guard(expected_lock);
+		map<string, shared_ptr<ExpectedRead> >::iterator it = expected_reads.find(normalize(path));
+		if (it != expected_reads.end())
+		{
+			shared_ptr<ExpectedRead> read = it->second;
+			while (!read->done)
+				expected_done.wait(guard);
+			//only the first waiter takes the data, the others read the file below. The
+			//path may have been expected again meanwhile, that read isn't ours
+			map<string, shared_ptr<ExpectedRead> >::iterator now = expected_reads.find(normalize(path));
+			bool first = now != expected_reads.end() && now->second == read;
+			if (first)
+			{
+				expected_reads.erase(now);
+				expected_count --;
+			}
+			//a failed prefetch is retried below
+			if (first && read->ok)
+			{
+				out.swap(read->data);
+				prefetched ++;
+				return true;
+			}
+		}
+	}
+	if (readPacked(path, out))
+		return true;
+	out.clear();
+	if (!readFile(path, out._buffer))
+		return false;
+	out._data = out._buffer.empty() ? NULL : &out._buffer[0];
+	out._size = out._buffer.size();
+	disk_reads ++;
+	disk_bytes += out._size;
+	return true;
+}
+
+VfsStats Vfs::stats(){
+	VfsStats stats;
+	stats.packReads = pack_reads;
+	stats.mappedBytes = mapped_bytes;
+	stats.decompressedBytes = decompressed_bytes;
+	stats.diskReads = disk_reads;
+	stats.diskBytes = disk_bytes;
+	stats.prefetched = prefetched;
+	return stats;
+}
+
+void Vfs::report(ostream &out){
+	VfsStats stats = Vfs::stats();
+	out << "vfs: " << stats.packReads << " reads from the pack (" << stats.mappedBytes / 1024
+		<< " KB mapped, " << stats.decompressedBytes / 1024 << " KB decompressed), "
+		<< stats.diskReads << " loose files (" << stats.diskBytes / 1024 << " KB), "
+		<< stats.prefetched << " prefetched" << endl;
+}
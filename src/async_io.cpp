@@ -0,0 +1,490 @@
+//this file contains the asynchronous file reader, io_uring with a pread fallback
+#include "../include/async_io.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+//io_uring is used through its system calls, liburing isn't needed
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+//reads bigger than this are split, the kernel caps single reads near 2 GB
+static const size_t MAX_READ = (size_t)1 << 30;
+//recycled buffers kept at most
+static const size_t MAX_BUFFERS = 16;
+
+struct AsyncIO::Pending {
+	string path;
+	Callback done;
+	AssetData data;
+	size_t size;	//of the file
+	size_t offset;	//bytes read so far
+#ifdef _WIN32
+	FILE *file;
+#else
+	int fd;
+#endif
+#ifdef ASYNC_IO_URING
+	struct iovec iov;
+#endif
+};
+
+AsyncIO::AsyncIO(int queueDepth, int threads, bool useUring){
+	_queue_depth = max(1, queueDepth);
+	_in_flight = 0;
+	_quit = false;
+	memset(&_stats, 0, sizeof(_stats));
+	_ring_fd = -1;
+	_sq_ring = _cq_ring = _sqes = NULL;
+	if (useUring && setupRing((unsigned)_queue_depth))
+		_threads.push_back(thread(&AsyncIO::reapLoop, this));
+	else
+		for (int i = 0; i < max(1, threads); i ++)
+			_threads.push_back(thread(&AsyncIO::workerLoop, this));
+}
+
+AsyncIO::~AsyncIO(){
+	submit();
+	wait();
+	{
+		lock_guard<mutex> guard(_lock);
+		_quit = true;
+#ifdef ASYNC_IO_URING
+		//a no-op completion wakes the reaper up
+		if (_ring_fd >= 0)
+		{
+			unsigned tail = *_sq_tail, index = tail & *_sq_mask;
+			struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_NOP;
+			_sq_array[index] = index;
+			__atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+			enterRing(1);
+		}
+#endif
+	}
+	_wake.notify_all();
+	for (size_t i = 0; i < _threads.size(); i ++)
+		_threads[i].join();
+	closeRing();
+}
+
+//---------------------------------io_uring---------------------------------//
+
+bool AsyncIO::setupRing(unsigned entries){
+#ifdef ASYNC_IO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	//ENOSYS on old kernels, EPERM where seccomp or a sysctl turns it off
+	int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0)
+		return false;
+	_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single)
+		_sq_ring_size = _cq_ring_size = max(_sq_ring_size, _cq_ring_size);
+	void *sq = mmap(NULL, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		fd, IORING_OFF_SQ_RING);
+	void *cq = single || sq == MAP_FAILED ? sq : mmap(NULL, _cq_ring_size,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	void *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (sq != MAP_FAILED)
+			munmap(sq, _sq_ring_size);
+		if (!single && cq != MAP_FAILED)
+			munmap(cq, _cq_ring_size);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+		::close(fd);
+		return false;
+	}
+	_ring_fd = fd;
+	_sq_entries = params.sq_entries;
+	_sq_ring = sq;
+	_cq_ring = cq;
+	_sqes = sqes;
+	_sq_head = (unsigned *)((char *)sq + params.sq_off.head);
+	_sq_tail = (unsigned *)((char *)sq + params.sq_off.tail);
+	_sq_mask = (unsigned *)((char *)sq + params.sq_off.ring_mask);
+	_sq_array = (unsigned *)((char *)sq + params.sq_off.array);
+	_cq_head = (unsigned *)((char *)cq + params.cq_off.head);
+	_cq_tail = (unsigned *)((char *)cq + params.cq_off.tail);
+	_cq_mask = (unsigned *)((char *)cq + params.cq_off.ring_mask);
+	_cqes = (char *)cq + params.cq_off.cqes;
+	return true;
+#else
+	(void)entries;
+	return false;
+#endif
+}
+
+void AsyncIO::closeRing(){
+#ifdef ASYNC_IO_URING
+	if (_ring_fd < 0)
+		return;
+	munmap(_sqes, _sq_entries * sizeof(struct io_uring_sqe));
+	if (_cq_ring != _sq_ring)
+		munmap(_cq_ring, _cq_ring_size);
+	munmap(_sq_ring, _sq_ring_size);
+	::close(_ring_fd);
+	_ring_fd = -1;
+#endif
+}
+
+//put a read of the rest of a file into the submission queue, _lock must be held
+void AsyncIO::queueRead(Pending *pending){
+#ifdef ASYNC_IO_URING
+	unsigned tail = *_sq_tail, index = tail & *_sq_mask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+	//READV instead of READ so that kernels from 5.1 work
+	pending->iov.iov_base = (unsigned char *)pending->data._buffer.data() + pending->offset;
+	pending->iov.iov_len = min(pending->size - pending->offset, MAX_READ);
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = pending->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&pending->iov;
+	sqe->len = 1;
+	sqe->off = pending->offset;
+	sqe->user_data = (uint64_t)(uintptr_t)pending;
+	_sq_array[index] = index;
+	//the kernel must see the entry before the new tail
+	__atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+#else
+	(void)pending;
+#endif
+}
+
+void AsyncIO::enterRing(unsigned submitted){
+#ifdef ASYNC_IO_URING
+	while (submitted > 0) {
+		int done = (int)syscall(__NR_io_uring_enter, _ring_fd, submitted, 0, 0, NULL, 0);
+		if (done < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			break;
+		if (done > 0)
+			submitted -= min((unsigned)done, submitted);
+	}
+#else
+	(void)submitted;
+#endif
+}
+
+//move ready reads into free slots of the ring, _lock must be held
+void AsyncIO::fill(){
+	if (_ring_fd < 0)
+		return;
+	unsigned submitted = 0;
+	while (_in_flight < _queue_depth && !_ready.empty()) {
+		Pending *pending = _ready.front();
+		_ready.pop_front();
+		started();
+		queueRead(pending);
+		submitted ++;
+	}
+	enterRing(submitted);
+}
+
+void AsyncIO::reapLoop(){
+#ifdef ASYNC_IO_URING
+	vector<pair<Pending *, bool> > completed;
+	while (true)
+	{
+		syscall(__NR_io_uring_enter, _ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		//the lock orders the submitting thread's writes to the reads before ours, the
+		//ring does too but tools like ThreadSanitizer can't see through the kernel
+		unique_lock<mutex> guard(_lock);
+		//only this thread moves the completion head
+		unsigned head = *_cq_head;
+		unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+		completed.clear();
+		for (; head != tail; head ++) {
+			struct io_uring_cqe *cqe = (struct io_uring_cqe *)_cqes + (head & *_cq_mask);
+			Pending *pending = (Pending *)(uintptr_t)cqe->user_data;
+			int result = cqe->res;
+			if (pending == NULL)
+				continue;
+			if (result == -EINTR || result == -EAGAIN || (result > 0 &&
+				pending->offset + result < pending->size))
+			{
+				//short read, ask for the rest
+				if (result > 0)
+					pending->offset += result;
+				queueRead(pending);
+				enterRing(1);
+				continue;
+			}
+			if (result > 0)
+				pending->offset += result;
+			completed.push_back(make_pair(pending, result >= 0 &&
+				pending->offset == pending->size));
+		}
+		__atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+		guard.unlock();
+		for (size_t i = 0; i < completed.size(); i ++)
+			finish(completed[i].first, completed[i].second);
+
+		guard.lock();
+		if (_quit && _in_flight == 0 && _ready.empty())
+			return;
+	}
+#endif
+}
+
+//-----------------------------pread fallback-------------------------------//
+
+//read the rest of an open file with blocking reads
+static bool readRest(int fd, unsigned char *buffer, size_t size, size_t offset){
+#ifdef _WIN32
+	(void)fd;
+	(void)buffer;
+	(void)size;
+	(void)offset;
+	return false;
+#else
+	while (offset < size) {
+		ssize_t result = pread(fd, buffer + offset, min(size - offset, MAX_READ), offset);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+			return false;
+		offset += result;
+	}
+	return true;
+#endif
+}
+
+void AsyncIO::workerLoop(){
+	while (true)
+	{
+		Pending *pending;
+		{
+			unique_lock<mutex> guard(_lock);
+			while (!_quit && _ready.empty())
+				_wake.wait(guard);
+			if (_ready.empty())
+				return;
+			pending = _ready.front();
+			_ready.pop_front();
+			started();
+		}
+#ifdef _WIN32
+		bool ok = open(pending) && (pending->size == 0 ||
+			fread(pending->data._buffer.data(), 1, pending->size, pending->file) == pending->size);
+#else
+		bool ok = open(pending) &&
+			readRest(pending->fd, pending->data._buffer.data(), pending->size, 0);
+#endif
+		finish(pending, ok);
+	}
+}
+
+//---------------------------------reading----------------------------------//
+
+//open a file and size its buffer
+bool AsyncIO::open(Pending *pending){
+	size_t size = 0;
+#ifdef _WIN32
+	pending->file = fopen(pending->path.c_str(), "rb");
+	if (pending->file == NULL)
+		return false;
+	fseek(pending->file, 0, SEEK_END);
+	long end = ftell(pending->file);
+	fseek(pending->file, 0, SEEK_SET);
+	if (end < 0)
+		return false;
+	size = (size_t)end;
+#else
+	pending->fd = ::open(pending->path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (pending->fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(pending->fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+	size = (size_t)st.st_size;
+#endif
+	pending->size = size;
+	pending->offset = 0;
+
+	//the smallest recycled buffer that fits, or the biggest one to grow
+	lock_guard<mutex> guard(_lock);
+	int fit = -1, largest = -1;
+	for (size_t i = 0; i < _buffers.size(); i ++) {
+		size_t capacity = _buffers[i].capacity();
+		if (capacity >= size && (fit < 0 || capacity < _buffers[fit].capacity()))
+			fit = (int)i;
+		if (largest < 0 || capacity > _buffers[largest].capacity())
+			largest = (int)i;
+	}
+	int best = fit >= 0 ? fit : largest;
+	if (best >= 0)
+	{
+		pending->data._buffer.swap(_buffers[best]);
+		_buffers.erase(_buffers.begin() + best);
+	}
+	pending->data._buffer.resize(size);
+	return true;
+}
+
+void AsyncIO::read(const string &path, Callback done){
+	//the pack is mapped already
+	AssetData packed;
+	if (Vfs::readPacked(path, packed))
+	{
+		{
+			lock_guard<mutex> guard(_lock);
+			_stats.reads ++;
+			_stats.bytes += packed.size();
+		}
+		done(path, packed, true);
+		return;
+	}
+	Pending *pending = new Pending();
+	pending->path = path;
+	pending->done = done;
+	pending->size = pending->offset = 0;
+#ifdef _WIN32
+	pending->file = NULL;
+#else
+	pending->fd = -1;
+#endif
+	lock_guard<mutex> guard(_lock);
+	_queued.push_back(pending);
+}
+
+void AsyncIO::submit(){
+	deque<Pending *> batch;
+	{
+		lock_guard<mutex> guard(_lock);
+		batch.swap(_queued);
+	}
+	if (batch.empty())
+		return;
+	//with io_uring the files are opened here and the reads go to the kernel in one
+	//io_uring_enter, the fallback workers open their files themselves
+	vector<Pending *> failed;
+	if (_ring_fd >= 0)
+		for (size_t i = 0; i < batch.size(); i ++)
+			if (!open(batch[i]))
+				failed.push_back(batch[i]);
+	{
+		lock_guard<mutex> guard(_lock);
+		for (size_t i = 0; i < batch.size(); i ++)
+			if (find(failed.begin(), failed.end(), batch[i]) == failed.end())
+				_ready.push_back(batch[i]);
+		//files that didn't open complete right away, they were never in the ring
+		if (!failed.empty() && _in_flight == 0)
+			_busy_since = Clock::now();
+		_in_flight += failed.size();
+		fill();
+	}
+	for (size_t i = 0; i < failed.size(); i ++)
+		finish(failed[i], false);
+	_wake.notify_all();
+}
+
+void AsyncIO::started(){
+	if (_in_flight ++ == 0)
+		_busy_since = Clock::now();
+	_stats.maxQueueDepth = max(_stats.maxQueueDepth, _in_flight);
+}
+
+//close the file, hand the bytes to the callback and recycle what it didn't take
+void AsyncIO::finish(Pending *pending, bool ok){
+#ifdef _WIN32
+	if (pending->file != NULL)
+		fclose(pending->file);
+#else
+	if (pending->fd >= 0)
+		::close(pending->fd);
+#endif
+	if (ok)
+	{
+		pending->data._data = pending->data._buffer.data();
+		pending->data._size = pending->size;
+	}
+	else
+		recycle(pending->data);
+	pending->done(pending->path, pending->data, ok);
+	recycle(pending->data);
+
+	lock_guard<mutex> guard(_lock);
+	_stats.reads ++;
+	if (ok)
+		_stats.bytes += pending->size;
+	else
+		_stats.failed ++;
+	if (-- _in_flight == 0)
+		_stats.busySeconds += chrono::duration<double>(Clock::now() - _busy_since).count();
+	delete pending;
+	fill();
+	if (_in_flight == 0 && _ready.empty())
+		_idle.notify_all();
+}
+
+void AsyncIO::wait(){
+	unique_lock<mutex> guard(_lock);
+	while (_in_flight > 0 || !_ready.empty())
+		_idle.wait(guard);
+}
+
+void AsyncIO::prefetch(const vector<string> &paths){
+	for (size_t i = 0; i < paths.size(); i ++) {
+		Vfs::expect(paths[i]);
+		read(paths[i], Vfs::fulfill);
+	}
+	submit();
+}
+
+void AsyncIO::recycle(AssetData &data){
+	if (data._buffer.capacity() > 0)
+	{
+		lock_guard<mutex> guard(_lock);
+		if (_buffers.size() < MAX_BUFFERS)
+		{
+			_buffers.push_back(vector<unsigned char>());
+			_buffers.back().swap(data._buffer);
+		}
+	}
+	data.clear();
+}
+
+int AsyncIO::queueDepth(){
+	lock_guard<mutex> guard(_lock);
+	return _in_flight + (int)_ready.size();
+}
+
+AsyncIOStats AsyncIO::stats(){
+	lock_guard<mutex> guard(_lock);
+	AsyncIOStats stats = _stats;
+	if (_in_flight > 0)
+		stats.busySeconds += chrono::duration<double>(Clock::now() - _busy_since).count();
+	return stats;
+}
+
+void AsyncIO::report(ostream &out){
+	AsyncIOStats stats = this->stats();
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(2) << "async io (" << (usesUring() ? "io_uring" : "pread")
+		<< "): " << stats.reads << " reads, " << stats.failed << " failed, "
+		<< stats.bytes / 1024 << " KB, queue depth up to " << stats.maxQueueDepth << ", "
+		<< stats.bytesPerSecond() / (1024.0 * 1024.0) << " MB/s" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
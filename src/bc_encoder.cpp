@@ -0,0 +1,658 @@
+//this file contains the BC1/BC3/BC7 block encoder and decoder
+#include "../include/bc_encoder.h"
+#include "../include/job_system.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//weights of the 16 BC7 4-bit index levels, out of 64
+static const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+//a 4x4 block, channels are stored separately so 4 pixels fit in one SSE register
+struct Block {
+	float c[4][16];
+};
+
+static void loadBlock(const unsigned char *rgba, int width, int height, int bx, int by,
+	Block &block){
+	for (int y = 0; y < 4; y ++) {
+		int sy = min(by * 4 + y, height - 1);
+		for (int x = 0; x < 4; x ++) {
+			int sx = min(bx * 4 + x, width - 1);
+			const unsigned char *pixel = rgba + ((size_t)sy * width + sx) * 4;
+			for (int c = 0; c < 4; c ++)
+				block.c[c][y * 4 + x] = pixel[c];
+		}
+	}
+}
+
+//find the nearest palette color of every pixel
+//PRE:
+//	channels: 3 ignores alpha, 4 compares all channels
+//	mask: pixels with mask 0 are skipped and get no index, NULL uses every pixel
+//POST:
+//	return the total squared error
+static float nearest(const Block &block, const float palette[][4], int count, int channels,
+	const unsigned char *mask, unsigned char indices[16]){
+	float total = 0.0f;
+#ifdef __SSE2__
+	for (int p = 0; p < 16; p += 4) {
+		__m128 r = _mm_loadu_ps(block.c[0] + p);
+		__m128 g = _mm_loadu_ps(block.c[1] + p);
+		__m128 b = _mm_loadu_ps(block.c[2] + p);
+		__m128 a = _mm_loadu_ps(block.c[3] + p);
+		__m128 best = _mm_set1_ps(1e30f);
+		__m128i best_index = _mm_setzero_si128();
+		for (int k = 0; k < count; k ++) {
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+				_mm_mul_ps(db, db));
+			if (channels == 4)
+			{
+				__m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[k][3]));
+				d = _mm_add_ps(d, _mm_mul_ps(da, da));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			best = _mm_min_ps(best, d);
+			best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)),
+				_mm_andnot_si128(closer, best_index));
+		}
+		float errors[4];
+		int found[4];
+		_mm_storeu_ps(errors, best);
+		_mm_storeu_si128((__m128i *)found, best_index);
+		for (int i = 0; i < 4; i ++) {
+			if (mask != NULL && !mask[p + i])
+				continue;
+			indices[p + i] = found[i];
+			total += errors[i];
+		}
+	}
+#else
+	for (int p = 0; p < 16; p ++) {
+		if (mask != NULL && !mask[p])
+			continue;
+		float best = 1e30f;
+		int best_index = 0;
+		for (int k = 0; k < count; k ++) {
+			float d = 0.0f;
+			for (int c = 0; c < channels; c ++) {
+				float diff = block.c[c][p] - palette[k][c];
+				d += diff * diff;
+			}
+			if (d < best)
+			{
+				best = d;
+				best_index = k;
+			}
+		}
+		indices[p] = best_index;
+		total += best;
+	}
+#endif
+	return total;
+}
+
+//endpoints along the principal axis of the pixels, slightly inset to reduce error
+static void principalEndpoints(const Block &block, int channels, const unsigned char *mask,
+	float e0[4], float e1[4]){
+	float mean[4] = {0, 0, 0, 0};
+	int n = 0;
+	for (int p = 0; p < 16; p ++) {
+		if (mask != NULL && !mask[p])
+			continue;
+		for (int c = 0; c < channels; c ++)
+			mean[c] += block.c[c][p];
+		n ++;
+	}
+	if (n == 0)
+		n = 1;
+	for (int c = 0; c < channels; c ++)
+		mean[c] /= n;
+
+	float cov[4][4] = {{0}};
+	for (int p = 0; p < 16; p ++) {
+		if (mask != NULL && !mask[p])
+			continue;
+		for (int i = 0; i < channels; i ++)
+			for (int j = 0; j < channels; j ++)
+				cov[i][j] += (block.c[i][p] - mean[i]) * (block.c[j][p] - mean[j]);
+	}
+	//power iteration, a few steps are plenty for 16 points
+	float axis[4] = {1, 1, 1, 1};
+	for (int iteration = 0; iteration < 8; iteration ++) {
+		float next[4] = {0, 0, 0, 0};
+		float length = 0.0f;
+		for (int i = 0; i < channels; i ++) {
+			for (int j = 0; j < channels; j ++)
+				next[i] += cov[i][j] * axis[j];
+			length = max(length, fabsf(next[i]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int i = 0; i < channels; i ++)
+			axis[i] = next[i] / length;
+	}
+	float norm = 0.0f;
+	for (int c = 0; c < channels; c ++)
+		norm += axis[c] * axis[c];
+	norm = sqrtf(norm);
+	for (int c = 0; c < channels; c ++)
+		axis[c] /= norm;
+
+	float low = 1e30f, high = -1e30f;
+	for (int p = 0; p < 16; p ++) {
+		if (mask != NULL && !mask[p])
+			continue;
+		float t = 0.0f;
+		for (int c = 0; c < channels; c ++)
+			t += (block.c[c][p] - mean[c]) * axis[c];
+		low = min(low, t);
+		high = max(high, t);
+	}
+	if (low > high)
+		low = high = 0.0f;
+	float inset = (high - low) / 32.0f;
+	for (int c = 0; c < channels; c ++) {
+		e0[c] = min(255.0f, max(0.0f, mean[c] + axis[c] * (high - inset)));
+		e1[c] = min(255.0f, max(0.0f, mean[c] + axis[c] * (low + inset)));
+	}
+}
+
+//least squares endpoints for fixed indices, weights[i] is how far index i is from e0 to e1
+static bool refitEndpoints(const Block &block, int channels, const unsigned char *mask,
+	const unsigned char indices[16], const float *weights, float e0[4], float e1[4]){
+	float aa = 0, bb = 0, ab = 0;
+	float ax[4] = {0, 0, 0, 0}, bx[4] = {0, 0, 0, 0};
+	for (int p = 0; p < 16; p ++) {
+		if (mask != NULL && !mask[p])
+			continue;
+		float w = weights[indices[p]];
+		float a = 1.0f - w;
+		aa += a * a;
+		bb += w * w;
+		ab += a * w;
+		for (int c = 0; c < channels; c ++) {
+			ax[c] += a * block.c[c][p];
+			bx[c] += w * block.c[c][p];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+		return false;
+	for (int c = 0; c < channels; c ++) {
+		e0[c] = min(255.0f, max(0.0f, (ax[c] * bb - bx[c] * ab) / det));
+		e1[c] = min(255.0f, max(0.0f, (bx[c] * aa - ax[c] * ab) / det));
+	}
+	return true;
+}
+
+//---------------------------------BC1--------------------------------------//
+
+static unsigned short pack565(const float color[4]){
+	int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(unsigned short packed, int color[3]){
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+//the 4 colors a BC1 block can produce, alpha of the transparent entry is 0
+static void bc1Palette(unsigned short c0, unsigned short c1, bool fourColors, int palette[4][4]){
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	for (int c = 0; c < 3; c ++) {
+		if (fourColors)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[3][3] = fourColors ? 255 : 0;
+}
+
+//evaluate a pair of 565 endpoints, return the error and fill indices
+static float bc1Evaluate(const Block &block, const unsigned char *mask, unsigned short c0,
+	unsigned short c1, bool fourColors, unsigned char indices[16]){
+	int palette[4][4];
+	bc1Palette(c0, c1, fourColors, palette);
+	float colors[4][4];
+	for (int k = 0; k < 4; k ++)
+		for (int c = 0; c < 4; c ++)
+			colors[k][c] = palette[k][c];
+	return nearest(block, colors, fourColors ? 4 : 3, 3, mask, indices);
+}
+
+//encode the color part of a BC1/BC3 block
+//PRE:
+//	allowTransparent: BC1 may use the 3 color mode for pixels with alpha < 128
+static void encodeBC1Block(const Block &block, bool allowTransparent, int quality,
+	unsigned char *out){
+	unsigned char mask[16];
+	bool transparent = false;
+	int opaque = 0;
+	for (int p = 0; p < 16; p ++) {
+		mask[p] = !allowTransparent || block.c[3][p] >= 128.0f;
+		transparent |= !mask[p];
+		opaque += mask[p];
+	}
+	if (opaque == 0)
+	{
+		//c0 <= c1 selects the 3 color mode, index 3 is transparent black
+		memset(out, 0, 4);
+		memset(out + 4, 0xFF, 4);
+		return;
+	}
+
+	float e0[4], e1[4];
+	principalEndpoints(block, 3, mask, e0, e1);
+	unsigned short c0 = pack565(e0), c1 = pack565(e1);
+	bool four_colors = !transparent;
+	unsigned char indices[16];
+	float error = bc1Evaluate(block, mask, c0, c1, four_colors, indices);
+
+	//4 color mode: index 2 and 3 are 1/3 and 2/3 of the way, 3 color mode: 2 is half
+	static const float four_weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+	static const float three_weights[4] = {0.0f, 1.0f, 0.5f, 0.0f};
+	for (int iteration = 0; iteration < quality; iteration ++) {
+		if (!refitEndpoints(block, 3, mask, indices,
+			four_colors ? four_weights : three_weights, e0, e1))
+			break;
+		unsigned short r0 = pack565(e0), r1 = pack565(e1);
+		unsigned char refit[16];
+		float refit_error = bc1Evaluate(block, mask, r0, r1, four_colors, refit);
+		if (refit_error >= error)
+			break;
+		c0 = r0;
+		c1 = r1;
+		error = refit_error;
+		memcpy(indices, refit, 16);
+	}
+
+	//the order of the endpoints selects the mode, swapping them swaps index 0 and 1
+	//and, in 4 color mode, index 2 and 3
+	if ((four_colors && c0 < c1) || (!four_colors && c0 > c1))
+	{
+		swap(c0, c1);
+		static const unsigned char four_swap[4] = {1, 0, 3, 2};
+		static const unsigned char three_swap[4] = {1, 0, 2, 3};
+		for (int p = 0; p < 16; p ++)
+			indices[p] = four_colors ? four_swap[indices[p]] : three_swap[indices[p]];
+	}
+	if (four_colors && c0 == c1)
+		memset(indices, 0, 16);
+
+	unsigned int bits = 0;
+	for (int p = 0; p < 16; p ++)
+		bits |= (unsigned int)(mask[p] ? indices[p] : 3) << (2 * p);
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i ++)
+		out[4 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+static void decodeBC1Block(const unsigned char *in, bool forceFourColors, unsigned char rgba[16][4]){
+	unsigned short c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+	int palette[4][4];
+	bc1Palette(c0, c1, forceFourColors || c0 > c1, palette);
+	unsigned int bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int)in[7] << 24);
+	for (int p = 0; p < 16; p ++) {
+		int index = (bits >> (2 * p)) & 3;
+		for (int c = 0; c < 4; c ++)
+			rgba[p][c] = palette[index][c];
+	}
+}
+
+//---------------------------------BC3--------------------------------------//
+
+static void alphaPalette(int a0, int a1, int palette[8]){
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+		for (int i = 2; i < 8; i ++)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	else
+	{
+		for (int i = 2; i < 6; i ++)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static void encodeAlphaBlock(const Block &block, unsigned char *out){
+	int high = 0, low = 255;
+	for (int p = 0; p < 16; p ++) {
+		high = max(high, (int)block.c[3][p]);
+		low = min(low, (int)block.c[3][p]);
+	}
+	out[0] = high;
+	out[1] = low;
+	unsigned long long bits = 0;
+	if (high != low)
+	{
+		int palette[8];
+		alphaPalette(high, low, palette);
+		for (int p = 0; p < 16; p ++) {
+			int best = 0, best_error = 1 << 30;
+			for (int k = 0; k < 8; k ++) {
+				int error = abs(palette[k] - (int)block.c[3][p]);
+				if (error < best_error)
+				{
+					best_error = error;
+					best = k;
+				}
+			}
+			bits |= (unsigned long long)best << (3 * p);
+		}
+	}
+	for (int i = 0; i < 6; i ++)
+		out[2 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+static void decodeAlphaBlock(const unsigned char *in, unsigned char rgba[16][4]){
+	int palette[8];
+	alphaPalette(in[0], in[1], palette);
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i ++)
+		bits |= (unsigned long long)in[2 + i] << (8 * i);
+	for (int p = 0; p < 16; p ++)
+		rgba[p][3] = palette[(bits >> (3 * p)) & 7];
+}
+
+//---------------------------------BC7--------------------------------------//
+
+//quantize endpoints to 7 bits plus a shared low bit (p-bit) per endpoint
+static void bc7Quantize(const float e[4], int pbit, int q[4]){
+	for (int c = 0; c < 4; c ++)
+		q[c] = min(127, max(0, (int)floorf((e[c] - pbit) / 2.0f + 0.5f)));
+}
+
+static float bc7Evaluate(const Block &block, const int q0[4], int p0, const int q1[4], int p1,
+	unsigned char indices[16]){
+	float palette[16][4];
+	for (int c = 0; c < 4; c ++) {
+		int v0 = (q0[c] << 1) | p0, v1 = (q1[c] << 1) | p1;
+		for (int k = 0; k < 16; k ++)
+			palette[k][c] = (float)(((64 - BC7_WEIGHTS[k]) * v0 + BC7_WEIGHTS[k] * v1 + 32) >> 6);
+	}
+	return nearest(block, palette, 16, 4, NULL, indices);
+}
+
+//try p-bit combinations for a pair of endpoints and keep the best one
+static float bc7Fit(const Block &block, const float e0[4], const float e1[4], int quality,
+	int q0[4], int &p0, int q1[4], int &p1, unsigned char indices[16]){
+	float best = 1e30f;
+	for (int combo = 0; combo < 4; combo ++) {
+		int a = combo & 1, b = combo >> 1;
+		//at the lowest quality only try matching p-bits
+		if (quality == 0 && a != b)
+			continue;
+		int t0[4], t1[4];
+		unsigned char trial[16];
+		bc7Quantize(e0, a, t0);
+		bc7Quantize(e1, b, t1);
+		float error = bc7Evaluate(block, t0, a, t1, b, trial);
+		if (error < best)
+		{
+			best = error;
+			memcpy(q0, t0, sizeof(t0));
+			memcpy(q1, t1, sizeof(t1));
+			p0 = a;
+			p1 = b;
+			memcpy(indices, trial, 16);
+		}
+	}
+	return best;
+}
+
+//writes bits into a 128 bit block, least significant bit first
+struct BitWriter {
+	unsigned char *out;
+	int position;
+	void write(unsigned int value, int count){
+		for (int i = 0; i < count; i ++, position ++)
+			if ((value >> i) & 1)
+				out[position >> 3] |= 1 << (position & 7);
+	}
+};
+
+struct BitReader {
+	const unsigned char *in;
+	int position;
+	unsigned int read(int count){
+		unsigned int value = 0;
+		for (int i = 0; i < count; i ++, position ++)
+			value |= ((in[position >> 3] >> (position & 7)) & 1) << i;
+		return value;
+	}
+};
+
+static void encodeBC7Block(const Block &block, int quality, unsigned char *out){
+	float e0[4], e1[4];
+	principalEndpoints(block, 4, NULL, e0, e1);
+	int q0[4], q1[4], p0, p1;
+	unsigned char indices[16];
+	float error = bc7Fit(block, e0, e1, quality, q0, p0, q1, p1, indices);
+
+	float weights[16];
+	for (int k = 0; k < 16; k ++)
+		weights[k] = BC7_WEIGHTS[k] / 64.0f;
+	for (int iteration = 0; iteration < quality && error > 0.0f; iteration ++) {
+		if (!refitEndpoints(block, 4, NULL, indices, weights, e0, e1))
+			break;
+		int r0[4], r1[4], rp0, rp1;
+		unsigned char refit[16];
+		float refit_error = bc7Fit(block, e0, e1, quality, r0, rp0, r1, rp1, refit);
+		if (refit_error >= error)
+			break;
+		error = refit_error;
+		memcpy(q0, r0, sizeof(r0));
+		memcpy(q1, r1, sizeof(r1));
+		p0 = rp0;
+		p1 = rp1;
+		memcpy(indices, refit, 16);
+	}
+
+	//the top bit of the first index is implied 0, swap endpoints to make it so
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c ++)
+			swap(q0[c], q1[c]);
+		swap(p0, p1);
+		for (int p = 0; p < 16; p ++)
+			indices[p] = 15 - indices[p];
+	}
+
+	memset(out, 0, 16);
+	BitWriter writer = {out, 0};
+	writer.write(1 << 6, 7); //mode 6
+	for (int c = 0; c < 4; c ++) {
+		writer.write(q0[c], 7);
+		writer.write(q1[c], 7);
+	}
+	writer.write(p0, 1);
+	writer.write(p1, 1);
+	writer.write(indices[0], 3);
+	for (int p = 1; p < 16; p ++)
+		writer.write(indices[p], 4);
+}
+
+//only mode 6 is decoded since that is all we encode, other modes come out magenta
+static void decodeBC7Block(const unsigned char *in, unsigned char rgba[16][4]){
+	if ((in[0] & 0x7F) != 0x40)
+	{
+		for (int p = 0; p < 16; p ++) {
+			rgba[p][0] = rgba[p][2] = rgba[p][3] = 255;
+			rgba[p][1] = 0;
+		}
+		return;
+	}
+	BitReader reader = {in, 7};
+	int v0[4], v1[4];
+	for (int c = 0; c < 4; c ++) {
+		v0[c] = reader.read(7) << 1;
+		v1[c] = reader.read(7) << 1;
+	}
+	int p0 = reader.read(1), p1 = reader.read(1);
+	for (int c = 0; c < 4; c ++) {
+		v0[c] |= p0;
+		v1[c] |= p1;
+	}
+	for (int p = 0; p < 16; p ++) {
+		int w = BC7_WEIGHTS[reader.read(p == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; c ++)
+			rgba[p][c] = ((64 - w) * v0[c] + w * v1[c] + 32) >> 6;
+	}
+}
+
+//-------------------------------public API---------------------------------//
+
+static size_t blockBytes(BCFormat format){
+	return format == BC1 ? 8 : 16;
+}
+
+size_t BlockCompressor::encodedSize(int width, int height, BCFormat format){
+	if (format == BC_NONE)
+		return (size_t)width * height * 4;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void BlockCompressor::encode(const unsigned char *rgba, int width, int height, BCFormat format,
+	vector<unsigned char> &out, int threads, int quality, BCStats *stats){
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	size_t block_bytes = blockBytes(format);
+	if (format == BC_NONE)
+		out.assign(rgba, rgba + (size_t)width * height * 4);
+	else
+		out.resize(encodedSize(width, height, format));
+
+	//threads take the next row of blocks until every row is done
+	atomic<int> next_row(0);
+	auto work = [&]() {
+		Block block;
+		for (int by = next_row++; by < blocks_y; by = next_row++) {
+			unsigned char *row = &out[0] + (size_t)by * blocks_x * block_bytes;
+			for (int bx = 0; bx < blocks_x; bx ++) {
+				loadBlock(rgba, width, height, bx, by, block);
+				unsigned char *dst = row + bx * block_bytes;
+				if (format == BC1)
+					encodeBC1Block(block, true, quality, dst);
+				else if (format == BC3)
+				{
+					encodeAlphaBlock(block, dst);
+					encodeBC1Block(block, false, quality, dst + 8);
+				}
+				else
+					encodeBC7Block(block, quality, dst);
+			}
+		}
+	};
+	if (format != BC_NONE)
+	{
+		if (threads <= 0)
+			threads = max(1u, thread::hardware_concurrency());
+		threads = min(threads, blocks_y);
+		if (JobSystem::running() && threads > 1)
+			JobSystem::parallelFor(0, min(threads, JobSystem::threads()),
+				[&](size_t, size_t) { work(); }, 1);
+		else
+		{
+			vector<thread> workers;
+			for (int t = 1; t < threads; t ++)
+				workers.push_back(thread(work));
+			work();
+			for (size_t t = 0; t < workers.size(); t ++)
+				workers[t].join();
+		}
+	}
+
+	if (stats != NULL)
+	{
+		stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		stats->mpixelsPerSecond = stats->seconds > 0.0 ?
+			(double)width * height / stats->seconds / 1e6 : 0.0;
+		stats->psnr = psnr(rgba, &out[0], width, height, format);
+	}
+}
+
+void BlockCompressor::decode(const unsigned char *blocks, int width, int height, BCFormat format,
+	unsigned char *rgba){
+	if (format == BC_NONE)
+	{
+		memcpy(rgba, blocks, (size_t)width * height * 4);
+		return;
+	}
+	int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	size_t block_bytes = blockBytes(format);
+	for (int by = 0; by < blocks_y; by ++)
+		for (int bx = 0; bx < blocks_x; bx ++) {
+			const unsigned char *in = blocks + ((size_t)by * blocks_x + bx) * block_bytes;
+			unsigned char pixels[16][4];
+			if (format == BC1)
+				decodeBC1Block(in, false, pixels);
+			else if (format == BC3)
+			{
+				decodeBC1Block(in + 8, true, pixels);
+				decodeAlphaBlock(in, pixels);
+			}
+			else
+				decodeBC7Block(in, pixels);
+			for (int y = 0; y < 4 && by * 4 + y < height; y ++)
+				for (int x = 0; x < 4 && bx * 4 + x < width; x ++)
+					memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4,
+						pixels[y * 4 + x], 4);
+		}
+}
+
+double BlockCompressor::psnr(const unsigned char *rgba, const unsigned char *blocks,
+	int width, int height, BCFormat format){
+	vector<unsigned char> decoded((size_t)width * height * 4);
+	decode(blocks, width, height, format, &decoded[0]);
+	double error = 0.0;
+	for (size_t i = 0; i < decoded.size(); i ++) {
+		double diff = (double)decoded[i] - rgba[i];
+		error += diff * diff;
+	}
+	double mse = error / decoded.size();
+	if (mse <= 0.0)
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+GLenum BlockCompressor::glFormat(BCFormat format, bool srgb){
+	switch (format) {
+		case BC1:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BC7:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+		default:
+			return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	}
+}
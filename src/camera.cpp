@@ -1,60 +1,111 @@
-//this file is a camera class that can detect wsad and move accordingly. It also can 
+//this file is a camera class that can detect wsad and move accordingly. It also can
 //detect mouse movement and adjust view angle
 #include "../include/camera.h"
 
+#include <cmath>
+
+void Frustum::fromMatrix(const glm::mat4 &viewProj){
+	//rows of the matrix, glm indexes columns first
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i ++)
+		row[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	//a clip space point is inside when -w <= x, y, z <= w
+	planes[FRUSTUM_LEFT] = row[3] + row[0];
+	planes[FRUSTUM_RIGHT] = row[3] - row[0];
+	planes[FRUSTUM_BOTTOM] = row[3] + row[1];
+	planes[FRUSTUM_TOP] = row[3] - row[1];
+	planes[FRUSTUM_NEAR] = row[3] + row[2];
+	planes[FRUSTUM_FAR] = row[3] - row[2];
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i ++) {
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+			planes[i] /= length;
+	}
+}
+
+bool Frustum::sphereVisible(const glm::vec3 &center, float radius) const{
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i ++)
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+			return false;
+	return true;
+}
+
+bool Frustum::boxVisible(const glm::vec3 &min, const glm::vec3 &max) const{
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i ++) {
+		//the corner furthest along the plane's normal
+		glm::vec3 corner(planes[i].x >= 0.0f ? max.x : min.x,
+			planes[i].y >= 0.0f ? max.y : min.y, planes[i].z >= 0.0f ? max.z : min.z);
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
 Camera::Camera(glm::vec3 position ,glm::vec3 front, glm::vec3 up, float yaw, float pitch){
-	cameraPos = position;
-	cameraFront = front;
-	cameraUp = up;
-	_yaw = yaw;
+	_position = position;
+	_world_up = glm::normalize(up);
 	_pitch = pitch;
 	_speed = INIT_SPEED;
 	_fov = FOV_MAX;
+	_aspect = 1.0f;
+	_near = INIT_NEAR;
+	_far = INIT_FAR;
 	_mouse_sens = INIT_MOUSE_SENSITIVITY;
 	MOUSE_VERTICAL_INVERSE = false;
 	MOUSE_HORIZONTAL_INVERSE = false;
-	updateCamera();
+	//a yaw of -90 degrees looks down the negative z-axis, the camera's own direction
+	_orientation = glm::angleAxis(glm::radians(-(yaw - INIT_YAW)), _world_up) *
+		glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+	_revision = 0;
+	viewChanged();
+	projectionChanged();
 }
 
 void Camera::processKeypad(MOVEMENT direction, float delta_time) {
-	float speed = _speed * delta_time; 
+	float speed = _speed * delta_time;
 	switch (direction){
 		case FORWARD:{
-			cameraPos += cameraFront * speed;
+			_position += getFront() * speed;
 			break;
 		}
 		case BACKWARD:{
-			cameraPos -= cameraFront * speed;
+			_position -= getFront() * speed;
 			break;
 		}
 		case LEFT:{
-			cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * speed;
+			_position -= getRight() * speed;
 			break;
 		}
 		case RIGHT:{
-			cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * speed;
+			_position += getRight() * speed;
 			break;
 		}
 	}
+	viewChanged();
 }
 
 void Camera::processMouseMovement(float x_offset, float y_offset, GLboolean constrainPitch) {
 	x_offset *= _mouse_sens;
 	y_offset *= _mouse_sens;
+	if (x_offset == 0.0f && y_offset == 0.0f)
+		return;
 
-	//update yaw and pitch
-	_yaw += MOUSE_HORIZONTAL_INVERSE ? -x_offset : x_offset;
-	_pitch += MOUSE_VERTICAL_INVERSE ? -y_offset : y_offset;
+	float yaw = MOUSE_HORIZONTAL_INVERSE ? -x_offset : x_offset;
+	float pitch = MOUSE_VERTICAL_INVERSE ? -y_offset : y_offset;
 	//check whether we constrain pitch value
 	if (constrainPitch){
-		if(_pitch >= 89.0f)
-			_pitch = 89.0f;
-		if(_pitch <= -89.0f)
-			_pitch = -89.0f;
+		if (_pitch + pitch >= 89.0f)
+			pitch = 89.0f - _pitch;
+		if (_pitch + pitch <= -89.0f)
+			pitch = -89.0f - _pitch;
 	}
-	//update camera vector
-	updateCamera();
-
+	_pitch += pitch;
+	//yaw turns around the world's up, pitch around the camera's right
+	_orientation = glm::angleAxis(glm::radians(-yaw), _world_up) * _orientation *
+		glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+	//keep rounding errors from scaling the rotation
+	_orientation = glm::normalize(_orientation);
+	viewChanged();
 }
 
 void Camera::processMouseScroll(double scroll_value) {
@@ -64,25 +115,121 @@ void Camera::processMouseScroll(double scroll_value) {
 		_fov = FOV_MAX;
 	if (_fov <= FOV_MIN)
 		_fov = FOV_MIN;
+	projectionChanged();
+}
+
+void Camera::viewChanged() {
+	_view_dirty = true;
+	_view_projection_dirty = true;
+	_revision ++;
+}
+
+void Camera::projectionChanged() {
+	_projection_dirty = true;
+	_view_projection_dirty = true;
+	_revision ++;
+}
+
+const glm::mat4 &Camera::getView(){
+	if (_view_dirty)
+	{
+		//same as lookAt(position, position + front, up) without the cross products
+		glm::mat4 rotation = glm::mat4_cast(glm::conjugate(_orientation));
+		_view = glm::translate(rotation, -_position);
+		_inverse_view = glm::translate(glm::mat4(), _position) * glm::mat4_cast(_orientation);
+		_view_dirty = false;
+	}
+	return _view;
+}
+
+const glm::mat4 &Camera::getProjection(){
+	if (_projection_dirty)
+	{
+		_projection = glm::perspective(glm::radians(_fov), _aspect, _near, _far);
+		_projection_dirty = false;
+	}
+	return _projection;
+}
+
+const glm::mat4 &Camera::getViewProjection(){
+	if (_view_projection_dirty)
+	{
+		_view_projection = getProjection() * getView();
+		_inverse_view_projection = glm::inverse(_view_projection);
+		_frustum.fromMatrix(_view_projection);
+		_view_projection_dirty = false;
+	}
+	return _view_projection;
 }
 
-void Camera::updateCamera() {
-	//calculate the new front vector
-	glm::vec3 front;
-	front.x = cos(glm::radians(_yaw)) * cos(glm::radians(_pitch));
-	front.y = sin(glm::radians(_pitch));
-	front.z = sin(glm::radians(_yaw)) * cos(glm::radians(_pitch));
-	cameraFront = normalize(front);
+const glm::mat4 &Camera::getInverseView(){
+	getView();
+	return _inverse_view;
 }
 
-glm::mat4 Camera::getView(){
-	return glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+const glm::mat4 &Camera::getInverseViewProjection(){
+	getViewProjection();
+	return _inverse_view_projection;
+}
+
+const Frustum &Camera::getFrustum(){
+	getViewProjection();
+	return _frustum;
+}
+
+unsigned int Camera::getRevision() const{
+	return _revision;
+}
+
+glm::vec3 Camera::getPosition() const{
+	return _position;
+}
+
+glm::vec3 Camera::getFront() const{
+	return _orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+}
+
+glm::vec3 Camera::getRight() const{
+	return _orientation * glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+glm::vec3 Camera::getUp() const{
+	return _orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+glm::quat Camera::getOrientation() const{
+	return _orientation;
+}
+
+void Camera::setPosition(const glm::vec3 &position){
+	if (position == _position)
+		return;
+	_position = position;
+	viewChanged();
 }
 
 float Camera::getFOV(){
 	return _fov;
 }
 
+void Camera::setAspect(float aspect){
+	//a minimized window has no height, keep the last aspect
+	if (aspect <= 0.0f || !std::isfinite(aspect) || aspect == _aspect)
+		return;
+	_aspect = aspect;
+	projectionChanged();
+}
+
+float Camera::getAspect() const{
+	return _aspect;
+}
+
+void Camera::setClipPlanes(float near_plane, float far_plane){
+	_near = near_plane;
+	_far = far_plane;
+	projectionChanged();
+}
+
 void Camera::setSpeed(float speed){
 	_speed = speed;
 }
@@ -97,4 +244,4 @@ void Camera::setMouseHorizontalInverse(GLboolean inverse){
 
 void Camera::setMouseVerticalInverse(GLboolean inverse){
 	MOUSE_VERTICAL_INVERSE = inverse;
-}
\ No newline at end of file
+}
@@ -1,7 +1,19 @@
 #include "../include/config.h"
+#include "../include/gpu_memory.h"
+#include "../include/asset_pack.h"
+#include "../include/input.h"
+#include <string.h>
 //this file contains all config functions 
 
-void configTexture(const char *path, int texture){
+void configTexture(const char *path, int texture, BCFormat compression, bool srgb,
+	bool cpuMips, MipFilter mipFilter){
+	AssetData file;
+	Vfs::read(path, file);
+	configTexture(path, file, texture, compression, srgb, cpuMips, mipFilter);
+}
+
+void configTexture(const char *path, const AssetData &file, int texture, BCFormat compression,
+	bool srgb, bool cpuMips, MipFilter mipFilter){
 	int width, height, channels;
 	glBindTexture(GL_TEXTURE_2D, texture);
 	//set texture wrapping/filtering options
@@ -11,12 +23,52 @@ void configTexture(const char *path, int texture){
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	//loading picture 
 	stbi_set_flip_vertically_on_load(true);
-	unsigned char *data = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
-	if (data) 
+	if (compression == BC_NONE)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, 
-			GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		MipOptions mip_options;
+		mip_options.filter = mipFilter;
+		MipStats mip_stats;
+		bool loaded;
+		if (cpuMips)
+			loaded = loadTextureMips(file, texture, &width, &height, &channels, srgb,
+				mip_options, &mip_stats);
+		//decode straight into an upload buffer and let the driver filter the mips
+		else if ((loaded = loadTextureMapped(path, file, texture, &width, &height, &channels, srgb)))
+		{
+			GpuMemory::generateMipmap(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		if (loaded)
+		{
+			cout << path << " texture successfully loaded" << endl;
+			if (cpuMips)
+				cout << path << " mips built in " << mip_stats.seconds * 1000.0 << " ms, "
+					<< mip_stats.mpixelsPerSecond << " Mpixel/s" << endl;
+			if (channels < 4)
+			{
+				size_t saved = (size_t)width * height * (4 - channels);
+				size_t vram_saved = GpuMemory::levelBytes(GL_RGBA8, width, height) -
+					GpuMemory::levelBytes(channelFormat(channels, srgb).internalFormat, width, height);
+				cout << path << " kept " << channels << " channels, " << saved / 1024 
+					<< " KB less to upload, " << vram_saved / 1024 << " KB less video memory (level 0)" << endl;
+			}
+		}
+		else
+			cout << "Failed to load texture" << endl;
+		return;
+	}
+	unsigned char *data = NULL;
+	if (file.size() > 0)
+		data = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height,
+			&channels, STBI_rgb_alpha);
+	if (data)
+	{
+		//compressed textures can't use glGenerateMipmap, we only sample level 0 anyway
+		BCStats stats;
+		if (uploadCompressed(texture, 0, data, width, height, compression, 1, &stats) != BC_NONE)
+			cout << path << " compressed, PSNR " << stats.psnr << " dB, " 
+				<< stats.mpixelsPerSecond << " Mpixel/s" << endl;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
 		cout << path << " texture successfully loaded" << endl;
 	}
 	else 
@@ -26,52 +78,209 @@ void configTexture(const char *path, int texture){
 	stbi_image_free(data);
 }
 
-//process user input
+ChannelFormat channelFormat(int channels, bool srgb){
+	ChannelFormat result;
+	//there are no sRGB one or two channel formats in core OpenGL, expand grey to RGB
+	if (srgb && channels < 3)
+		channels += 2;
+	result.channels = channels;
+	result.swizzle[0] = GL_RED;
+	result.swizzle[1] = GL_GREEN;
+	result.swizzle[2] = GL_BLUE;
+	result.swizzle[3] = GL_ALPHA;
+	switch (channels) {
+		case 1:
+			//grey: (g, g, g, 1)
+			result.internalFormat = GL_R8;
+			result.format = GL_RED;
+			result.swizzle[1] = result.swizzle[2] = GL_RED;
+			result.swizzle[3] = GL_ONE;
+			break;
+		case 2:
+			//grey and alpha: (g, g, g, a)
+			result.internalFormat = GL_RG8;
+			result.format = GL_RG;
+			result.swizzle[1] = result.swizzle[2] = GL_RED;
+			result.swizzle[3] = GL_GREEN;
+			break;
+		case 3:
+			result.internalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+			result.format = GL_RGB;
+			result.swizzle[3] = GL_ONE;
+			break;
+		default:
+			result.channels = 4;
+			result.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			result.format = GL_RGBA;
+			break;
+	}
+	return result;
+}
+
+bool loadTextureMapped(const char *path, const AssetData &file, unsigned int texture,
+	int *width, int *height, int *channels, bool srgb){
+	int file_channels;
+	if (file.size() == 0 ||
+		!stbi_info_from_memory(file.data(), (int)file.size(), width, height, &file_channels))
+		return false;
+	ChannelFormat format = channelFormat(file_channels, srgb);
+	//pad rows to the unpack alignment instead of changing it, stbi_load_into writes
+	//with any stride
+	int alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	int stride = (*width * format.channels + alignment - 1) / alignment * alignment;
+	size_t size = (size_t)stride * *height;
+
+	//decode into a write-only mapping of a pixel unpack buffer, the driver copies it
+	//into the texture without another CPU side image
+	unsigned int pbo = GpuMemory::genBuffer(GPU_OTHER, string("upload ") + path);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	GpuMemory::bufferData(GL_PIXEL_UNPACK_BUFFER, pbo, size, NULL, GL_STREAM_DRAW);
+	unsigned char *dest = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	bool decoded = dest != NULL && stbi_load_into_from_memory(file.data(), (int)file.size(),
+		dest, stride, size, width, height, &file_channels, format.channels);
+	//unmapping fails if the buffer contents were lost, eg. on a mode switch
+	bool valid = dest != NULL && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+	if (decoded && valid)
+	{
+		//pixels is an offset into the bound unpack buffer
+		GpuMemory::texImage2D(GL_TEXTURE_2D, texture, 0, format.internalFormat, *width, *height,
+			format.format, GL_UNSIGNED_BYTE, (const void *)0);
+		//shaders keep reading RGBA
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GpuMemory::deleteBuffer(pbo);
+	*channels = format.channels;
+	return decoded && valid;
+}
+
+bool loadTextureMips(const AssetData &file, unsigned int texture, int *width, int *height,
+	int *channels, bool srgb, const MipOptions &options, MipStats *stats){
+	int file_channels;
+	if (file.size() == 0 ||
+		!stbi_info_from_memory(file.data(), (int)file.size(), width, height, &file_channels))
+		return false;
+	ChannelFormat format = channelFormat(file_channels, srgb);
+	int alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	int stride = (*width * format.channels + alignment - 1) / alignment * alignment;
+	size_t size = (size_t)stride * *height;
+	vector<unsigned char> pixels(size);
+	if (!stbi_load_into_from_memory(file.data(), (int)file.size(), &pixels[0], stride, size,
+		width, height, &file_channels, format.channels))
+		return false;
+
+	MipOptions level_options = options;
+	level_options.srgb = srgb;
+	level_options.alignment = alignment;
+	vector<MipLevel> levels;
+	MipBuilder::build(&pixels[0], *width, *height, stride, format.channels, levels,
+		level_options, stats);
+
+	GpuMemory::texImage2D(GL_TEXTURE_2D, texture, 0, format.internalFormat, *width, *height,
+		format.format, GL_UNSIGNED_BYTE, &pixels[0]);
+	for (size_t i = 0; i < levels.size(); i ++)
+		GpuMemory::texImage2D(GL_TEXTURE_2D, texture, (int)i + 1, format.internalFormat,
+			levels[i].width, levels[i].height, format.format, GL_UNSIGNED_BYTE,
+			&levels[i].pixels[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)levels.size());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	//shaders keep reading RGBA
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+	*channels = format.channels;
+	return true;
+}
+
+//check the extension list of the current context
+bool hasExtension(const char *name){
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i ++) {
+		const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != NULL && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+//check the extensions needed by a block format
+bool compressionSupported(BCFormat format){
+	switch (format) {
+		case BC_NONE:
+			return true;
+		case BC1:
+		case BC3:
+			return hasExtension("GL_EXT_texture_compression_s3tc");
+		case BC7:
+			//BPTC is core since OpenGL 4.2
+			return GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2) ||
+				hasExtension("GL_ARB_texture_compression_bptc");
+	}
+	return false;
+}
+
+BCFormat uploadCompressed(unsigned int texture, int level, const unsigned char *rgba,
+	int width, int height, BCFormat format, int quality, BCStats *stats){
+	if (format != BC_NONE && !compressionSupported(format))
+	{
+		cout << "Compressed texture format is not supported, uploading RGBA8" << endl;
+		format = BC_NONE;
+	}
+	if (format == BC_NONE)
+	{
+		GpuMemory::texImage2D(GL_TEXTURE_2D, texture, level, GL_RGBA, width, height, GL_RGBA,
+			GL_UNSIGNED_BYTE, rgba);
+		return BC_NONE;
+	}
+	vector<unsigned char> blocks;
+	BlockCompressor::encode(rgba, width, height, format, blocks, 0, quality, stats);
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, BlockCompressor::glFormat(format), width, height, 0,
+		blocks.size(), &blocks[0]);
+	GpuMemory::trackLevel(texture, level, BlockCompressor::glFormat(format), width, height, blocks.size());
+	return format;
+}
+
+//process user input, the actions were updated from the queued GLFW events
 void processInput(GLFWwindow *window){
-	//set input mode
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	Input::update();
 
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (Input::pressed(ACTION_QUIT))
 		glfwSetWindowShouldClose(window, true);
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+	if (Input::held(ACTION_MIX_UP))
 		mix_value += mix_value >= 1.0f ? 0 : 0.01f;
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+	if (Input::held(ACTION_MIX_DOWN))
 		mix_value -= mix_value <= 0.0f ? 0 : 0.01f;
 
+	//print the gpu memory report once per press
+	if (Input::pressed(ACTION_MEMORY_REPORT))
+		GpuMemory::report();
+	if (Input::pressed(ACTION_DEPTH_PREPASS))
+	{
+		depth_prepass = !depth_prepass;
+		cout << "depth pre-pass " << (depth_prepass ? "on" : "off") << endl;
+	}
+
 	//walking
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	if (Input::held(ACTION_FORWARD))
 		camera.processKeypad(FORWARD, delta_time);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	if (Input::held(ACTION_BACKWARD))
 		camera.processKeypad(BACKWARD, delta_time);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	if (Input::held(ACTION_LEFT))
 		camera.processKeypad(LEFT, delta_time);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	if (Input::held(ACTION_RIGHT))
 		camera.processKeypad(RIGHT, delta_time);
+
+	//zooming
+	if (Input::scrollY() != 0.0f)
+		camera.processMouseScroll(Input::scrollY());
 }
 
 //this callback function is called whenever the window size is changed
 void framebuffer_size_callback(GLFWwindow *window, int width, int height){
 	glViewport(0, 0, width, height);
-}
-
-//call back function whenever mouse is moved
-void mouse_callback(GLFWwindow *window, double x, double y){
-	//calculate difference mouse position from the last frame
-	if (MOUSE_FIRST){
-		MOUSE_FIRST = 0;
-		MOUSE_X = x;
-		MOUSE_Y = y;
-	}
-	float x_offset = x - MOUSE_X;
-	float y_offset = y - MOUSE_Y;
-	//update current position
-	MOUSE_X = x;
-	MOUSE_Y = y;
-	camera.processMouseMovement(x_offset, y_offset);
-}
-
-//call back function whenever mouse is scolled
-//y is the value that mouse scrolled
-void scroll_callback(GLFWwindow *window, double x, double y){
-	camera.processMouseScroll(y);
+	//a minimized window has a 0 height, the camera keeps its aspect then
+	if (height > 0)
+		camera.setAspect((float)width / height);
 }
\ No newline at end of file
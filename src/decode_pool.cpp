@@ -0,0 +1,183 @@
+//this file contains the per-thread pools stb_image allocates from
+#include "../include/decode_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <iomanip>
+
+//every block starts with a header, 16 bytes keep the data as aligned as malloc's
+struct BlockHeader {
+	size_t size;	//bytes requested
+	size_t capacity;	//bytes usable after the header
+};
+
+//4 size classes per power of two, so a block wastes at most a quarter of itself
+static const int CLASSES_PER_OCTAVE = 4;
+static const int MIN_OCTAVE = 12;	//log2 of MIN_POOLED
+static const int CLASS_COUNT = (64 - MIN_OCTAVE) * CLASSES_PER_OCTAVE;
+
+static atomic<size_t> allocations(0), pooled(0), reused(0), bytesAllocated(0);
+static atomic<size_t> liveBytes(0), peakBytes(0), cachedBytes(0);
+static atomic<size_t> limit(64 * 1024 * 1024);
+
+struct ThreadPool {
+	vector<BlockHeader *> blocks[CLASS_COUNT];	//free blocks of each class
+	size_t bytes;
+	ThreadPool() : bytes(0) {}
+	~ThreadPool();
+	void trim();
+};
+
+static thread_local ThreadPool threadPool;
+//blocks can still be freed while the thread exits, after its pool is gone
+static thread_local bool poolDestroyed = false;
+
+void ThreadPool::trim(){
+	for (int c = 0; c < CLASS_COUNT; c ++) {
+		for (size_t i = 0; i < blocks[c].size(); i ++)
+			free(blocks[c][i]);
+		blocks[c].clear();
+	}
+	cachedBytes -= bytes;
+	bytes = 0;
+}
+
+ThreadPool::~ThreadPool(){
+	trim();
+	poolDestroyed = true;
+}
+
+//size class of a request and the capacity of its blocks, -1 for requests that
+//aren't pooled
+static int sizeClass(size_t size, size_t &capacity){
+	if (size <= DecodePool::MIN_POOLED || size > SIZE_MAX / 2)
+	{
+		capacity = size;
+		return -1;
+	}
+	//size is in (2^octave, 2^(octave+1)], rounded up to a quarter of 2^octave
+	int octave = 0;
+	for (size_t s = size - 1; s > 1; s >>= 1)
+		octave ++;
+	size_t step = (size_t)1 << (octave - 2);
+	capacity = (size + step - 1) & ~(step - 1);
+	return (octave - MIN_OCTAVE) * CLASSES_PER_OCTAVE + (int)(capacity / step) - 5;
+}
+
+static void addLive(size_t bytes){
+	size_t live = liveBytes += bytes;
+	size_t peak = peakBytes.load();
+	while (live > peak && !peakBytes.compare_exchange_weak(peak, live));
+}
+
+void *DecodePool::allocate(size_t size){
+	size_t capacity;
+	int c = sizeClass(size, capacity);
+	BlockHeader *block = NULL;
+	allocations ++;
+	bytesAllocated += size;
+	if (c >= 0)
+	{
+		pooled ++;
+		if (!poolDestroyed && !threadPool.blocks[c].empty())
+		{
+			block = threadPool.blocks[c].back();
+			threadPool.blocks[c].pop_back();
+			threadPool.bytes -= capacity;
+			cachedBytes -= capacity;
+			reused ++;
+		}
+	}
+	if (block == NULL)
+	{
+		block = (BlockHeader *)malloc(sizeof(BlockHeader) + capacity);
+		//blocks of other classes may be what is holding the memory
+		if (block == NULL && !poolDestroyed && threadPool.bytes > 0)
+		{
+			threadPool.trim();
+			block = (BlockHeader *)malloc(sizeof(BlockHeader) + capacity);
+		}
+		if (block == NULL)
+			return NULL;
+	}
+	block->size = size;
+	block->capacity = capacity;
+	addLive(size);
+	return block + 1;
+}
+
+void *DecodePool::reallocate(void *p, size_t size){
+	if (p == NULL)
+		return allocate(size);
+	BlockHeader *block = (BlockHeader *)p - 1;
+	if (size <= block->capacity)
+	{
+		liveBytes -= block->size;
+		addLive(size);
+		block->size = size;
+		return p;
+	}
+	void *moved = allocate(size);
+	if (moved == NULL)
+		return NULL;
+	memcpy(moved, p, block->size);
+	release(p);
+	return moved;
+}
+
+void DecodePool::release(void *p){
+	if (p == NULL)
+		return;
+	BlockHeader *block = (BlockHeader *)p - 1;
+	liveBytes -= block->size;
+	size_t capacity;
+	int c = sizeClass(block->capacity, capacity);
+	if (c >= 0 && !poolDestroyed && threadPool.bytes + capacity <= limit)
+	{
+		threadPool.blocks[c].push_back(block);
+		threadPool.bytes += capacity;
+		cachedBytes += capacity;
+		return;
+	}
+	free(block);
+}
+
+void DecodePool::setLimit(size_t bytes){
+	limit = bytes;
+	if (!poolDestroyed && threadPool.bytes > bytes)
+		threadPool.trim();
+}
+
+void DecodePool::trim(){
+	if (!poolDestroyed)
+		threadPool.trim();
+}
+
+DecodePoolStats DecodePool::stats(){
+	DecodePoolStats stats;
+	stats.allocations = allocations;
+	stats.pooled = pooled;
+	stats.reused = reused;
+	stats.bytesAllocated = bytesAllocated;
+	stats.liveBytes = liveBytes;
+	stats.peakBytes = peakBytes;
+	stats.cachedBytes = cachedBytes;
+	return stats;
+}
+
+void DecodePool::report(ostream &out){
+	DecodePoolStats stats = DecodePool::stats();
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	double mb = 1024.0 * 1024.0;
+	out << fixed << setprecision(2) << "decode pool: " << stats.allocations
+		<< " allocations, " << stats.reused << " of " << stats.pooled << " pooled reused ("
+		<< stats.reuseRate() * 100.0 << "%), " << stats.bytesAllocated / mb
+		<< " MB allocated, peak " << stats.peakBytes / mb << " MB, live "
+		<< stats.liveBytes / mb << " MB, cached " << stats.cachedBytes / mb << " MB" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,295 @@
+//this file contains the GL call profiler that runs on the glad debug callbacks
+#include "../include/gl_profiler.h"
+#include "../include/glad/glad.h"
+#include "../include/gpu_memory.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <chrono>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <iomanip>
+
+struct ProfiledFunction {
+	GLCallStats stats;
+	size_t frame_calls;
+	bool frame_synced;	//a synchronizing call that wasn't allowed in this frame
+	bool allowed;	//synchronizing calls of it don't flag the frame
+};
+
+struct ProfilerState {
+	bool attached;
+	vector<ProfiledFunction> functions;
+	//glad passes the same string literal for every call of a function
+	unordered_map<const char *, size_t> index;
+	set<string> allowed;
+	vector<size_t> touched;	//functions called in this frame
+	size_t current;	//function between the pre and the post callback
+	chrono::steady_clock::time_point start;
+	bool unpack_buffer;	//a pixel unpack buffer is bound, texture data is an offset
+	GLFrameStats frame, last;
+	size_t frames, sync_frames;
+	size_t calls;
+	double seconds;
+	size_t upload_bytes;
+	ProfilerState() : attached(false), current(0), unpack_buffer(false), frames(0),
+		sync_frames(0), calls(0), seconds(0.0), upload_bytes(0) {
+		memset(&frame, 0, sizeof(frame));
+		memset(&last, 0, sizeof(last));
+	}
+};
+
+static ProfilerState &state(){
+	static ProfilerState profiler;
+	return profiler;
+}
+
+//the callbacks and what only they use exist in builds with the glad debug wrappers
+#ifdef GLAD_DEBUG
+//whether calls of the function make the CPU wait, mapping is decided per call
+static bool synchronizes(const char *name){
+	return strncmp(name, "glGet", 5) == 0 || strcmp(name, "glReadPixels") == 0 ||
+		strcmp(name, "glFinish") == 0 || strcmp(name, "glClientWaitSync") == 0 ||
+		strcmp(name, "glMapBuffer") == 0;
+}
+
+static ProfiledFunction &lookup(ProfilerState &profiler, const char *name){
+	unordered_map<const char *, size_t>::iterator found = profiler.index.find(name);
+	if (found != profiler.index.end())
+		return profiler.functions[found->second];
+	ProfiledFunction function;
+	function.stats.name = name;
+	function.stats.calls = function.stats.maxFrameCalls = 0;
+	function.stats.seconds = function.stats.maxSeconds = 0.0;
+	function.stats.uploadBytes = 0;
+	function.stats.sync = synchronizes(name) || strcmp(name, "glMapBufferRange") == 0;
+	function.stats.syncFrames = 0;
+	function.frame_calls = 0;
+	function.frame_synced = false;
+	function.allowed = profiler.allowed.count(function.stats.name) > 0;
+	profiler.index[name] = profiler.functions.size();
+	profiler.functions.push_back(function);
+	return profiler.functions.back();
+}
+
+//-------------------------------callbacks----------------------------------//
+
+//bytes a call hands to GL, read from its arguments
+static size_t uploadBytes(ProfilerState &profiler, const char *name, va_list args){
+	if (strcmp(name, "glBufferData") == 0)
+	{
+		va_arg(args, GLenum);
+		return (size_t)va_arg(args, GLsizeiptr);
+	}
+	if (strcmp(name, "glBufferSubData") == 0)
+	{
+		va_arg(args, GLenum);
+		va_arg(args, GLintptr);
+		return (size_t)va_arg(args, GLsizeiptr);
+	}
+	bool image = strcmp(name, "glTexImage2D") == 0;
+	bool sub_image = strcmp(name, "glTexSubImage2D") == 0;
+	bool compressed = strcmp(name, "glCompressedTexImage2D") == 0;
+	bool compressed_sub = strcmp(name, "glCompressedTexSubImage2D") == 0;
+	if (!image && !sub_image && !compressed && !compressed_sub)
+		return 0;
+	va_arg(args, GLenum);	//target
+	va_arg(args, GLint);	//level
+	GLint format = 0;
+	if (image || compressed)
+		format = va_arg(args, GLint);
+	else
+	{
+		va_arg(args, GLint);	//xoffset
+		va_arg(args, GLint);	//yoffset
+	}
+	GLsizei width = va_arg(args, GLsizei);
+	GLsizei height = va_arg(args, GLsizei);
+	if (image || compressed)
+		va_arg(args, GLint);	//border
+	//the uncompressed calls have the format of the data next, the sub image calls
+	//measure in it
+	if (image)
+		va_arg(args, GLenum);
+	else if (sub_image || compressed_sub)
+		format = va_arg(args, GLint);
+	if (compressed || compressed_sub)
+	{
+		GLsizei size = va_arg(args, GLsizei);
+		const void *data = va_arg(args, const void *);
+		return data != NULL || profiler.unpack_buffer ? (size_t)size : 0;
+	}
+	va_arg(args, GLenum);	//type
+	const void *data = va_arg(args, const void *);
+	//glTexImage2D without data only allocates the level
+	if (data == NULL && !profiler.unpack_buffer)
+		return 0;
+	return GpuMemory::levelBytes(format, width, height);
+}
+
+static void preCall(const char *name, void *funcptr, int len_args, ...){
+	ProfilerState &profiler = state();
+	ProfiledFunction &function = lookup(profiler, name);
+	profiler.current = &function - &profiler.functions[0];
+	if (function.frame_calls ++ == 0)
+		profiler.touched.push_back(profiler.current);
+
+	va_list args;
+	va_start(args, len_args);
+	size_t bytes = uploadBytes(profiler, name, args);
+	va_end(args);
+	function.stats.uploadBytes += bytes;
+	profiler.frame.uploadBytes += bytes;
+
+	bool sync = function.stats.sync;
+	if (strcmp(name, "glMapBufferRange") == 0)
+	{
+		va_start(args, len_args);
+		va_arg(args, GLenum);
+		va_arg(args, GLintptr);
+		va_arg(args, GLsizeiptr);
+		sync = (va_arg(args, GLbitfield) & GL_MAP_UNSYNCHRONIZED_BIT) == 0;
+		va_end(args);
+	}
+	else if (strcmp(name, "glBindBuffer") == 0)
+	{
+		va_start(args, len_args);
+		GLenum target = va_arg(args, GLenum);
+		GLuint buffer = va_arg(args, GLuint);
+		if (target == GL_PIXEL_UNPACK_BUFFER)
+			profiler.unpack_buffer = buffer != 0;
+		va_end(args);
+	}
+	if (sync && !function.allowed)
+	{
+		profiler.frame.syncCalls ++;
+		function.frame_synced = true;
+	}
+	//taken last so the bookkeeping above isn't timed
+	profiler.start = chrono::steady_clock::now();
+}
+
+static void postCall(const char *name, void *funcptr, int len_args, ...){
+	ProfilerState &profiler = state();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() -
+		profiler.start).count();
+	GLCallStats &stats = profiler.functions[profiler.current].stats;
+	stats.calls ++;
+	stats.seconds += seconds;
+	stats.maxSeconds = max(stats.maxSeconds, seconds);
+	profiler.frame.calls ++;
+	profiler.frame.seconds += seconds;
+}
+#endif
+
+//-------------------------------frames-------------------------------------//
+
+bool GLProfiler::attach(){
+#ifdef GLAD_DEBUG
+	glad_set_pre_callback(preCall);
+	glad_set_post_callback(postCall);
+	state().attached = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void GLProfiler::detach(){
+#ifdef GLAD_DEBUG
+	glad_set_pre_callback(NULL);
+	glad_set_post_callback(NULL);
+#endif
+	state().attached = false;
+}
+
+bool GLProfiler::attached(){
+	return state().attached;
+}
+
+void GLProfiler::allowSync(const char *name){
+	ProfilerState &profiler = state();
+	profiler.allowed.insert(name);
+	for (size_t i = 0; i < profiler.functions.size(); i ++)
+		if (profiler.functions[i].stats.name == name)
+			profiler.functions[i].allowed = true;
+}
+
+void GLProfiler::endFrame(){
+	ProfilerState &profiler = state();
+	for (size_t i = 0; i < profiler.touched.size(); i ++) {
+		ProfiledFunction &function = profiler.functions[profiler.touched[i]];
+		GLCallStats &stats = function.stats;
+		stats.maxFrameCalls = max(stats.maxFrameCalls, function.frame_calls);
+		if (function.frame_synced)
+			stats.syncFrames ++;
+		function.frame_calls = 0;
+		function.frame_synced = false;
+	}
+	profiler.touched.clear();
+	profiler.frames ++;
+	if (profiler.frame.syncCalls > 0)
+		profiler.sync_frames ++;
+	profiler.calls += profiler.frame.calls;
+	profiler.seconds += profiler.frame.seconds;
+	profiler.upload_bytes += profiler.frame.uploadBytes;
+	profiler.last = profiler.frame;
+	memset(&profiler.frame, 0, sizeof(profiler.frame));
+}
+
+GLFrameStats GLProfiler::lastFrame(){
+	return state().last;
+}
+
+size_t GLProfiler::frames(){
+	return state().frames;
+}
+
+size_t GLProfiler::syncFrames(){
+	return state().sync_frames;
+}
+
+static bool slower(const GLCallStats &a, const GLCallStats &b){
+	return a.seconds > b.seconds;
+}
+
+vector<GLCallStats> GLProfiler::calls(){
+	ProfilerState &profiler = state();
+	vector<GLCallStats> calls;
+	for (size_t i = 0; i < profiler.functions.size(); i ++)
+		calls.push_back(profiler.functions[i].stats);
+	sort(calls.begin(), calls.end(), slower);
+	return calls;
+}
+
+void GLProfiler::report(ostream &out, size_t top){
+	ProfilerState &profiler = state();
+	if (profiler.frames == 0)
+		return;
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	double frames = (double)profiler.frames;
+	out << fixed << setprecision(1) << "GL calls: " << profiler.calls / frames
+		<< " per frame, " << setprecision(3) << profiler.seconds / frames * 1000.0
+		<< " ms per frame in the driver, " << setprecision(1)
+		<< profiler.upload_bytes / frames / 1024.0 << " KB uploaded per frame, "
+		<< profiler.sync_frames << " of " << profiler.frames << " frames synchronized"
+		<< endl;
+	vector<GLCallStats> calls = GLProfiler::calls();
+	for (size_t i = 0; i < calls.size() && i < top; i ++) {
+		const GLCallStats &stats = calls[i];
+		out << "  " << left << setw(28) << stats.name << right << setprecision(1)
+			<< stats.calls / frames << " per frame (at most " << stats.maxFrameCalls << "), "
+			<< setprecision(2) << (stats.calls ? stats.seconds / stats.calls * 1e6 : 0.0)
+			<< " us per call, slowest " << stats.maxSeconds * 1e6 << " us";
+		if (stats.uploadBytes > 0)
+			out << ", " << setprecision(1) << stats.uploadBytes / frames / 1024.0
+				<< " KB per frame";
+		if (stats.syncFrames > 0)
+			out << ", synchronized in " << stats.syncFrames << " frames";
+		out << endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -1816,8 +1816,8 @@ static void find_coreGL(void) {
 
 int gladLoadGLLoader(GLADloadproc load) {
 	GLVersion.major = 0; GLVersion.minor = 0;
-	glGetString = (PFNGLGETSTRINGPROC)load("glGetString");
-	if(glGetString == NULL) return 0;
+	glad_glGetString = (PFNGLGETSTRINGPROC)load("glGetString");
+	if(glad_glGetString == NULL) return 0;
 	if(glGetString(GL_VERSION) == NULL) return 0;
 	find_coreGL();
 	load_GL_VERSION_1_0(load);
@@ -1837,3 +1837,58 @@ int gladLoadGLLoader(GLADloadproc load) {
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
+#ifdef GLAD_LOAD_USED_ONLY
+int gladLoadGLUsed(GLADloadproc load) {
+	int resolved = 0;
+	GLVersion.major = 0; GLVersion.minor = 0;
+	glad_glGetString = (PFNGLGETSTRINGPROC)load("glGetString");
+	if(glad_glGetString == NULL) return 0;
+	if(glGetString(GL_VERSION) == NULL) return 0;
+	find_coreGL();
+#define GLAD_USED(name, type) glad_##name = (type)load(#name); resolved += glad_##name != NULL;
+#include "glad_used.h"
+#undef GLAD_USED
+	if(GLVersion.major == 0 && GLVersion.minor == 0) return 0;
+	return resolved;
+}
+#endif
+
+#ifdef GLAD_DEBUG
+static void _glad_callback_default(const char *name, void *funcptr, int len_args, ...) {
+	(void) name; (void) funcptr; (void) len_args;
+}
+static GLADcallback _pre_call_callback = _glad_callback_default;
+static GLADcallback _post_call_callback = _glad_callback_default;
+
+void glad_set_pre_callback(GLADcallback cb) {
+	_pre_call_callback = cb != NULL ? cb : _glad_callback_default;
+}
+
+void glad_set_post_callback(GLADcallback cb) {
+	_post_call_callback = cb != NULL ? cb : _glad_callback_default;
+}
+
+/* callback_args is the argument count followed by the arguments, in parentheses */
+#define GLAD_CALLBACK_ARGS(...) __VA_ARGS__
+#define GLAD_DEBUG_VOID(name, type, params, args, callback_args) \
+	static void APIENTRY glad_debug_impl_##name params { \
+		_pre_call_callback(#name, (void *)glad_##name, GLAD_CALLBACK_ARGS callback_args); \
+		glad_##name args; \
+		_post_call_callback(#name, (void *)glad_##name, GLAD_CALLBACK_ARGS callback_args); \
+	} \
+	type glad_debug_##name = glad_debug_impl_##name;
+#define GLAD_DEBUG_RETURN(ret, name, type, params, args, callback_args) \
+	static ret APIENTRY glad_debug_impl_##name params { \
+		ret value; \
+		_pre_call_callback(#name, (void *)glad_##name, GLAD_CALLBACK_ARGS callback_args); \
+		value = glad_##name args; \
+		_post_call_callback(#name, (void *)glad_##name, GLAD_CALLBACK_ARGS callback_args); \
+		return value; \
+	} \
+	type glad_debug_##name = glad_debug_impl_##name;
+#define GLAD_DEBUG_IMPL
+#include "glad_debug.h"
+#undef GLAD_DEBUG_IMPL
+#undef GLAD_DEBUG_RETURN
+#undef GLAD_DEBUG_VOID
+#endif
@@ -0,0 +1,270 @@
+//this file contains the registry of GPU buffers and textures
+#include "../include/gpu_memory.h"
+#include "../include/config.h"
+
+#include <iomanip>
+#include <algorithm>
+
+static const char *CATEGORY_NAMES[GPU_CATEGORY_COUNT] = {
+	"geometry", "textures", "render targets", "other"
+};
+
+//block compressed formats, these tokens are not in our glad loader
+#define GPU_COMPRESSED_RGB_S3TC_DXT1 0x83F0
+#define GPU_COMPRESSED_RGBA_S3TC_DXT1 0x83F1
+#define GPU_COMPRESSED_RGBA_S3TC_DXT3 0x83F2
+#define GPU_COMPRESSED_RGBA_S3TC_DXT5 0x83F3
+#define GPU_COMPRESSED_SRGB_S3TC_DXT1 0x8C4C
+#define GPU_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 0x8C4F
+#define GPU_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GPU_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+
+size_t GpuMemory::Resource::bytes(){
+	size_t total = 0;
+	for (size_t i = 0; i < levels.size(); i ++)
+		total += levels[i];
+	return total;
+}
+
+//function statics so that globals in other files can register resources safely
+map<unsigned int, GpuMemory::Resource> &GpuMemory::buffers(){
+	static map<unsigned int, Resource> registry;
+	return registry;
+}
+
+map<unsigned int, GpuMemory::Resource> &GpuMemory::textures(){
+	static map<unsigned int, Resource> registry;
+	return registry;
+}
+
+map<unsigned int, GpuMemory::Resource> &GpuMemory::others(){
+	static map<unsigned int, Resource> registry;
+	return registry;
+}
+
+//-------------------------------buffers------------------------------------//
+
+unsigned int GpuMemory::genBuffer(GpuCategory category, const string &label){
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	Resource &resource = buffers()[buffer];
+	resource.category = category;
+	resource.label = label;
+	resource.format = 0;
+	resource.width = resource.height = 0;
+	resource.levels.assign(1, 0);
+	return buffer;
+}
+
+void GpuMemory::bufferData(GLenum target, unsigned int buffer, size_t size,
+	const void *data, GLenum usage){
+	glBufferData(target, size, data, usage);
+	map<unsigned int, Resource>::iterator it = buffers().find(buffer);
+	if (it != buffers().end())
+		it->second.levels[0] = size;
+}
+
+void GpuMemory::deleteBuffer(unsigned int buffer){
+	glDeleteBuffers(1, &buffer);
+	buffers().erase(buffer);
+}
+
+//-------------------------------textures-----------------------------------//
+
+size_t GpuMemory::levelBytes(GLint internalFormat, int width, int height){
+	size_t texels = (size_t)width * height;
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (internalFormat) {
+		case GL_RED: case GL_R8: case GL_R8I: case GL_R8UI: case GL_STENCIL_INDEX8:
+			return texels;
+		case GL_RG: case GL_RG8: case GL_R16F: case GL_R16: case GL_DEPTH_COMPONENT16:
+			return texels * 2;
+		//drivers pad 3 channel formats to 4
+		case GL_RGB: case GL_RGB8: case GL_SRGB8: case GL_RGBA: case GL_RGBA8:
+		case GL_SRGB8_ALPHA8: case GL_RG16F: case GL_R32F: case GL_R11F_G11F_B10F:
+		case GL_RGB10_A2: case GL_DEPTH_COMPONENT: case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F: case GL_DEPTH_STENCIL: case GL_DEPTH24_STENCIL8:
+			return texels * 4;
+		case GL_RGB16F: case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8:
+			return texels * 8;
+		case GL_RGB32F: case GL_RGBA32F:
+			return texels * 16;
+		case GPU_COMPRESSED_RGB_S3TC_DXT1: case GPU_COMPRESSED_RGBA_S3TC_DXT1:
+		case GPU_COMPRESSED_SRGB_S3TC_DXT1: case GL_COMPRESSED_RED_RGTC1:
+			return blocks * 8;
+		case GPU_COMPRESSED_RGBA_S3TC_DXT3: case GPU_COMPRESSED_RGBA_S3TC_DXT5:
+		case GPU_COMPRESSED_SRGB_ALPHA_S3TC_DXT5: case GPU_COMPRESSED_RGBA_BPTC_UNORM:
+		case GPU_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: case GL_COMPRESSED_RG_RGTC2:
+			return blocks * 16;
+		default:
+			return texels * 4;
+	}
+}
+
+unsigned int GpuMemory::genTexture(GpuCategory category, const string &label){
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	Resource &resource = textures()[texture];
+	resource.category = category;
+	resource.label = label;
+	resource.format = 0;
+	resource.width = resource.height = 0;
+	return texture;
+}
+
+void GpuMemory::texImage2D(GLenum target, unsigned int texture, int level,
+	GLint internalFormat, int width, int height, GLenum format, GLenum type,
+	const void *pixels){
+	glTexImage2D(target, level, internalFormat, width, height, 0, format, type, pixels);
+	trackLevel(texture, level, internalFormat, width, height,
+		levelBytes(internalFormat, width, height));
+}
+
+void GpuMemory::trackLevel(unsigned int texture, int level, GLint internalFormat,
+	int width, int height, size_t bytes){
+	map<unsigned int, Resource>::iterator it = textures().find(texture);
+	if (it == textures().end() || level < 0)
+		return;
+	Resource &resource = it->second;
+	if (resource.levels.size() <= (size_t)level)
+		resource.levels.resize(level + 1, 0);
+	resource.levels[level] = width > 0 && height > 0 ? bytes : 0;
+	//remember the full resolution size from the finest level that is defined,
+	//streamed textures may never define level 0
+	bool finest = true;
+	for (int i = 0; i < level; i ++)
+		finest &= resource.levels[i] == 0;
+	if (width > 0 && height > 0 && finest)
+	{
+		resource.format = internalFormat;
+		resource.width = width << level;
+		resource.height = height << level;
+	}
+}
+
+void GpuMemory::generateMipmap(GLenum target, unsigned int texture){
+	glGenerateMipmap(target);
+	map<unsigned int, Resource>::iterator it = textures().find(texture);
+	if (it == textures().end() || it->second.levels.empty())
+		return;
+	Resource &resource = it->second;
+	int width = resource.width, height = resource.height, level = 0;
+	while (width > 1 || height > 1) {
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+		level ++;
+		if (resource.levels.size() <= (size_t)level)
+			resource.levels.resize(level + 1, 0);
+		resource.levels[level] = levelBytes(resource.format, width, height);
+	}
+}
+
+void GpuMemory::deleteTexture(unsigned int texture){
+	glDeleteTextures(1, &texture);
+	textures().erase(texture);
+}
+
+//--------------------------------other-------------------------------------//
+
+void GpuMemory::trackOther(unsigned int name, GpuCategory category, const string &label,
+	size_t bytes){
+	Resource &resource = others()[name];
+	resource.category = category;
+	resource.label = label;
+	resource.format = 0;
+	resource.width = resource.height = 0;
+	resource.levels.assign(1, bytes);
+}
+
+void GpuMemory::untrackOther(unsigned int name){
+	others().erase(name);
+}
+
+//-------------------------------reporting----------------------------------//
+
+size_t GpuMemory::bufferBytes(unsigned int buffer){
+	map<unsigned int, Resource>::iterator it = buffers().find(buffer);
+	return it == buffers().end() ? 0 : it->second.bytes();
+}
+
+size_t GpuMemory::textureBytes(unsigned int texture){
+	map<unsigned int, Resource>::iterator it = textures().find(texture);
+	return it == textures().end() ? 0 : it->second.bytes();
+}
+
+size_t GpuMemory::totalBytes(GpuCategory category){
+	map<unsigned int, Resource> *registries[3] = {&buffers(), &textures(), &others()};
+	size_t total = 0;
+	for (int r = 0; r < 3; r ++)
+		for (map<unsigned int, Resource>::iterator it = registries[r]->begin();
+			it != registries[r]->end(); ++it)
+			if (category == GPU_CATEGORY_COUNT || it->second.category == category)
+				total += it->second.bytes();
+	return total;
+}
+
+static void printBytes(ostream &out, size_t bytes){
+	out << fixed << setprecision(2) << bytes / (1024.0 * 1024.0) << " MB";
+}
+
+void GpuMemory::report(ostream &out){
+	const char *kinds[3] = {"buffer", "texture", "other"};
+	map<unsigned int, Resource> *registries[3] = {&buffers(), &textures(), &others()};
+
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << "------------------------GPU memory report------------------------" << endl;
+	for (int r = 0; r < 3; r ++)
+		for (map<unsigned int, Resource>::iterator it = registries[r]->begin();
+			it != registries[r]->end(); ++it) {
+			Resource &resource = it->second;
+			out << "  " << kinds[r] << " " << it->first << " ["
+				<< CATEGORY_NAMES[resource.category] << "] " << resource.label;
+			if (r == 1)
+				out << " " << resource.width << "x" << resource.height << ", "
+					<< resource.levels.size() << " levels";
+			out << ": ";
+			printBytes(out, resource.bytes());
+			out << endl;
+		}
+	for (int c = 0; c < GPU_CATEGORY_COUNT; c ++) {
+		out << CATEGORY_NAMES[c] << ": ";
+		printBytes(out, totalBytes((GpuCategory)c));
+		out << endl;
+	}
+	out << "total tracked: ";
+	printBytes(out, totalBytes());
+	out << endl;
+
+	//the driver's own numbers, in KB
+	if (hasExtension("GL_NVX_gpu_memory_info"))
+	{
+		int dedicated = 0, available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		out << "driver (NVX): ";
+		printBytes(out, (size_t)(dedicated - available) * 1024);
+		out << " used of ";
+		printBytes(out, (size_t)dedicated * 1024);
+		out << endl;
+	}
+	else if (hasExtension("GL_ATI_meminfo"))
+	{
+		//each query returns total free, largest free block, aux free, largest aux block
+		int vbo[4] = {0}, texture[4] = {0}, renderbuffer[4] = {0};
+		glGetIntegerv(GL_VBO_FREE_MEMORY_ATI, vbo);
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, texture);
+		glGetIntegerv(GL_RENDERBUFFER_FREE_MEMORY_ATI, renderbuffer);
+		out << "driver (ATI) free: vbo ";
+		printBytes(out, (size_t)vbo[0] * 1024);
+		out << ", texture ";
+		printBytes(out, (size_t)texture[0] * 1024);
+		out << ", renderbuffer ";
+		printBytes(out, (size_t)renderbuffer[0] * 1024);
+		out << endl;
+	}
+	else
+		out << "driver memory info is not available" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
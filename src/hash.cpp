@@ -0,0 +1,86 @@
+//this file contains XXH64
+#include "../include/hash.h"
+
+#include <string.h>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r){
+	return (x << r) | (x >> (64 - r));
+}
+
+//little endian loads, memcpy compiles to a single unaligned load
+static inline uint64_t read64(const unsigned char *p){
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint32_t read32(const unsigned char *p){
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input){
+	acc += input * PRIME2;
+	acc = rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t xxMerge(uint64_t acc, uint64_t v){
+	acc ^= xxRound(0, v);
+	return acc * PRIME1 + PRIME4;
+}
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed){
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	uint64_t h;
+	if (size >= 32)
+	{
+		//4 independent lanes of 8 bytes keep the multipliers busy
+		uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+		const unsigned char *limit = end - 32;
+		do {
+			v1 = xxRound(v1, read64(p));
+			v2 = xxRound(v2, read64(p + 8));
+			v3 = xxRound(v3, read64(p + 16));
+			v4 = xxRound(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = xxMerge(h, v1);
+		h = xxMerge(h, v2);
+		h = xxMerge(h, v3);
+		h = xxMerge(h, v4);
+	}
+	else
+		h = seed + PRIME5;
+	h += size;
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxRound(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= read32(p) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; p ++) {
+		h ^= *p * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+	}
+	//avalanche
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
@@ -0,0 +1,383 @@
+//this file contains the event queue, the binding table and the mouse accumulator of the
+//input layer
+#include "../include/input.h"
+#include "../include/input_recorder.h"
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <string.h>
+
+//mouse buttons follow the keys in the binding table
+static const int BUTTON_BASE = GLFW_KEY_LAST + 1;
+static const int CODE_COUNT = BUTTON_BASE + GLFW_MOUSE_BUTTON_LAST + 1;
+
+struct InputState {
+	//single producer, single consumer ring. head is written by post() only and tail
+	//by update() only, they count events and are masked to index the ring
+	InputEvent queue[Input::QUEUE_SIZE];
+	atomic<size_t> head, tail;
+	atomic<size_t> events, dropped;
+
+	//everything below belongs to the thread that runs update()
+	vector<InputAction> bindings[CODE_COUNT];	//actions driven by each key and button
+	bool down[CODE_COUNT];
+	int held[ACTION_COUNT];	//inputs holding each action down
+	bool pressed[ACTION_COUNT], released[ACTION_COUNT];
+	float scroll_x, scroll_y;
+	size_t max_queued, updates;
+
+	//cursor accumulator, added to by moveCursor() and emptied by latchMouse()
+	atomic<double> mouse_x, mouse_y;
+	atomic<int> motion_events;
+	atomic<long long> first_motion;	//clock ticks of the oldest event, 0 for none
+	atomic<size_t> motion_total;
+	atomic<bool> cursor_valid;
+	double cursor_x, cursor_y;	//belong to the thread that calls moveCursor()
+
+	//belong to the thread that latches
+	size_t mouse_latches;
+	bool measure;
+	long long latched_motion;	//oldest event of the last latch, 0 once presented
+	double latched_age;
+	size_t latency_samples;
+	double latch_seconds, present_seconds, max_present_seconds;
+
+	InputState() : head(0), tail(0), events(0), dropped(0), scroll_x(0.0f), scroll_y(0.0f),
+		max_queued(0), updates(0), mouse_x(0.0), mouse_y(0.0), motion_events(0),
+		first_motion(0), motion_total(0), cursor_valid(false), cursor_x(0.0), cursor_y(0.0),
+		mouse_latches(0), measure(false), latched_motion(0), latched_age(0.0),
+		latency_samples(0), latch_seconds(0.0), present_seconds(0.0),
+		max_present_seconds(0.0) {
+		memset(down, 0, sizeof(down));
+		memset(held, 0, sizeof(held));
+		memset(pressed, 0, sizeof(pressed));
+		memset(released, 0, sizeof(released));
+	}
+};
+
+//function static so that the callbacks can't run before it exists
+static InputState &state(){
+	static InputState input;
+	return input;
+}
+
+//-------------------------------callbacks----------------------------------//
+
+static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods){
+	//repeats don't change what is held, keep them out of the queue
+	if (action == GLFW_REPEAT)
+		return;
+	InputEvent event = {INPUT_KEY, key, action, 0.0f, 0.0f};
+	Input::post(event);
+}
+
+static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods){
+	InputEvent event = {INPUT_MOUSE_BUTTON, button, action, 0.0f, 0.0f};
+	Input::post(event);
+}
+
+static void cursorPosCallback(GLFWwindow *window, double x, double y){
+	Input::moveCursor(x, y);
+}
+
+static void scrollCallback(GLFWwindow *window, double x, double y){
+	InputEvent event = {INPUT_SCROLL, 0, 0, (float)x, (float)y};
+	Input::post(event);
+}
+
+void Input::attach(GLFWwindow *window, bool captureCursor){
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetCursorPosCallback(window, cursorPosCallback);
+	glfwSetScrollCallback(window, scrollCallback);
+	//GLFW keeps the mode across focus changes, one call is enough
+	if (captureCursor)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	bindDefaults();
+}
+
+//-------------------------------bindings-----------------------------------//
+
+void Input::bindDefaults(){
+	bindKey(GLFW_KEY_ESCAPE, ACTION_QUIT);
+	bindKey(GLFW_KEY_UP, ACTION_MIX_UP);
+	bindKey(GLFW_KEY_DOWN, ACTION_MIX_DOWN);
+	bindKey(GLFW_KEY_M, ACTION_MEMORY_REPORT);
+	bindKey(GLFW_KEY_W, ACTION_FORWARD);
+	bindKey(GLFW_KEY_S, ACTION_BACKWARD);
+	bindKey(GLFW_KEY_A, ACTION_LEFT);
+	bindKey(GLFW_KEY_D, ACTION_RIGHT);
+	bindKey(GLFW_KEY_P, ACTION_DEPTH_PREPASS);
+}
+
+static void bindCode(int code, InputAction action){
+	if (code < 0 || code >= CODE_COUNT || action < 0 || action >= ACTION_COUNT)
+		return;
+	InputState &input = state();
+	input.bindings[code].push_back(action);
+	//the input may already be down, its release will let go of the action
+	if (input.down[code])
+		input.held[action] ++;
+}
+
+void Input::bindKey(int key, InputAction action){
+	if (key >= 0 && key < BUTTON_BASE)
+		bindCode(key, action);
+}
+
+void Input::bindMouseButton(int button, InputAction action){
+	if (button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST)
+		bindCode(BUTTON_BASE + button, action);
+}
+
+void Input::unbindAll(){
+	InputState &input = state();
+	for (int i = 0; i < CODE_COUNT; i ++)
+		input.bindings[i].clear();
+	memset(input.held, 0, sizeof(input.held));
+}
+
+//-------------------------------events-------------------------------------//
+
+bool Input::post(const InputEvent &event){
+	InputState &input = state();
+	size_t head = input.head.load(memory_order_relaxed);
+	if (head - input.tail.load(memory_order_acquire) >= QUEUE_SIZE)
+	{
+		input.dropped ++;
+		return false;
+	}
+	input.queue[head & (QUEUE_SIZE - 1)] = event;
+	//publish the event after it was written
+	input.head.store(head + 1, memory_order_release);
+	input.events ++;
+	return true;
+}
+
+//a key or button went up or down
+static void apply(InputState &input, int code, bool down){
+	if (code < 0 || code >= CODE_COUNT || input.down[code] == down)
+		return;
+	input.down[code] = down;
+	vector<InputAction> &actions = input.bindings[code];
+	for (size_t i = 0; i < actions.size(); i ++) {
+		int &held = input.held[actions[i]];
+		if (down)
+		{
+			if (held ++ == 0)
+				input.pressed[actions[i]] = true;
+		}
+		else if (held > 0 && -- held == 0)
+			input.released[actions[i]] = true;
+	}
+}
+
+//apply an event of the queue or of a replay
+static void applyEvent(InputState &input, const InputEvent &event){
+	switch (event.type) {
+		case INPUT_KEY:
+			if (event.action != GLFW_REPEAT)
+				apply(input, event.code, event.action == GLFW_PRESS);
+			break;
+		case INPUT_MOUSE_BUTTON:
+			if (event.code >= 0 && event.code <= GLFW_MOUSE_BUTTON_LAST)
+				apply(input, BUTTON_BASE + event.code, event.action == GLFW_PRESS);
+			break;
+		case INPUT_SCROLL:
+			input.scroll_x += event.x;
+			input.scroll_y += event.y;
+			break;
+	}
+}
+
+//whether an event presses a key or button bound to the action
+static bool pressesAction(InputState &input, const InputEvent &event, InputAction action){
+	if (event.action != GLFW_PRESS || event.type == INPUT_SCROLL)
+		return false;
+	int code = event.type == INPUT_KEY ? event.code : BUTTON_BASE + event.code;
+	if (code < 0 || code >= CODE_COUNT)
+		return false;
+	vector<InputAction> &actions = input.bindings[code];
+	return find(actions.begin(), actions.end(), action) != actions.end();
+}
+
+void Input::update(){
+	InputState &input = state();
+	memset(input.pressed, 0, sizeof(input.pressed));
+	memset(input.released, 0, sizeof(input.released));
+	input.scroll_x = input.scroll_y = 0.0f;
+
+	bool replaying = InputRecorder::mode() == RECORDER_REPLAYING;
+	bool quit = false;
+	size_t tail = input.tail.load(memory_order_relaxed);
+	size_t head = input.head.load(memory_order_acquire);
+	if (head - tail > input.max_queued)
+		input.max_queued = head - tail;
+	for (; tail != head; tail ++) {
+		const InputEvent &event = input.queue[tail & (QUEUE_SIZE - 1)];
+		//a replay drives the input, live events only get to quit it
+		if (replaying)
+			quit = quit || pressesAction(input, event, ACTION_QUIT);
+		else
+		{
+			applyEvent(input, event);
+			InputRecorder::recordEvent(event);
+		}
+	}
+	//hand the slots back to post() once the events were read
+	input.tail.store(tail, memory_order_release);
+	if (replaying)
+	{
+		vector<InputEvent> events = InputRecorder::replayEvents();
+		for (size_t i = 0; i < events.size(); i ++)
+			applyEvent(input, events[i]);
+		if (quit)
+			input.pressed[ACTION_QUIT] = true;
+	}
+	input.updates ++;
+}
+
+bool Input::held(InputAction action){
+	return action >= 0 && action < ACTION_COUNT && state().held[action] > 0;
+}
+
+bool Input::pressed(InputAction action){
+	return action >= 0 && action < ACTION_COUNT && state().pressed[action];
+}
+
+bool Input::released(InputAction action){
+	return action >= 0 && action < ACTION_COUNT && state().released[action];
+}
+
+float Input::scrollX(){
+	return state().scroll_x;
+}
+
+float Input::scrollY(){
+	return state().scroll_y;
+}
+
+//-------------------------------mouse--------------------------------------//
+
+static long long clockTicks(){
+	return (long long)chrono::steady_clock::now().time_since_epoch().count();
+}
+
+static double tickSeconds(long long ticks){
+	return chrono::duration<double>(chrono::steady_clock::duration(ticks)).count();
+}
+
+//atomic<double> has no fetch_add before C++20
+static void atomicAdd(atomic<double> &sum, double value){
+	double old = sum.load(memory_order_relaxed);
+	while (!sum.compare_exchange_weak(old, old + value, memory_order_relaxed))
+		;
+}
+
+void Input::moveCursor(double x, double y){
+	InputState &input = state();
+	if (!input.cursor_valid.exchange(true))
+	{
+		input.cursor_x = x;
+		input.cursor_y = y;
+		return;
+	}
+	double dx = x - input.cursor_x;
+	double dy = y - input.cursor_y;
+	input.cursor_x = x;
+	input.cursor_y = y;
+	addMouseDelta(dx, dy);
+}
+
+void Input::resetCursor(){
+	state().cursor_valid = false;
+}
+
+void Input::addMouseDelta(double x, double y){
+	InputState &input = state();
+	long long none = 0;
+	input.first_motion.compare_exchange_strong(none, clockTicks(), memory_order_relaxed);
+	atomicAdd(input.mouse_x, x);
+	atomicAdd(input.mouse_y, y);
+	input.motion_events.fetch_add(1, memory_order_release);
+	input.motion_total ++;
+}
+
+MouseDelta Input::latchMouse(){
+	InputState &input = state();
+	//movement added while we take the sums is either in them or in the next latch,
+	//it is never lost
+	long long first = input.first_motion.exchange(0, memory_order_relaxed);
+	MouseDelta delta;
+	delta.events = input.motion_events.exchange(0, memory_order_acquire);
+	delta.x = input.mouse_x.exchange(0.0, memory_order_relaxed);
+	delta.y = input.mouse_y.exchange(0.0, memory_order_relaxed);
+	delta.age = first != 0 ? tickSeconds(clockTicks() - first) : 0.0;
+	//a replay moves the camera the recorded way, the live movement is dropped
+	if (InputRecorder::mode() == RECORDER_REPLAYING)
+		InputRecorder::replayMouse(delta);
+	else
+		InputRecorder::recordMouse(delta);
+	if (delta.events > 0)
+	{
+		input.mouse_latches ++;
+		input.latched_motion = first;
+		input.latched_age = delta.age;
+	}
+	return delta;
+}
+
+void Input::measureLatency(bool enable){
+	state().measure = enable;
+}
+
+void Input::presented(){
+	InputState &input = state();
+	if (!input.measure || input.latched_motion == 0)
+		return;
+	double seconds = tickSeconds(clockTicks() - input.latched_motion);
+	input.latched_motion = 0;
+	input.latency_samples ++;
+	input.latch_seconds += input.latched_age;
+	input.present_seconds += seconds;
+	input.max_present_seconds = max(input.max_present_seconds, seconds);
+}
+
+InputStats Input::stats(){
+	InputState &input = state();
+	InputStats stats;
+	stats.events = input.events;
+	stats.dropped = input.dropped;
+	stats.maxQueued = input.max_queued;
+	stats.updates = input.updates;
+	stats.motionEvents = input.motion_total;
+	stats.mouseLatches = input.mouse_latches;
+	stats.latencySamples = input.latency_samples;
+	stats.latchSeconds = input.latch_seconds;
+	stats.presentSeconds = input.present_seconds;
+	stats.maxPresentSeconds = input.max_present_seconds;
+	return stats;
+}
+
+void Input::report(ostream &out){
+	InputStats stats = Input::stats();
+	out << "input: " << stats.events << " events in " << stats.updates << " updates, at most "
+		<< stats.maxQueued << " per update, " << stats.dropped << " dropped, "
+		<< stats.motionEvents << " mouse moves applied in " << stats.mouseLatches
+		<< " camera updates" << endl;
+	if (stats.latencySamples > 0)
+	{
+		ios::fmtflags flags = out.flags();
+		streamsize precision = out.precision();
+		double samples = (double)stats.latencySamples;
+		out << fixed << setprecision(2) << "input latency: " << stats.latencySamples
+			<< " frames, mouse to latch " << stats.latchSeconds / samples * 1000.0
+			<< " ms, mouse to present " << stats.presentSeconds / samples * 1000.0
+			<< " ms, at most " << stats.maxPresentSeconds * 1000.0 << " ms" << endl;
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
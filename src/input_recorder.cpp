@@ -0,0 +1,281 @@
+//this file contains the input recorder and the replay
+#include "../include/input_recorder.h"
+
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+
+struct RecordedFrame {
+	float delta;
+	bool mouse;
+	float mouse_x, mouse_y;
+	vector<InputEvent> events;
+};
+
+struct RecorderState {
+	RecorderMode mode;
+	string path;
+	vector<RecordedFrame> frames;
+	size_t next;	//replay: frame that the next frame() starts
+	bool events_taken, mouse_taken;	//replay: the current frame was handed out
+	float fixed_delta;
+	vector<float> frame_times;
+	RecorderState() : mode(RECORDER_OFF), next(0), events_taken(true), mouse_taken(true),
+		fixed_delta(0.0f) {}
+};
+
+//belongs to the thread that runs the frame loop
+static RecorderState &state(){
+	static RecorderState recorder;
+	return recorder;
+}
+
+//---------------------------------file-------------------------------------//
+
+template <class T>
+static void put(vector<unsigned char> &out, T value){
+	size_t at = out.size();
+	out.resize(at + sizeof(T));
+	memcpy(&out[at], &value, sizeof(T));
+}
+
+template <class T>
+static bool get(const vector<unsigned char> &in, size_t &at, T &value){
+	if (in.size() - at < sizeof(T))
+		return false;
+	memcpy(&value, &in[at], sizeof(T));
+	at += sizeof(T);
+	return true;
+}
+
+static bool writeRecording(const string &path, const vector<RecordedFrame> &frames){
+	vector<unsigned char> out;
+	RecordingHeader header;
+	memcpy(header.magic, RECORDING_MAGIC, 4);
+	header.version = RECORDING_VERSION;
+	header.frames = (uint32_t)frames.size();
+	out.resize(sizeof(header));
+	memcpy(&out[0], &header, sizeof(header));
+	for (size_t f = 0; f < frames.size(); f ++) {
+		const RecordedFrame &frame = frames[f];
+		//a frame has a handful of events, more than fit are dropped
+		size_t count = min(frame.events.size(), (size_t)UINT16_MAX);
+		put(out, frame.delta);
+		put(out, (uint8_t)(frame.mouse ? RECORD_MOUSE : 0));
+		put(out, (uint16_t)count);
+		if (frame.mouse)
+		{
+			put(out, frame.mouse_x);
+			put(out, frame.mouse_y);
+		}
+		for (size_t e = 0; e < count; e ++) {
+			const InputEvent &event = frame.events[e];
+			put(out, (uint8_t)event.type);
+			put(out, (uint8_t)event.action);
+			put(out, (int16_t)event.code);
+			if (event.type == INPUT_SCROLL)
+			{
+				put(out, event.x);
+				put(out, event.y);
+			}
+		}
+	}
+	ofstream file(path.c_str(), ios::binary | ios::trunc);
+	file.write((const char *)&out[0], out.size());
+	return file.good();
+}
+
+static bool readRecording(const char *path, vector<RecordedFrame> &frames){
+	ifstream file(path, ios::binary);
+	if (!file)
+		return false;
+	vector<unsigned char> in((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	RecordingHeader header;
+	size_t at = 0;
+	if (!get(in, at, header) || memcmp(header.magic, RECORDING_MAGIC, 4) != 0 ||
+		header.version != RECORDING_VERSION)
+		return false;
+	frames.clear();
+	for (uint32_t f = 0; f < header.frames; f ++) {
+		RecordedFrame frame;
+		uint8_t flags;
+		uint16_t count;
+		if (!get(in, at, frame.delta) || !get(in, at, flags) || !get(in, at, count))
+			return false;
+		frame.mouse = (flags & RECORD_MOUSE) != 0;
+		frame.mouse_x = frame.mouse_y = 0.0f;
+		if (frame.mouse && (!get(in, at, frame.mouse_x) || !get(in, at, frame.mouse_y)))
+			return false;
+		for (uint16_t e = 0; e < count; e ++) {
+			uint8_t type, action;
+			int16_t code;
+			if (!get(in, at, type) || !get(in, at, action) || !get(in, at, code) ||
+				type > INPUT_SCROLL)
+				return false;
+			InputEvent event = {(InputEventType)type, code, action, 0.0f, 0.0f};
+			if (event.type == INPUT_SCROLL && (!get(in, at, event.x) || !get(in, at, event.y)))
+				return false;
+			frame.events.push_back(event);
+		}
+		frames.push_back(frame);
+	}
+	return true;
+}
+
+//-------------------------------recording----------------------------------//
+
+void InputRecorder::record(const char *path){
+	RecorderState &recorder = state();
+	recorder.mode = RECORDER_RECORDING;
+	recorder.path = path;
+	recorder.frames.clear();
+	recorder.frame_times.clear();
+}
+
+bool InputRecorder::replay(const char *path, float fixedDelta){
+	RecorderState &recorder = state();
+	vector<RecordedFrame> frames;
+	if (!readRecording(path, frames))
+	{
+		cout << "ERROR::INPUT_RECORDER::INVALID_RECORDING: " << path << endl;
+		return false;
+	}
+	recorder.mode = RECORDER_REPLAYING;
+	recorder.path = path;
+	recorder.frames.swap(frames);
+	recorder.next = 0;
+	recorder.events_taken = recorder.mouse_taken = true;
+	recorder.fixed_delta = fixedDelta;
+	recorder.frame_times.clear();
+	return true;
+}
+
+bool InputRecorder::stop(){
+	RecorderState &recorder = state();
+	bool written = true;
+	if (recorder.mode == RECORDER_RECORDING)
+	{
+		written = writeRecording(recorder.path, recorder.frames);
+		if (written)
+			cout << "recorded " << recorder.frames.size() << " frames to " << recorder.path << endl;
+		else
+			cout << "ERROR::INPUT_RECORDER::WRITE_FAILED: " << recorder.path << endl;
+	}
+	recorder.mode = RECORDER_OFF;
+	return written;
+}
+
+RecorderMode InputRecorder::mode(){
+	return state().mode;
+}
+
+bool InputRecorder::frame(float &delta_time){
+	RecorderState &recorder = state();
+	if (recorder.mode == RECORDER_OFF)
+		return true;
+	//the time between two calls is the real frame time, the first one has none
+	if (recorder.mode == RECORDER_RECORDING ? !recorder.frames.empty() : recorder.next > 0)
+		recorder.frame_times.push_back(delta_time);
+	if (recorder.mode == RECORDER_RECORDING)
+	{
+		RecordedFrame frame;
+		frame.delta = delta_time;
+		frame.mouse = false;
+		frame.mouse_x = frame.mouse_y = 0.0f;
+		recorder.frames.push_back(frame);
+		return true;
+	}
+	if (recorder.next >= recorder.frames.size())
+		return false;
+	const RecordedFrame &frame = recorder.frames[recorder.next ++];
+	delta_time = recorder.fixed_delta > 0.0f ? recorder.fixed_delta : frame.delta;
+	recorder.events_taken = recorder.mouse_taken = false;
+	return true;
+}
+
+void InputRecorder::recordEvent(const InputEvent &event){
+	RecorderState &recorder = state();
+	if (recorder.mode == RECORDER_RECORDING && !recorder.frames.empty())
+		recorder.frames.back().events.push_back(event);
+}
+
+void InputRecorder::recordMouse(const MouseDelta &delta){
+	RecorderState &recorder = state();
+	if (recorder.mode != RECORDER_RECORDING || recorder.frames.empty() || delta.events == 0)
+		return;
+	//the camera takes floats, so does the recording
+	RecordedFrame &frame = recorder.frames.back();
+	frame.mouse_x = frame.mouse ? (float)(frame.mouse_x + delta.x) : (float)delta.x;
+	frame.mouse_y = frame.mouse ? (float)(frame.mouse_y + delta.y) : (float)delta.y;
+	frame.mouse = true;
+}
+
+vector<InputEvent> InputRecorder::replayEvents(){
+	RecorderState &recorder = state();
+	if (recorder.mode != RECORDER_REPLAYING || recorder.events_taken || recorder.next == 0)
+		return vector<InputEvent>();
+	recorder.events_taken = true;
+	return recorder.frames[recorder.next - 1].events;
+}
+
+bool InputRecorder::replayMouse(MouseDelta &delta){
+	RecorderState &recorder = state();
+	delta.x = delta.y = 0.0;
+	delta.events = 0;
+	delta.age = 0.0;
+	if (recorder.mode != RECORDER_REPLAYING || recorder.mouse_taken || recorder.next == 0)
+		return false;
+	recorder.mouse_taken = true;
+	const RecordedFrame &frame = recorder.frames[recorder.next - 1];
+	if (!frame.mouse)
+		return false;
+	delta.x = frame.mouse_x;
+	delta.y = frame.mouse_y;
+	delta.events = 1;
+	return true;
+}
+
+//-------------------------------frame times--------------------------------//
+
+FrameTimeStats InputRecorder::frameTimes(){
+	vector<float> times = state().frame_times;
+	FrameTimeStats stats = {times.size(), 0.0, 0.0, 0.0, 0.0, 0.0};
+	if (times.empty())
+		return stats;
+	sort(times.begin(), times.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < times.size(); i ++)
+		sum += times[i];
+	stats.mean = sum / times.size();
+	//nearest rank
+	stats.p50 = times[(times.size() - 1) * 50 / 100];
+	stats.p90 = times[(times.size() - 1) * 90 / 100];
+	stats.p99 = times[(times.size() - 1) * 99 / 100];
+	stats.max = times.back();
+	return stats;
+}
+
+void InputRecorder::report(ostream &out){
+	FrameTimeStats stats = frameTimes();
+	if (stats.frames == 0)
+		return;
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(2) << "frame times: " << stats.frames << " frames, mean "
+		<< stats.mean * 1000.0 << " ms, p50 " << stats.p50 * 1000.0 << " ms, p90 "
+		<< stats.p90 * 1000.0 << " ms, p99 " << stats.p99 * 1000.0 << " ms, max "
+		<< stats.max * 1000.0 << " ms" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool InputRecorder::writeFrameTimes(const char *path){
+	const vector<float> &times = state().frame_times;
+	ofstream file(path, ios::trunc);
+	file << fixed << setprecision(4);
+	for (size_t i = 0; i < times.size(); i ++)
+		file << times[i] * 1000.0 << "\n";
+	return file.good();
+}
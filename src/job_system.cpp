@@ -0,0 +1,540 @@
+//this file contains the work-stealing job system
+#include "../include/job_system.h"
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <iomanip>
+
+//failed searches before an idle worker sleeps
+static const int IDLE_SPINS = 64;
+//parallelFor chunks per thread when the caller doesn't pick a grain
+static const size_t CHUNKS_PER_THREAD = 64;
+//freed jobs a thread keeps for reuse
+static const size_t FREE_JOBS = 1024;
+
+struct Job {
+	JobFunction function;
+	RangeFunction range;	//set for parallelFor chunks instead of function
+	void *data;
+	size_t begin, end, grain;
+	JobCounter *counter;
+	JobCounter *after;
+};
+
+//counters of a worker, read by stats() on any thread
+struct WorkerStats {
+	atomic<size_t> jobs, steals, failed_steals, splits, sleeps;
+	WorkerStats() : jobs(0), steals(0), failed_steals(0), splits(0), sleeps(0) {}
+};
+
+static inline void bump(atomic<size_t> &counter){
+	counter.fetch_add(1, memory_order_relaxed);
+}
+
+//-------------------------------deque--------------------------------------//
+
+//a power of two ring of job pointers, indices grow forever and wrap around it
+struct JobRing {
+	int64_t size;
+	atomic<Job *> *slots;
+	explicit JobRing(int64_t size) : size(size), slots(new atomic<Job *>[size]) {}
+	~JobRing() { delete [] slots; }
+	Job *get(int64_t i) const { return slots[i & (size - 1)].load(memory_order_relaxed); }
+	void put(int64_t i, Job *job) { slots[i & (size - 1)].store(job, memory_order_relaxed); }
+};
+
+//the owner pushes and takes at the bottom, any thread steals at the top
+struct JobDeque {
+	atomic<int64_t> top;
+	char pad_top[64];	//thieves write top, the owner bottom
+	atomic<int64_t> bottom;
+	char pad_bottom[64];
+	atomic<JobRing *> ring;
+	//outgrown rings, a thief may still read one, freed with the deque
+	vector<JobRing *> retired;
+
+	JobDeque() : top(0), bottom(0), ring(new JobRing(256)) {}
+	~JobDeque() {
+		delete ring.load(memory_order_relaxed);
+		for (size_t i = 0; i < retired.size(); i ++)
+			delete retired[i];
+	}
+
+	void push(Job *job){
+		int64_t b = bottom.load(memory_order_relaxed);
+		int64_t t = top.load(memory_order_acquire);
+		JobRing *r = ring.load(memory_order_relaxed);
+		if (b - t > r->size - 1)
+		{
+			JobRing *grown = new JobRing(r->size * 2);
+			for (int64_t i = t; i < b; i ++)
+				grown->put(i, r->get(i));
+			retired.push_back(r);
+			ring.store(grown, memory_order_release);
+			r = grown;
+		}
+		r->put(b, job);
+		//a release store instead of the paper's fence, the same on x86 and visible
+		//to race detectors
+		bottom.store(b + 1, memory_order_release);
+	}
+
+	//POST:
+	//	return NULL if the deque is empty
+	Job *take(){
+		int64_t b = bottom.load(memory_order_relaxed) - 1;
+		JobRing *r = ring.load(memory_order_relaxed);
+		bottom.store(b, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		int64_t t = top.load(memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, memory_order_relaxed);
+			return NULL;
+		}
+		Job *job = r->get(b);
+		//the last job, a thief may be taking it too
+		if (t == b)
+		{
+			if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst,
+				memory_order_relaxed))
+				job = NULL;
+			bottom.store(b + 1, memory_order_relaxed);
+		}
+		return job;
+	}
+
+	//POST:
+	//	return NULL if the deque is empty or another thread took the job first
+	Job *steal(){
+		int64_t t = top.load(memory_order_acquire);
+		atomic_thread_fence(memory_order_seq_cst);
+		int64_t b = bottom.load(memory_order_acquire);
+		if (t >= b)
+			return NULL;
+		JobRing *r = ring.load(memory_order_acquire);
+		Job *job = r->get(t);
+		if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+			return NULL;
+		return job;
+	}
+
+	bool empty() const {
+		return bottom.load(memory_order_relaxed) <= top.load(memory_order_relaxed);
+	}
+};
+
+//-------------------------------state--------------------------------------//
+
+struct Worker {
+	JobDeque deque;
+	WorkerStats stats;
+	thread os_thread;
+};
+
+struct JobState {
+	bool running;
+	vector<Worker *> workers;	//worker 0 is the thread that called init()
+	atomic<bool> quit;
+	//jobs queued by threads outside the pool
+	mutex injected_lock;
+	deque<Job *> injected;
+	atomic<size_t> injected_count;
+	//jobs waiting for their after counter
+	mutex blocked_lock;
+	vector<Job *> blocked;
+	atomic<size_t> blocked_count;
+	//idle workers sleep until the epoch changes
+	mutex sleep_lock;
+	condition_variable wake;
+	atomic<int> sleeping;
+	uint64_t epoch;
+	WorkerStats outside;	//counters of threads outside the pool
+	JobState() : running(false), quit(false), injected_count(0), blocked_count(0),
+		sleeping(0), epoch(0) {}
+};
+
+static JobState &state(){
+	static JobState jobs;
+	return jobs;
+}
+
+//index of the calling thread in the pool, -1 outside of it
+static thread_local int worker_index = -1;
+
+static WorkerStats &statsOf(JobState &jobs, int index){
+	return index >= 0 ? jobs.workers[index]->stats : jobs.outside;
+}
+
+//jobs freed on a thread are reused by the next ones it queues
+struct JobFreeList {
+	vector<Job *> jobs;
+	~JobFreeList() {
+		for (size_t i = 0; i < jobs.size(); i ++)
+			delete jobs[i];
+	}
+};
+static thread_local JobFreeList free_jobs;
+
+static Job *allocJob(){
+	if (free_jobs.jobs.empty())
+		return new Job();
+	Job *job = free_jobs.jobs.back();
+	free_jobs.jobs.pop_back();
+	return job;
+}
+
+static void freeJob(Job *job){
+	if (free_jobs.jobs.size() < FREE_JOBS)
+		free_jobs.jobs.push_back(job);
+	else
+		delete job;
+}
+
+//-------------------------------queueing-----------------------------------//
+
+static void wakeWorker(JobState &jobs){
+	//pairs with the fence of a worker going to sleep, either it sees the job or this
+	//sees it sleeping
+	atomic_thread_fence(memory_order_seq_cst);
+	if (jobs.sleeping.load(memory_order_relaxed) > 0)
+	{
+		lock_guard<mutex> lock(jobs.sleep_lock);
+		jobs.epoch ++;
+		jobs.wake.notify_one();
+	}
+}
+
+static void push(JobState &jobs, Job *job){
+	if (worker_index >= 0)
+		jobs.workers[worker_index]->deque.push(job);
+	else
+	{
+		lock_guard<mutex> lock(jobs.injected_lock);
+		jobs.injected.push_back(job);
+		jobs.injected_count.fetch_add(1, memory_order_seq_cst);
+	}
+	wakeWorker(jobs);
+}
+
+//queue the jobs that waited for counter, it just dropped to 0
+static void releaseBlocked(JobState &jobs, JobCounter *counter){
+	vector<Job *> ready;
+	{
+		lock_guard<mutex> lock(jobs.blocked_lock);
+		//only jobs still waiting dereference the counter, so it is alive
+		for (size_t i = 0; i < jobs.blocked.size();) {
+			Job *job = jobs.blocked[i];
+			if (job->after == counter && counter->done())
+			{
+				ready.push_back(job);
+				jobs.blocked[i] = jobs.blocked.back();
+				jobs.blocked.pop_back();
+				jobs.blocked_count.fetch_sub(1, memory_order_seq_cst);
+			}
+			else
+				i ++;
+		}
+	}
+	for (size_t i = 0; i < ready.size(); i ++)
+		push(jobs, ready[i]);
+}
+
+static void finish(JobState &jobs, JobCounter *counter){
+	//the waiter may destroy the counter once it is 0, it isn't touched after this
+	if (counter != NULL && counter->add(-1) == 1 &&
+		jobs.blocked_count.load(memory_order_seq_cst) > 0)
+		releaseBlocked(jobs, counter);
+}
+
+//a job from the own deque, the shared queue or another worker
+static Job *find(JobState &jobs, int self){
+	Job *job = NULL;
+	if (self >= 0 && (job = jobs.workers[self]->deque.take()) != NULL)
+		return job;
+	if (jobs.injected_count.load(memory_order_seq_cst) > 0)
+	{
+		lock_guard<mutex> lock(jobs.injected_lock);
+		if (!jobs.injected.empty())
+		{
+			job = jobs.injected.front();
+			jobs.injected.pop_front();
+			jobs.injected_count.fetch_sub(1, memory_order_relaxed);
+			return job;
+		}
+	}
+	//xorshift, victims are tried in order from a random one
+	static thread_local uint32_t seed = 0x9E3779B9u ^ (uint32_t)(size_t)&seed;
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	int count = (int)jobs.workers.size();
+	WorkerStats &stats = statsOf(jobs, self);
+	for (int i = 0, start = (int)(seed % count); i < count; i ++) {
+		int victim = (start + i) % count;
+		if (victim == self)
+			continue;
+		if ((job = jobs.workers[victim]->deque.steal()) != NULL)
+		{
+			bump(stats.steals);
+			return job;
+		}
+		bump(stats.failed_steals);
+	}
+	return NULL;
+}
+
+//run the chunks of a parallelFor job, handing half of the rest to a new job whenever
+//the own deque is empty, ie. other workers stole everything they could
+static void runRange(JobState &jobs, Job &job){
+	size_t begin = job.begin, end = job.end;
+	int self = worker_index;
+	while (begin < end) {
+		bool dry = self >= 0 ? jobs.workers[self]->deque.empty() :
+			jobs.injected_count.load(memory_order_relaxed) == 0;
+		if (end - begin >= 2 * job.grain && dry)
+		{
+			size_t middle = begin + (end - begin) / 2;
+			Job *half = allocJob();
+			*half = job;
+			half->begin = middle;
+			half->end = end;
+			half->counter->add(1);
+			push(jobs, half);
+			bump(statsOf(jobs, self).splits);
+			end = middle;
+		}
+		size_t stop = min(end, begin + job.grain);
+		job.range(job.data, begin, stop);
+		begin = stop;
+	}
+}
+
+static void execute(JobState &jobs, Job *job){
+	if (job->range != NULL)
+		runRange(jobs, *job);
+	else
+		job->function(job->data);
+	JobCounter *counter = job->counter;
+	freeJob(job);
+	bump(statsOf(jobs, worker_index).jobs);
+	finish(jobs, counter);
+}
+
+//-------------------------------workers------------------------------------//
+
+static void workerLoop(int index){
+	JobState &jobs = state();
+	worker_index = index;
+	WorkerStats &stats = jobs.workers[index]->stats;
+	int idle = 0;
+	while (true) {
+		Job *job = find(jobs, index);
+		if (job != NULL)
+		{
+			execute(jobs, job);
+			idle = 0;
+			continue;
+		}
+		if (jobs.quit.load(memory_order_acquire))
+			break;
+		if (++ idle < IDLE_SPINS)
+		{
+			this_thread::yield();
+			continue;
+		}
+		//announce the sleep, then look once more, see wakeWorker()
+		uint64_t seen;
+		{
+			lock_guard<mutex> lock(jobs.sleep_lock);
+			seen = jobs.epoch;
+			jobs.sleeping.fetch_add(1, memory_order_seq_cst);
+		}
+		if ((job = find(jobs, index)) != NULL)
+		{
+			jobs.sleeping.fetch_sub(1, memory_order_relaxed);
+			execute(jobs, job);
+			idle = 0;
+			continue;
+		}
+		bump(stats.sleeps);
+		unique_lock<mutex> lock(jobs.sleep_lock);
+		while (jobs.epoch == seen && !jobs.quit.load(memory_order_acquire))
+			jobs.wake.wait(lock);
+		jobs.sleeping.fetch_sub(1, memory_order_relaxed);
+		idle = 0;
+	}
+	worker_index = -1;
+}
+
+void JobSystem::init(int threads){
+	JobState &jobs = state();
+	if (jobs.running)
+		return;
+	if (threads <= 0)
+		threads = max(1u, thread::hardware_concurrency());
+	jobs.quit = false;
+	jobs.outside.jobs = jobs.outside.steals = jobs.outside.failed_steals = 0;
+	jobs.outside.splits = jobs.outside.sleeps = 0;
+	for (int i = 0; i < threads; i ++)
+		jobs.workers.push_back(new Worker());
+	jobs.running = true;
+	worker_index = 0;
+	for (int i = 1; i < threads; i ++)
+		jobs.workers[i]->os_thread = thread(workerLoop, i);
+}
+
+void JobSystem::shutdown(){
+	JobState &jobs = state();
+	if (!jobs.running)
+		return;
+	//what is still queued runs here and on the workers before they stop
+	while (Job *job = find(jobs, worker_index))
+		execute(jobs, job);
+	{
+		lock_guard<mutex> lock(jobs.sleep_lock);
+		jobs.quit = true;
+		jobs.epoch ++;
+		jobs.wake.notify_all();
+	}
+	for (size_t i = 1; i < jobs.workers.size(); i ++)
+		jobs.workers[i]->os_thread.join();
+	for (size_t i = 0; i < jobs.workers.size(); i ++)
+		delete jobs.workers[i];
+	jobs.workers.clear();
+	//jobs whose counter never finished can't run anymore
+	if (!jobs.blocked.empty())
+		cout << "ERROR::JOB_SYSTEM::BLOCKED_JOBS_DROPPED: " << jobs.blocked.size() << endl;
+	for (size_t i = 0; i < jobs.blocked.size(); i ++)
+		delete jobs.blocked[i];
+	jobs.blocked.clear();
+	jobs.blocked_count = 0;
+	jobs.running = false;
+	worker_index = -1;
+}
+
+bool JobSystem::running(){
+	return state().running;
+}
+
+int JobSystem::threads(){
+	JobState &jobs = state();
+	return jobs.running ? (int)jobs.workers.size() : 1;
+}
+
+//-------------------------------jobs---------------------------------------//
+
+void JobSystem::run(JobFunction function, void *data, JobCounter *counter, JobCounter *after){
+	JobState &jobs = state();
+	if (!jobs.running)
+	{
+		//everything before ran right away too, after is done already
+		function(data);
+		return;
+	}
+	Job *job = allocJob();
+	job->function = function;
+	job->range = NULL;
+	job->data = data;
+	job->counter = counter;
+	job->after = after;
+	if (counter != NULL)
+		counter->add(1);
+	if (after != NULL)
+	{
+		lock_guard<mutex> lock(jobs.blocked_lock);
+		//counted before the check, so a finish() that misses the job sees the count
+		jobs.blocked_count.fetch_add(1, memory_order_seq_cst);
+		if (after->pending() != 0)
+		{
+			jobs.blocked.push_back(job);
+			return;
+		}
+		jobs.blocked_count.fetch_sub(1, memory_order_seq_cst);
+	}
+	push(jobs, job);
+}
+
+void JobSystem::wait(JobCounter &counter){
+	JobState &jobs = state();
+	while (!counter.done()) {
+		Job *job = jobs.running ? find(jobs, worker_index) : NULL;
+		if (job != NULL)
+			execute(jobs, job);
+		else
+			this_thread::yield();
+	}
+}
+
+bool JobSystem::runOne(){
+	JobState &jobs = state();
+	Job *job = jobs.running ? find(jobs, worker_index) : NULL;
+	if (job == NULL)
+		return false;
+	execute(jobs, job);
+	return true;
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, RangeFunction function, void *data,
+	size_t grain){
+	if (begin >= end)
+		return;
+	JobState &jobs = state();
+	if (grain == 0)
+		grain = max((size_t)1, (end - begin) / (threads() * CHUNKS_PER_THREAD));
+	if (!jobs.running || jobs.workers.size() == 1 || end - begin < 2 * grain)
+	{
+		function(data, begin, end);
+		return;
+	}
+	//the caller runs the whole range, idle workers steal the halves it hands out
+	JobCounter counter;
+	counter.add(1);
+	Job *job = allocJob();
+	job->function = NULL;
+	job->range = function;
+	job->data = data;
+	job->begin = begin;
+	job->end = end;
+	job->grain = grain;
+	job->counter = &counter;
+	job->after = NULL;
+	execute(jobs, job);
+	wait(counter);
+}
+
+//-------------------------------reporting----------------------------------//
+
+JobStats JobSystem::stats(){
+	JobState &jobs = state();
+	JobStats total = {0, 0, 0, 0, 0};
+	for (size_t i = 0; i <= jobs.workers.size(); i ++) {
+		const WorkerStats &stats = i < jobs.workers.size() ? jobs.workers[i]->stats :
+			jobs.outside;
+		total.jobs += stats.jobs.load(memory_order_relaxed);
+		total.steals += stats.steals.load(memory_order_relaxed);
+		total.failedSteals += stats.failed_steals.load(memory_order_relaxed);
+		total.splits += stats.splits.load(memory_order_relaxed);
+		total.sleeps += stats.sleeps.load(memory_order_relaxed);
+	}
+	return total;
+}
+
+void JobSystem::report(ostream &out){
+	JobStats total = stats();
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1) << "jobs: " << threads() << " threads, " << total.jobs
+		<< " jobs run, " << total.steals << " stolen ("
+		<< (total.steals + total.failedSteals > 0 ?
+			100.0 * total.steals / (total.steals + total.failedSteals) : 0.0)
+		<< "% of steals succeeded), " << total.splits << " ranges split, " << total.sleeps
+		<< " sleeps" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
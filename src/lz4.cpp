@@ -0,0 +1,177 @@
+//this file contains the LZ4 block codec
+#include "../include/lz4.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+static const int HASH_BITS = 14;
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+//the format ends every block with at least 5 literals, and the last match starts at
+//least 12 bytes before the end
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+//after this many positions without a match the search skips ahead faster
+static const int SKIP_TRIGGER = 6;
+
+static inline uint32_t read32(const unsigned char *p){
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint32_t hashPosition(const unsigned char *p){
+	return (read32(p) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+//write a count of 15 or more as 255 bytes and a remainder
+static inline unsigned char *writeLength(unsigned char *op, size_t length){
+	for (; length >= 255; length -= 255)
+		*op ++ = 255;
+	*op ++ = (unsigned char)length;
+	return op;
+}
+
+size_t Lz4::compressBound(size_t size){
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::compress(const unsigned char *src, size_t size, unsigned char *dst,
+	size_t capacity){
+	const unsigned char *ip = src, *anchor = src, *end = src + size;
+	unsigned char *op = dst, *oend = dst + capacity;
+	if (size > MATCH_LIMIT)
+	{
+		const unsigned char *match_start_limit = end - MATCH_LIMIT;
+		const unsigned char *match_end_limit = end - LAST_LITERALS;
+		//positions + 1, 0 is an empty slot
+		vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+		int misses = 0;
+		while (ip <= match_start_limit) {
+			uint32_t h = hashPosition(ip);
+			uint32_t slot = table[h];
+			const unsigned char *ref = src + (slot ? slot - 1 : 0);
+			bool found = slot != 0 && (size_t)(ip - ref) <= MAX_OFFSET &&
+				read32(ref) == read32(ip);
+			table[h] = (uint32_t)(ip - src) + 1;
+			if (!found)
+			{
+				ip += 1 + (misses ++ >> SKIP_TRIGGER);
+				continue;
+			}
+			misses = 0;
+			//extend the match backwards over literals and then forwards
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				ip --;
+				ref --;
+			}
+			const unsigned char *match_end = ip + MIN_MATCH;
+			const unsigned char *r = ref + MIN_MATCH;
+			while (match_end < match_end_limit && *match_end == *r) {
+				match_end ++;
+				r ++;
+			}
+
+			size_t literals = ip - anchor;
+			size_t length = match_end - ip - MIN_MATCH;
+			//token, literals and their length bytes, offset, match length bytes
+			if ((size_t)(oend - op) < 1 + literals + literals / 255 + 1 + 2 + length / 255 + 1)
+				return 0;
+			unsigned char *token = op ++;
+			*token = (unsigned char)((literals < 15 ? literals : 15) << 4);
+			if (literals >= 15)
+				op = writeLength(op, literals - 15);
+			memcpy(op, anchor, literals);
+			op += literals;
+			size_t offset = ip - ref;
+			*op ++ = (unsigned char)offset;
+			*op ++ = (unsigned char)(offset >> 8);
+			*token |= (unsigned char)(length < 15 ? length : 15);
+			if (length >= 15)
+				op = writeLength(op, length - 15);
+
+			//positions inside the match are only partly indexed, like the reference
+			//implementation's fast mode
+			if (match_end - 2 > ip)
+				table[hashPosition(match_end - 2)] = (uint32_t)(match_end - 2 - src) + 1;
+			ip = anchor = match_end;
+		}
+	}
+	size_t literals = end - anchor;
+	if ((size_t)(oend - op) < 1 + literals + literals / 255 + 1)
+		return 0;
+	*op ++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+		op = writeLength(op, literals - 15);
+	if (literals > 0)
+		memcpy(op, anchor, literals);
+	op += literals;
+	return op - dst;
+}
+
+//read the extra bytes of a count of 15, false if the block ends first
+static inline bool readLength(const unsigned char *&ip, const unsigned char *iend,
+	size_t &length){
+	unsigned char b;
+	do {
+		if (ip >= iend)
+			return false;
+		b = *ip ++;
+		length += b;
+	} while (b == 255);
+	return true;
+}
+
+bool Lz4::decompress(const unsigned char *src, size_t size, unsigned char *dst,
+	size_t rawSize){
+	const unsigned char *ip = src, *iend = src + size;
+	unsigned char *op = dst, *oend = dst + rawSize;
+	while (ip < iend) {
+		unsigned char token = *ip ++;
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(ip, iend, literals))
+			return false;
+		if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op))
+			return false;
+		memcpy(op, ip, literals);
+		op += literals;
+		ip += literals;
+		//the last sequence has no match
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t offset = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		size_t length = token & 15;
+		if (length == 15 && !readLength(ip, iend, length))
+			return false;
+		length += MIN_MATCH;
+		if (offset == 0 || offset > (size_t)(op - dst) || length > (size_t)(oend - op))
+			return false;
+		const unsigned char *match = op - offset;
+		if (offset >= length)
+			memcpy(op, match, length);
+		else if (offset >= 8)
+		{
+			//overlapping but 8 bytes apart, every chunk reads bytes already written
+			size_t i = 0;
+			for (; i + 8 <= length; i += 8)
+				memcpy(op + i, match + i, 8);
+			for (; i < length; i ++)
+				op[i] = match[i];
+		}
+		else
+		{
+			//runs of a short pattern
+			for (size_t i = 0; i < length; i ++)
+				op[i] = match[i];
+		}
+		op += length;
+	}
+	return op == oend;
+}
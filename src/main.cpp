@@ -1,8 +1,16 @@
 #define STB_IMAGE_IMPLEMENTATION
+//stb_image takes its scratch buffers and images from per-thread pools
+#include "../include/decode_pool.h"
+#define STBI_MALLOC(size) DecodePool::allocate(size)
+#define STBI_REALLOC(p, size) DecodePool::reallocate(p, size)
+#define STBI_FREE(p) DecodePool::release(p)
 #include <cmath>
+#include <algorithm>
 #include "../include/glad/glad.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <string>
+#include <stdlib.h>
 
 #include "../include/glm/glm.hpp"
 #include "../include/glm/gtc/matrix_transform.hpp"
@@ -10,8 +18,22 @@
 
 #include "../include/camera.h"
 #include "../include/shader.h"
+#include "../include/shader_cache.h"
 #include "../include/config.h"
 #include "../include/data.h"
+#include "../include/texture_streamer.h"
+#include "../include/gpu_memory.h"
+#include "../include/parallel_decode.h"
+#include "../include/resource_manager.h"
+#include "../include/asset_pack.h"
+#include "../include/async_io.h"
+#include "../include/input.h"
+#include "../include/input_recorder.h"
+#include "../include/gl_profiler.h"
+#include "../include/overdraw.h"
+#include "../include/occlusion_culler.h"
+#include "../include/job_system.h"
+#include "../include/asset_loader.h"
 
 using namespace std;
 using namespace glm;
@@ -21,6 +43,37 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 800;
 const char *v_shader_path = "../resources/shader/vshader.vs";
 const char *f_shader_path = "../resources/shader/fshader.fs";
+const char *depth_shader_path = "../resources/shader/depth.fs";
+//pack of the resources directory written by the build, assets it doesn't have are
+//still read from their files
+const char *ASSET_PACK = "resources.pack";
+const char *ASSET_ROOT = "../resources";
+//stream texture mips on demand instead of uploading full mip chains at startup
+const bool STREAM_TEXTURES = false;
+const size_t STREAM_BUDGET = 64 * 1024 * 1024;
+//block compress textures while loading, BC_NONE keeps the channels of the file
+const BCFormat TEXTURE_COMPRESSION = BC_NONE;
+//mip chains of uncompressed textures are filtered on the CPU, see mip_builder.h
+const MipFilter MIP_FILTER = MIP_BOX;
+//time mouse movement until its frame is presented, waits for the GPU every frame
+const bool MEASURE_INPUT_LATENCY = false;
+//count the fragments shaded per pixel once a second, p toggles the depth pre-pass
+const bool COUNT_OVERDRAW = false;
+//skip cubes hidden behind the closest ones, tested on the CPU
+const bool OCCLUSION_CULLING = false;
+const int OCCLUDER_COUNT = 3;
+//count and time the GL calls of every frame, needs a build with -DGLAD_DEBUG=ON
+const bool PROFILE_GL_CALLS = false;
+//threads of the job system including the main thread, 0 uses every core
+const int JOB_THREADS = 0;
+//fewest objects a job builds the transforms of, smaller scenes stay on the main thread
+const size_t TRANSFORM_GRAIN = 64;
+//draw a mesh cooked by mesh_cooker in place of every cube, scaled to fit it, eg.
+//"../resources/meshes/bunny.mesh"
+const char *MESH_PATH = NULL;
+//with a -DASYNC_LOADING=ON build textures load while frames are drawn, see
+//asset_loader.h. The loader gets this much of every frame for its GL work
+const double ASYNC_LOAD_BUDGET = 0.002;
 
 float delta_time = 0.0f; //time between current frame and last frame
 float current_frame = 0.0f;	//current frame time
@@ -28,21 +81,55 @@ float last_frame = 0.0f;	//time of the last frame
 
 //value used for mixing two textures
 float mix_value = 0.2;
-GLboolean MOUSE_FIRST = 1; //mouse first time enter the screen
-float MOUSE_X, MOUSE_Y; //mouse's position
+//lay down depth with a position-only pass first, so only visible fragments are shaded
+bool depth_prepass = false;
 //vertices data
 extern float cube_vertices[];
+//the cubes are 1 unit wide around their center, this sphere holds them at any angle
+const float CUBE_RADIUS = 0.8660254f;
 extern vec3 cube_pos[];
 
 //setting up a camera
 Camera camera = Camera(vec3(0, 0, 5.0));
-int main(){
+int main(int argc, char **argv){
+	//--record file keeps the input of this run, --replay file plays a recording back
+	//instead of the live input and quits at its end, --fixed-delta seconds replaces the
+	//recorded time steps and --frame-times file.csv writes the real ones
+	const char *record_path = NULL, *replay_path = NULL, *frame_times_path = NULL;
+	float fixed_delta = 0.0f;
+	for (int i = 1; i < argc; i ++) {
+		string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc)
+			record_path = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replay_path = argv[++i];
+		else if (arg == "--fixed-delta" && i + 1 < argc)
+			fixed_delta = (float)atof(argv[++i]);
+		else if (arg == "--frame-times" && i + 1 < argc)
+			frame_times_path = argv[++i];
+		else
+		{
+			cout << "usage: HelloOpenGL [--record file | --replay file [--fixed-delta seconds]] "
+				"[--frame-times file.csv]" << endl;
+			return -1;
+		}
+	}
+	if (replay_path != NULL)
+	{
+		if (!InputRecorder::replay(replay_path, fixed_delta))
+			return -1;
+	}
+	else if (record_path != NULL)
+		InputRecorder::record(record_path);
+
 	//----------------initiate window and other stuffs-----------------//
 	//glfw initiate and configure
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	//the overdraw counter counts in the stencil buffer
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -60,54 +147,132 @@ int main(){
 
 	glfwMakeContextCurrent(window);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
-	glfwSetScrollCallback(window, scroll_callback);
-
-	//initialize glad
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	//the framebuffer can be larger than the window, eg. on high DPI screens
+	int fb_width, fb_height;
+	glfwGetFramebufferSize(window, &fb_width, &fb_height);
+	if (fb_height > 0)
+		camera.setAspect((float)fb_width / fb_height);
+	//keys, mouse buttons and scrolling are queued and applied in processInput, cursor
+	//movement is summed until the frame latches it
+	Input::attach(window);
+	Input::measureLatency(MEASURE_INPUT_LATENCY);
+
+	//initialize glad, timed because it runs at every startup
+	double glad_start = glfwGetTime();
+#ifdef GLAD_LOAD_USED_ONLY
+	int glad_status = gladLoadGLUsed((GLADloadproc)glfwGetProcAddress);
+#else
+	int glad_status = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+#endif
+	if (!glad_status)
 	{
 		cout << "Failed to initialize GLAD" << endl;
 		return -1;
 	}
+#ifdef GLAD_LOAD_USED_ONLY
+	cout << "GLAD resolved " << glad_status << " used entry points in " 
+		<< (glfwGetTime() - glad_start) * 1000.0 << " ms" << endl;
+#else
+	cout << "GLAD resolved all GL 3.3 entry points in " 
+		<< (glfwGetTime() - glad_start) * 1000.0 << " ms" << endl;
+#endif
 
-	Shader shader(v_shader_path, f_shader_path);
+	//serve every asset from one mapped file when the pack was built
+	if (!Vfs::mount(ASSET_PACK, ASSET_ROOT))
+		cout << "no asset pack at " << ASSET_PACK << ", reading loose files" << endl;
+	//start reading every startup asset in one batch, the loaders below wait for
+	//their file in Vfs::read instead of opening it one after the other
+	const char *path1 = "../resources/textures/container.jpg";
+	const char *path2 = "../resources/textures/face.png";
+	AsyncIO startup_io;
+#ifdef ASYNC_LOADING
+	//the asset loader reads the textures itself
+	startup_io.prefetch({v_shader_path, f_shader_path, depth_shader_path});
+#else
+	startup_io.prefetch({v_shader_path, f_shader_path, depth_shader_path, path1, path2});
+#endif
+
+	//shaders are compiled on first use, variants are selected with #define lines
+	ShaderCache shader_cache;
+	Shader *shader_ptr = shader_cache.get(ShaderVariant(v_shader_path, f_shader_path));
+	//the same vertex shader without texture coordinates, for the depth pre-pass
+	Shader *depth_shader_ptr = shader_cache.get(ShaderVariant(v_shader_path,
+		depth_shader_path, {"DEPTH_ONLY"}));
+	if (shader_ptr == NULL || depth_shader_ptr == NULL)
+	{
+		glfwTerminate();
+		return -1;
+	}
+	Shader &shader = *shader_ptr;
+	Shader &depth_shader = *depth_shader_ptr;
 	camera.setMouseVerticalInverse(true);
 	//------------------------Vertices and Data-------------------------//
-	//create VAO
-	unsigned int VAO, VBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-
-	glBindVertexArray(VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, 
-		GL_STATIC_DRAW);
-
-	//vertex position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	//texture vertices
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 
-		(void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	//unbind VAO, VBO and EBO, optional
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	//the cube's VAO and VBO, position and texture coordinates of each vertex
+	vector<int> cube_layout = {3, 2};
+	MeshHandle cube = ResourceManager::mesh("cube vertices", cube_vertices,
+		sizeof(cube_vertices) / (5 * sizeof(float)), cube_layout);
+	unsigned int VAO = cube->vao;
+	//the positions alone, 12 bytes a vertex for the depth pre-pass
+	MeshHandle cube_positions = ResourceManager::meshAttribute("cube positions",
+		cube_vertices, cube->vertexCount, cube_layout, 0);
+	//its positions are first in every vertex, the depth pre-pass draws the same array
+	MeshHandle cooked;
+	mat4 cooked_fit;
+	if (MESH_PATH != NULL && (cooked = ResourceManager::meshFile(MESH_PATH)))
+	{
+		vec3 low = make_vec3(cooked->boundsMin), high = make_vec3(cooked->boundsMax);
+		float size = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z));
+		cooked_fit = scale(mat4(), vec3(size > 0.0f ? 1.0f / size : 1.0f));
+		cooked_fit = translate(cooked_fit, -0.5f * (low + high));
+	}
 
 	//---------------------------------Texture----------------------------//
 
+	//large JPEGs are decoded on every core, by the workers of the job system
+	JobSystem::init(JOB_THREADS);
+	ParallelDecode::enable();
+
 	//generate texture
 	unsigned int texture1, texture2;
-	glGenTextures(1, &texture1);
-	glGenTextures(1, &texture2);
-	const char *path1 = "../resources/textures/container.jpg";
-	const char *path2 = "../resources/textures/face.png";
-	//configuring textures
-	configTexture(path1, texture1);
-	configTexture(path2, texture2);
+	TextureHandle texture_handle1, texture_handle2;
+	TextureStreamer *streamer = NULL;
+	int stream1 = -1, stream2 = -1;
+	if (STREAM_TEXTURES)
+	{
+		streamer = new TextureStreamer(STREAM_BUDGET);
+		stream1 = streamer->load(path1);
+		stream2 = streamer->load(path2);
+		texture1 = stream1 < 0 ? 0 : streamer->textureID(stream1);
+		texture2 = stream2 < 0 ? 0 : streamer->textureID(stream2);
+	}
+	else
+	{
+#ifdef ASYNC_LOADING
+		//the cubes are drawn untextured until pump() uploaded the last level
+		AssetLoader::init();
+		texture1 = texture2 = 0;
+		AssetLoader::loadTexture(path1, [&](const TextureHandle &texture) {
+			texture_handle1 = texture;
+			texture1 = texture ? texture->id : 0;
+		}, 0, false, MIP_FILTER);
+		AssetLoader::loadTexture(path2, [&](const TextureHandle &texture) {
+			texture_handle2 = texture;
+			texture2 = texture ? texture->id : 0;
+		}, 0, false, MIP_FILTER);
+#else
+		//loading and configuring textures, a file already loaded is shared
+		texture_handle1 = ResourceManager::texture(path1, TEXTURE_COMPRESSION, false, MIP_FILTER);
+		texture_handle2 = ResourceManager::texture(path2, TEXTURE_COMPRESSION, false, MIP_FILTER);
+		texture1 = texture_handle1 ? texture_handle1->id : 0;
+		texture2 = texture_handle2 ? texture_handle2->id : 0;
+#endif
+		DecodePool::report();
+		ResourceManager::report();
+		Vfs::report();
+		startup_io.report();
+	}
+	//prefetched files nothing asked for would stay in memory
+	Vfs::clearExpected();
 	//set uniform in shader
 	shader.use();
 	shader.setInt("texture1", 0);
@@ -117,26 +282,163 @@ int main(){
 
 	//creating model matrix. used to transform local space to world space
 	//this is set in the rendering loop
-	//creating view matrix, used to transform world space to user view
-	mat4 view;
-	//creating proejction matrix, used for perspective projection
-	mat4 proj;
+	//the view and projection matrices are cached by the camera, they are only sent
+	//to the shader when the camera changed
+	unsigned int camera_revision = camera.getRevision() - 1;
+	mat4 models[10];
+	//fragments shaded without and with the depth pre-pass
+	OverdrawSample overdraw[2] = {{0, 0, 0, 0}, {0, 0, 0, 0}};
+	float overdraw_time = 0.0f;
+	OcclusionCuller *culler = OCCLUSION_CULLING ? new OcclusionCuller() : NULL;
 
 	mat4 rotation;
+	float stats_time = 0.0f; //last time streaming stats were shown
+	//the loading above is not profiled, only the frames
+	if (PROFILE_GL_CALLS && !GLProfiler::attach())
+		cout << "GL call profiling needs a build with -DGLAD_DEBUG=ON" << endl;
+	//these wait for the GPU on purpose
+	if (MEASURE_INPUT_LATENCY)
+		GLProfiler::allowSync("glFinish");
+	if (COUNT_OVERDRAW)
+		GLProfiler::allowSync("glReadPixels");
 	//-------------------------rendering------------------------------------//
 	while(!glfwWindowShouldClose(window))
 	{
-		processInput(window);
-		//update frame timer
+		//update frame timer, a replay swaps in its own time step
 		current_frame = glfwGetTime();
 		delta_time = current_frame - last_frame;
 		last_frame = current_frame;
+		if (!InputRecorder::frame(delta_time))
+			break;
+		processInput(window);
+#ifdef ASYNC_LOADING
+		AssetLoader::pump(ASYNC_LOAD_BUDGET);
+#endif
 
 		//enable depth test for 3d objects
 		glEnable(GL_DEPTH_TEST);
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		if (streamer != NULL)
+		{
+			//both textures cover every cube, the closest cube decides the mip we need
+			float size = 0.0f;
+			for (int i = 0; i < 10; i ++) {
+				float distance = length(cube_pos[i] - camera.getPosition());
+				size = std::max(size, TextureStreamer::projectedSize(1.0f, distance, 
+					radians(camera.getFOV()), SCR_HEIGHT));
+			}
+			if (stream1 >= 0)
+				streamer->requestSize(stream1, size);
+			if (stream2 >= 0)
+				streamer->requestSize(stream2, size);
+			streamer->update();
+			if (current_frame - stats_time > 1.0f)
+			{
+				stats_time = current_frame;
+				cout << "streaming: " << streamer->residentBytes() / 1024 << " KB resident, "
+					<< streamer->queueDepth() << " mips queued, " << streamer->failedLoads()
+					<< " failed, decode pool "
+					<< (int)(DecodePool::stats().reuseRate() * 100.0) << "% reused" << endl;
+			}
+		}
+
+		//configure model, view, projection
+		//camera rotation, turned once with every mouse movement since the last frame
+		MouseDelta mouse = Input::latchMouse();
+		if (mouse.events > 0)
+			camera.processMouseMovement(mouse.x, mouse.y);
+		if (camera.getRevision() != camera_revision)
+		{
+			camera_revision = camera.getRevision();
+			depth_shader.use();
+			depth_shader.setMat4("view", camera.getView());
+			depth_shader.setMat4("proj", camera.getProjection());
+			shader.use();
+			shader.setMat4("view", camera.getView());
+			shader.setMat4("proj", camera.getProjection());
+		}
+		const Frustum &frustum = camera.getFrustum();
+		//cubes' rotation
+		rotation = rotate(rotation, radians(1.0f), vec3(0.5f, 1.0f, 0.0f));
+		//model matrices of the cubes in view, the others are skipped
+		mat4 built[10];
+		bool in_view[10];
+		JobSystem::parallelFor(0, 10, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i ++) {
+				in_view[i] = frustum.sphereVisible(cube_pos[i], CUBE_RADIUS);
+				if (!in_view[i])
+					continue;
+				mat4 model;
+				model = translate(model, cube_pos[i]);
+				float angle = 20.0f * i;
+				model = rotate(model, radians(angle), vec3(1.0f, 0.3f, 0.5f));
+				built[i] = model * rotation;
+			}
+		}, TRANSFORM_GRAIN);
+		int visible = 0;
+		for (int i = 0; i < 10 ; i ++)
+			if (in_view[i])
+				models[visible ++] = built[i];
+
+		if (culler != NULL)
+		{
+			//the closest cubes are the occluders, they are drawn without a test
+			int order[10];
+			float distance[10];
+			for (int i = 0; i < visible; i ++) {
+				order[i] = i;
+				distance[i] = length(vec3(models[i][3]) - camera.getPosition());
+			}
+			sort(order, order + visible, [&](int a, int b) { return distance[a] < distance[b]; });
+			int occluders = std::min(visible, OCCLUDER_COUNT);
+			culler->begin(camera.getViewProjection());
+			for (int i = 0; i < occluders; i ++)
+				culler->addOccluder(cube_vertices, 36, 5, models[order[i]]);
+			culler->rasterize();
+			mat4 sorted[10];
+			int kept = 0;
+			for (int i = 0; i < visible; i ++) {
+				const mat4 &model = models[order[i]];
+				//box around the rotated cube, half of each axis projected on the world axes
+				vec3 center = vec3(model[3]);
+				vec3 extent = 0.5f * (abs(vec3(model[0])) + abs(vec3(model[1])) + abs(vec3(model[2])));
+				if (i < occluders || culler->visible(center - extent, center + extent))
+					sorted[kept ++] = model;
+			}
+			//front to back also helps the depth test
+			copy(sorted, sorted + kept, models);
+			visible = kept;
+		}
+
+		if (depth_prepass)
+		{
+			//depth only, then the shading pass only passes the closest fragment
+			depth_shader.use();
+			glBindVertexArray(cooked ? cooked->vao : cube_positions->vao);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			for (int i = 0; i < visible; i ++) {
+				if (cooked)
+				{
+					depth_shader.setMat4("model", models[i] * cooked_fit);
+					glDrawElements(GL_TRIANGLES, cooked->indexCount, cooked->indexType, 0);
+				}
+				else
+				{
+					depth_shader.setMat4("model", models[i]);
+					glDrawArrays(GL_TRIANGLES, 0, cube_positions->vertexCount);
+				}
+			}
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthMask(GL_FALSE);
+			glDepthFunc(GL_EQUAL);
+		}
+
+		//count once a second, reading the stencil back waits for the GPU
+		bool count_overdraw = COUNT_OVERDRAW && current_frame - overdraw_time > 1.0f &&
+			OverdrawCounter::begin();
+
 		//render
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, texture1);
@@ -144,37 +446,78 @@ int main(){
 		glBindTexture(GL_TEXTURE_2D, texture2);
 
 		//configure shader
-
-		shader.setFloat("mix_value", mix_value);
 		shader.use();
+		shader.setFloat("mix_value", mix_value);
 
-		glBindVertexArray(VAO);
-		//configure model, view, projection
-		//camera rotation
-		view = camera.getView();
-		proj = perspective(radians(camera.getFOV()), float(SCR_WIDTH / SCR_HEIGHT), 0.1f, 100.0f);
-		shader.setMat4("view", view);
-		shader.setMat4("proj", proj);
-		//cubes' rotation
-		rotation = rotate(rotation, radians(1.0f), vec3(0.5f, 1.0f, 0.0f));
-		//draw 10 cubes
-		for (int i = 0; i < 10 ; i ++) {
-			mat4 model;
-			model = translate(model, cube_pos[i]);
-			float angle = 20.0f * i;
-			model = rotate(model, radians(angle), vec3(1.0f, 0.3f, 0.5f));
-			model = model * rotation;
-			shader.setMat4("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+		glBindVertexArray(cooked ? cooked->vao : VAO);
+		for (int i = 0; i < visible; i ++) {
+			if (cooked)
+			{
+				shader.setMat4("model", models[i] * cooked_fit);
+				glDrawElements(GL_TRIANGLES, cooked->indexCount, cooked->indexType, 0);
+			}
+			else
+			{
+				shader.setMat4("model", models[i]);
+				glDrawArrays(GL_TRIANGLES, 0, 36);
+			}
+		}
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+
+		if (count_overdraw)
+		{
+			overdraw_time = current_frame;
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			overdraw[depth_prepass].add(OverdrawCounter::end(width, height));
+			OverdrawCounter::report(overdraw[depth_prepass],
+				depth_prepass ? "pre-pass on" : "pre-pass off");
 		}
 
 		glfwSwapBuffers(window);
+		if (MEASURE_INPUT_LATENCY)
+		{
+			//the frame is only on screen once the GPU is done with it
+			glFinish();
+			Input::presented();
+		}
+		if (GLProfiler::attached())
+			GLProfiler::endFrame();
 		glfwPollEvents();
 	}
 
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
+#ifdef ASYNC_LOADING
+	//loads still running are cancelled, their callbacks run before the handles go
+	AssetLoader::report();
+	AssetLoader::shutdown();
+#endif
+	//the last handles delete their GL objects, while the context is still current
+	cube.reset();
+	cube_positions.reset();
+	cooked.reset();
+	texture_handle1.reset();
+	texture_handle2.reset();
+	delete streamer;
+	if (culler != NULL)
+		culler->report();
+	delete culler;
+	JobSystem::report();
+	JobSystem::shutdown();
+	Input::report();
+	if (GLProfiler::attached())
+	{
+		GLProfiler::detach();
+		GLProfiler::report();
+	}
+	InputRecorder::stop();
+	InputRecorder::report();
+	if (frame_times_path != NULL && !InputRecorder::writeFrameTimes(frame_times_path))
+		cout << "ERROR::MAIN::FRAME_TIMES_NOT_WRITTEN: " << frame_times_path << endl;
+	if (overdraw[0].frames > 0)
+		OverdrawCounter::report(overdraw[0], "pre-pass off");
+	if (overdraw[1].frames > 0)
+		OverdrawCounter::report(overdraw[1], "pre-pass on");
 
 	glfwTerminate();
 	return 0;
@@ -0,0 +1,152 @@
+//this file contains the cooked mesh writer and reader
+#include "../include/mesh_file.h"
+#include "../include/hash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <fstream>
+#include <algorithm>
+
+//the header is written as it is, on little endian machines
+static_assert(sizeof(MeshFileHeader) == 96, "MeshFileHeader must not be padded");
+
+static const uint32_t ATTRIBUTE_SIZES[MESH_ATTRIBUTE_COUNT] = {3, 2, 3};
+
+MeshData::MeshData(){
+	layout[MESH_POSITION] = 3;
+	layout[MESH_TEXCOORD] = layout[MESH_NORMAL] = 0;
+	for (int i = 0; i < 3; i ++)
+		boundsMin[i] = boundsMax[i] = 0.0f;
+}
+
+int MeshData::stride() const {
+	int stride = 0;
+	for (int i = 0; i < MESH_ATTRIBUTE_COUNT; i ++)
+		stride += layout[i];
+	return stride;
+}
+
+size_t MeshData::vertexCount() const {
+	int floats = stride();
+	return floats > 0 ? vertices.size() / floats : 0;
+}
+
+void MeshData::computeBounds(){
+	size_t count = vertexCount();
+	int floats = stride();
+	for (int i = 0; i < 3; i ++) {
+		boundsMin[i] = count ? FLT_MAX : 0.0f;
+		boundsMax[i] = count ? -FLT_MAX : 0.0f;
+	}
+	for (size_t v = 0; v < count; v ++) {
+		const float *position = &vertices[v * floats];
+		for (int i = 0; i < 3; i ++) {
+			boundsMin[i] = min(boundsMin[i], position[i]);
+			boundsMax[i] = max(boundsMax[i], position[i]);
+		}
+	}
+}
+
+//--------------------------------writing-----------------------------------//
+
+static uint64_t align(uint64_t offset){
+	return (offset + MESH_ALIGNMENT - 1) / MESH_ALIGNMENT * MESH_ALIGNMENT;
+}
+
+bool MeshFile::write(const char *path, const MeshData &mesh){
+	size_t count = mesh.vertexCount();
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_MAGIC, 4);
+	header.version = MESH_VERSION;
+	header.vertexCount = (uint32_t)count;
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.indexSize = count <= 0xFFFF ? 2 : 4;
+	memcpy(header.layout, mesh.layout, sizeof(header.layout));
+	memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+
+	vector<uint16_t> short_indices;
+	const void *indices = mesh.indices.empty() ? NULL : &mesh.indices[0];
+	if (header.indexSize == 2)
+	{
+		short_indices.assign(mesh.indices.begin(), mesh.indices.end());
+		indices = short_indices.empty() ? NULL : &short_indices[0];
+	}
+	header.vertexOffset = align(sizeof(header));
+	header.vertexBytes = mesh.vertices.size() * sizeof(float);
+	header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+	header.indexBytes = (uint64_t)header.indexCount * header.indexSize;
+	header.hash = hash64(mesh.vertices.empty() ? NULL : &mesh.vertices[0],
+		(size_t)header.vertexBytes);
+	header.hash = hash64(indices, (size_t)header.indexBytes, header.hash);
+
+	//written next to the file and renamed, like the asset pack
+	string temp = string(path) + ".tmp";
+	{
+		ofstream out(temp.c_str(), ios::binary | ios::trunc);
+		static const char zeros[MESH_ALIGNMENT] = {0};
+		out.write((const char *)&header, sizeof(header));
+		out.write(zeros, (streamsize)(header.vertexOffset - sizeof(header)));
+		if (header.vertexBytes > 0)
+			out.write((const char *)&mesh.vertices[0], (streamsize)header.vertexBytes);
+		out.write(zeros, (streamsize)(header.indexOffset - header.vertexOffset -
+			header.vertexBytes));
+		if (header.indexBytes > 0)
+			out.write((const char *)indices, (streamsize)header.indexBytes);
+		if (!out)
+			return false;
+	}
+#ifdef _WIN32
+	remove(path);
+#endif
+	return rename(temp.c_str(), path) == 0;
+}
+
+//--------------------------------reading-----------------------------------//
+
+const MeshFileHeader *MeshFile::validate(const unsigned char *data, size_t size){
+	if (data == NULL || size < sizeof(MeshFileHeader))
+		return NULL;
+	const MeshFileHeader *header = (const MeshFileHeader *)data;
+	if (memcmp(header->magic, MESH_MAGIC, 4) != 0 || header->version != MESH_VERSION ||
+		(header->indexSize != 2 && header->indexSize != 4) || header->indexCount % 3 != 0)
+		return NULL;
+	if (header->layout[MESH_POSITION] != ATTRIBUTE_SIZES[MESH_POSITION])
+		return NULL;
+	for (int i = 1; i < MESH_ATTRIBUTE_COUNT; i ++)
+		if (header->layout[i] != 0 && header->layout[i] != ATTRIBUTE_SIZES[i])
+			return NULL;
+	//the blobs must be where the header says and as large as the counts need
+	if (header->vertexOffset % 4 != 0 || header->indexOffset % 4 != 0 ||
+		header->vertexOffset > size || header->vertexBytes > size - header->vertexOffset ||
+		header->indexOffset > size || header->indexBytes > size - header->indexOffset ||
+		header->vertexBytes != (uint64_t)header->vertexCount * stride(header) * sizeof(float) ||
+		header->indexBytes != (uint64_t)header->indexCount * header->indexSize)
+		return NULL;
+	//an index past the vertices would make the GPU read outside the vertex buffer
+	const void *indices = data + header->indexOffset;
+	for (uint32_t i = 0; i < header->indexCount; i ++) {
+		uint32_t index = header->indexSize == 2 ? ((const uint16_t *)indices)[i] :
+			((const uint32_t *)indices)[i];
+		if (index >= header->vertexCount)
+			return NULL;
+	}
+	return header;
+}
+
+const float *MeshFile::vertices(const MeshFileHeader *header){
+	return (const float *)((const unsigned char *)header + header->vertexOffset);
+}
+
+const void *MeshFile::indices(const MeshFileHeader *header){
+	return (const unsigned char *)header + header->indexOffset;
+}
+
+int MeshFile::stride(const MeshFileHeader *header){
+	int stride = 0;
+	for (int i = 0; i < MESH_ATTRIBUTE_COUNT; i ++)
+		stride += header->layout[i];
+	return stride;
+}
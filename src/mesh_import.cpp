@@ -0,0 +1,1151 @@
+//this file contains the OBJ and glTF importer, the vertex welder and the vertex cache
+//optimizer
+#include "../include/mesh_import.h"
+#include "../include/asset_pack.h"
+#include "../include/hash.h"
+#include "../include/glm/glm.hpp"
+#include "../include/glm/gtc/matrix_transform.hpp"
+#include "../include/glm/gtc/quaternion.hpp"
+#include "../include/glm/gtc/type_ptr.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+
+//OBJ text below this size is parsed on one thread, starting threads costs more
+static const size_t PARALLEL_MIN_BYTES = 1 << 20;
+
+static double seconds(chrono::steady_clock::time_point start){
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//--------------------------------numbers-----------------------------------//
+
+static const double POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isBlank(char c){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c){
+	return (unsigned)(c - '0') < 10;
+}
+
+static inline const char *skipBlanks(const char *p, const char *end){
+	while (p < end && isBlank(*p))
+		p ++;
+	return p;
+}
+
+//a decimal number like "-1.5e-3", p is left after it. Up to 19 significant digits are
+//kept exactly and scaled by an exact power of ten, so the float is correctly rounded
+//for any number a mesh exporter writes
+//POST:
+//	return NULL if there is no number at p
+static const char *parseFloat(const char *p, const char *end, float &value){
+	p = skipBlanks(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p ++ == '-';
+	uint64_t mantissa = 0;
+	int significant = 0, exponent = 0;
+	const char *digits = p;
+	for (; p < end && isDigit(*p); p ++) {
+		if (significant < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			significant += mantissa > 0;
+		}
+		else
+			exponent ++;
+	}
+	bool integer_digits = p > digits;
+	if (p < end && *p == '.')
+	{
+		digits = ++ p;
+		for (; p < end && isDigit(*p); p ++) {
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa > 0;
+				exponent --;
+			}
+		}
+		if (!integer_digits && p == digits)
+			return NULL;
+	}
+	else if (!integer_digits)
+		return NULL;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *e = p + 1;
+		bool negative_exponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negative_exponent = *e ++ == '-';
+		if (e < end && isDigit(*e))
+		{
+			int power = 0;
+			for (; e < end && isDigit(*e); e ++)
+				if (power < 1000)
+					power = power * 10 + (*e - '0');
+			exponent += negative_exponent ? -power : power;
+			p = e;
+		}
+	}
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent] : result * pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * pow(10.0, exponent);
+	value = (float)(negative ? -result : result);
+	return p;
+}
+
+//POST:
+//	return NULL if there is no integer at p
+static const char *parseInt(const char *p, const char *end, long &value){
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p ++ == '-';
+	if (p >= end || !isDigit(*p))
+		return NULL;
+	long result = 0;
+	for (; p < end && isDigit(*p); p ++)
+		if (result < INT_MAX)
+			result = result * 10 + (*p - '0');
+	value = negative ? -result : result;
+	return p;
+}
+
+//-----------------------------------OBJ------------------------------------//
+
+//a corner that doesn't reference texture coordinates or a normal
+static const int32_t NO_INDEX = INT32_MIN;
+
+//what one thread read from its lines
+struct ObjChunk {
+	vector<float> positions, texcoords, normals;
+	//position, texture coordinate and normal index of every corner of every triangle,
+	//counted from the start of the file
+	vector<int32_t> corners;
+	//slots of corners that were negative, they count from the start of the chunk until
+	//the attributes of the chunks before it are known
+	vector<size_t> relative;
+	const char *error;	//first line that couldn't be read, NULL if none
+	ObjChunk() : error(NULL) {}
+};
+
+struct ObjCorner {
+	int32_t index[3];
+	bool relative[3];
+};
+
+static void emitCorner(ObjChunk &chunk, const ObjCorner &corner){
+	for (int i = 0; i < 3; i ++) {
+		if (corner.relative[i])
+			chunk.relative.push_back(chunk.corners.size());
+		chunk.corners.push_back(corner.index[i]);
+	}
+}
+
+//"7", "7/3", "7//2" or "7/3/2", p is left after it
+static const char *parseCorner(const char *p, const char *end, const ObjChunk &chunk,
+	ObjCorner &corner){
+	size_t counts[3] = {chunk.positions.size() / 3, chunk.texcoords.size() / 2,
+		chunk.normals.size() / 3};
+	for (int i = 0; i < 3; i ++) {
+		corner.index[i] = NO_INDEX;
+		corner.relative[i] = false;
+		if (i > 0)
+		{
+			if (p >= end || *p != '/')
+				continue;
+			p ++;
+			//"7//2" has no texture coordinates
+			if (i == 1 && p < end && *p == '/')
+				continue;
+		}
+		long value;
+		if ((p = parseInt(p, end, value)) == NULL || value == 0)
+			return NULL;
+		//1 is the first of the file, -1 the last one so far
+		corner.index[i] = (int32_t)(value > 0 ? value - 1 : (long)counts[i] + value);
+		corner.relative[i] = value < 0;
+	}
+	return p;
+}
+
+static void parseObjChunk(const char *p, const char *end, ObjChunk &chunk){
+	while (p < end) {
+		p = skipBlanks(p, end);
+		const char *line = p;
+		bool ok = true;
+		if (p + 1 < end && p[0] == 'v' && isBlank(p[1]))
+		{
+			float xyz[3];
+			for (int i = 0; i < 3 && ok; i ++)
+				ok = (p = parseFloat(p + (i == 0), end, xyz[i])) != NULL;
+			if (ok)
+				chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+		{
+			float uv[2] = {0.0f, 0.0f};
+			ok = (p = parseFloat(p + 2, end, uv[0])) != NULL;
+			//v is optional
+			const char *next = skipBlanks(p ? p : end, end);
+			if (ok && next < end && *next != '\n')
+				ok = (p = parseFloat(next, end, uv[1])) != NULL;
+			if (ok)
+				chunk.texcoords.insert(chunk.texcoords.end(), uv, uv + 2);
+		}
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+		{
+			float xyz[3];
+			for (int i = 0; i < 3 && ok; i ++)
+				ok = (p = parseFloat(p + (i == 0 ? 2 : 0), end, xyz[i])) != NULL;
+			if (ok)
+				chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+		}
+		else if (p + 1 < end && p[0] == 'f' && isBlank(p[1]))
+		{
+			//fan the polygon around its first corner
+			ObjCorner first, previous, corner;
+			int count = 0;
+			p ++;
+			while (ok && (p = skipBlanks(p, end)) < end && *p != '\n') {
+				if ((p = parseCorner(p, end, chunk, corner)) == NULL)
+					ok = false;
+				else
+				{
+					if (count == 0)
+						first = corner;
+					else if (count >= 2)
+					{
+						emitCorner(chunk, first);
+						emitCorner(chunk, previous);
+						emitCorner(chunk, corner);
+					}
+					previous = corner;
+					count ++;
+				}
+			}
+			ok = ok && count >= 3;
+		}
+		if (!ok && chunk.error == NULL)
+			chunk.error = line;
+		//the rest of the line, comments and everything else is skipped
+		const char *newline = p ? (const char *)memchr(p, '\n', end - p) : NULL;
+		if (p == NULL)
+			newline = (const char *)memchr(line, '\n', end - line);
+		p = newline ? newline + 1 : end;
+	}
+}
+
+//slot of an open addressing table, an index into the keys or EMPTY
+static const uint32_t EMPTY = UINT32_MAX;
+
+static size_t tableSize(size_t entries){
+	size_t size = 16;
+	while (size < entries * 2)
+		size *= 2;
+	return size;
+}
+
+static inline uint32_t hashCorner(const int32_t *corner){
+	uint64_t h = (uint32_t)corner[0] * 0x9E3779B97F4A7C15ULL;
+	h ^= (uint32_t)corner[1] * 0xC2B2AE3D27D4EB4FULL + (h >> 29);
+	h ^= (uint32_t)corner[2] * 0x165667B19E3779F9ULL + (h >> 32);
+	return (uint32_t)(h ^ (h >> 31));
+}
+
+bool MeshImporter::parseObj(const char *text, size_t size, MeshData &out, int threads){
+	if (threads <= 0)
+		threads = max(1, (int)thread::hardware_concurrency());
+	if (size < PARALLEL_MIN_BYTES)
+		threads = 1;
+	//chunks end after a line
+	const char *end = text + size;
+	vector<const char *> bounds(threads + 1, end);
+	bounds[0] = text;
+	for (int i = 1; i < threads; i ++) {
+		const char *p = max(bounds[i - 1], text + size / threads * i);
+		const char *newline = (const char *)memchr(p, '\n', end - p);
+		bounds[i] = newline ? newline + 1 : end;
+	}
+	vector<ObjChunk> chunks(threads);
+	vector<thread> workers;
+	for (int i = 1; i < threads; i ++)
+		workers.push_back(thread(parseObjChunk, bounds[i], bounds[i + 1], ref(chunks[i])));
+	parseObjChunk(bounds[0], bounds[1], chunks[0]);
+	for (size_t i = 0; i < workers.size(); i ++)
+		workers[i].join();
+
+	for (int i = 0; i < threads; i ++)
+		if (chunks[i].error != NULL)
+		{
+			const char *line = chunks[i].error;
+			cout << "ERROR::MESH_IMPORT::OBJ_SYNTAX: line "
+				<< count(text, line, '\n') + 1 << ": "
+				<< string(line, (const char *)memchr(line, '\n', end - line) ?
+					(const char *)memchr(line, '\n', end - line) : end) << endl;
+			return false;
+		}
+
+	//indices count from the start of the file once the chunks before are known
+	size_t positions = 0, texcoords = 0, normals = 0, corners = 0;
+	for (int i = 0; i < threads; i ++) {
+		ObjChunk &chunk = chunks[i];
+		int32_t bases[3] = {(int32_t)positions, (int32_t)texcoords, (int32_t)normals};
+		for (size_t r = 0; r < chunk.relative.size(); r ++)
+			chunk.corners[chunk.relative[r]] += bases[chunk.relative[r] % 3];
+		positions += chunk.positions.size() / 3;
+		texcoords += chunk.texcoords.size() / 2;
+		normals += chunk.normals.size() / 3;
+		corners += chunk.corners.size() / 3;
+	}
+	if (corners > UINT32_MAX || positions > INT32_MAX)
+	{
+		cout << "ERROR::MESH_IMPORT::TOO_LARGE" << endl;
+		return false;
+	}
+	vector<float> all_positions, all_texcoords, all_normals;
+	all_positions.reserve(positions * 3);
+	all_texcoords.reserve(texcoords * 2);
+	all_normals.reserve(normals * 3);
+	for (int i = 0; i < threads; i ++) {
+		ObjChunk &chunk = chunks[i];
+		all_positions.insert(all_positions.end(), chunk.positions.begin(), chunk.positions.end());
+		all_texcoords.insert(all_texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+		all_normals.insert(all_normals.end(), chunk.normals.begin(), chunk.normals.end());
+		vector<float>().swap(chunk.positions);
+		vector<float>().swap(chunk.texcoords);
+		vector<float>().swap(chunk.normals);
+	}
+
+	//corners with the same three indices are one vertex
+	MeshData mesh;
+	mesh.layout[MESH_TEXCOORD] = texcoords > 0 ? 2 : 0;
+	mesh.layout[MESH_NORMAL] = normals > 0 ? 3 : 0;
+	vector<uint32_t> table(tableSize(corners), EMPTY);
+	size_t mask = table.size() - 1;
+	vector<int32_t> keys;
+	mesh.indices.reserve(corners);
+	size_t counts[3] = {positions, texcoords, normals};
+	for (int i = 0; i < threads; i ++) {
+		const vector<int32_t> &chunk = chunks[i].corners;
+		for (size_t c = 0; c < chunk.size(); c += 3) {
+			const int32_t *corner = &chunk[c];
+			for (int a = 0; a < 3; a ++)
+				if ((corner[a] != NO_INDEX || a == 0) &&
+					(corner[a] < 0 || (size_t)corner[a] >= counts[a]))
+				{
+					cout << "ERROR::MESH_IMPORT::OBJ_INDEX_OUT_OF_RANGE: " << corner[a] + 1
+						<< endl;
+					return false;
+				}
+			size_t slot = hashCorner(corner) & mask;
+			while (table[slot] != EMPTY && memcmp(&keys[(size_t)table[slot] * 3], corner,
+				3 * sizeof(int32_t)) != 0)
+				slot = (slot + 1) & mask;
+			if (table[slot] == EMPTY)
+			{
+				table[slot] = (uint32_t)(keys.size() / 3);
+				keys.insert(keys.end(), corner, corner + 3);
+				const float *position = &all_positions[(size_t)corner[0] * 3];
+				mesh.vertices.insert(mesh.vertices.end(), position, position + 3);
+				if (mesh.layout[MESH_TEXCOORD])
+				{
+					float uv[2] = {0.0f, 0.0f};
+					if (corner[1] != NO_INDEX)
+						memcpy(uv, &all_texcoords[(size_t)corner[1] * 2], sizeof(uv));
+					mesh.vertices.insert(mesh.vertices.end(), uv, uv + 2);
+				}
+				if (mesh.layout[MESH_NORMAL])
+				{
+					float normal[3] = {0.0f, 0.0f, 0.0f};
+					if (corner[2] != NO_INDEX)
+						memcpy(normal, &all_normals[(size_t)corner[2] * 3], sizeof(normal));
+					mesh.vertices.insert(mesh.vertices.end(), normal, normal + 3);
+				}
+			}
+			mesh.indices.push_back(table[slot]);
+		}
+	}
+	mesh.computeBounds();
+	swap(out, mesh);
+	return true;
+}
+
+//-----------------------------------JSON-----------------------------------//
+
+//a parsed JSON value, glTF documents are small next to their buffers
+struct Json {
+	enum Type {NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT} type;
+	double number;
+	string text;
+	vector<Json> items;	//elements of an array, values of an object
+	vector<string> keys;	//of an object
+
+	Json() : type(NUL), number(0.0) {}
+	const Json *get(const char *key) const {
+		for (size_t i = 0; i < keys.size(); i ++)
+			if (keys[i] == key)
+				return &items[i];
+		return NULL;
+	}
+	const Json *at(size_t i) const {
+		return type == ARRAY && i < items.size() ? &items[i] : NULL;
+	}
+	double num(const char *key, double fallback) const {
+		const Json *value = get(key);
+		return value != NULL && value->type == NUMBER ? value->number : fallback;
+	}
+	//the number as an index or size, (size_t)-1 if it isn't a whole number that fits.
+	//Casting a negative or too large double to size_t is undefined
+	size_t index() const {
+		if (type != NUMBER || !(number >= 0.0) || number >= (double)(size_t)-1 ||
+			number != floor(number))
+			return (size_t)-1;
+		return (size_t)number;
+	}
+	size_t count(const char *key, size_t fallback) const {
+		const Json *value = get(key);
+		return value != NULL && value->type == NUMBER ? value->index() : fallback;
+	}
+	size_t size() const { return type == ARRAY ? items.size() : 0; }
+};
+
+static const char *skipJsonSpace(const char *p, const char *end){
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+		p ++;
+	return p;
+}
+
+static void appendUtf8(string &out, unsigned code){
+	if (code < 0x80)
+		out += (char)code;
+	else if (code < 0x800)
+	{
+		out += (char)(0xC0 | code >> 6);
+		out += (char)(0x80 | (code & 0x3F));
+	}
+	else
+	{
+		out += (char)(0xE0 | code >> 12);
+		out += (char)(0x80 | (code >> 6 & 0x3F));
+		out += (char)(0x80 | (code & 0x3F));
+	}
+}
+
+static const char *parseJsonString(const char *p, const char *end, string &out){
+	if (p >= end || *p != '"')
+		return NULL;
+	for (p ++; p < end && *p != '"'; p ++) {
+		if (*p != '\\')
+		{
+			out += *p;
+			continue;
+		}
+		if (++ p >= end)
+			return NULL;
+		switch (*p) {
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				if (end - p < 5)
+					return NULL;
+				char hex[5] = {p[1], p[2], p[3], p[4], 0};
+				appendUtf8(out, (unsigned)strtoul(hex, NULL, 16));
+				p += 4;
+				break;
+			}
+			default: out += *p; break;
+		}
+	}
+	return p < end ? p + 1 : NULL;
+}
+
+static const char *parseJson(const char *p, const char *end, Json &out, int depth){
+	p = skipJsonSpace(p, end);
+	if (p >= end || depth > 64)
+		return NULL;
+	if (*p == '{' || *p == '[')
+	{
+		bool object = *p == '{';
+		out.type = object ? Json::OBJECT : Json::ARRAY;
+		p = skipJsonSpace(p + 1, end);
+		if (p < end && *p == (object ? '}' : ']'))
+			return p + 1;
+		while (p < end) {
+			if (object)
+			{
+				out.keys.push_back(string());
+				if ((p = parseJsonString(skipJsonSpace(p, end), end, out.keys.back())) == NULL)
+					return NULL;
+				p = skipJsonSpace(p, end);
+				if (p >= end || *p != ':')
+					return NULL;
+				p ++;
+			}
+			out.items.push_back(Json());
+			if ((p = parseJson(p, end, out.items.back(), depth + 1)) == NULL)
+				return NULL;
+			p = skipJsonSpace(p, end);
+			if (p < end && *p == ',')
+				p ++;
+			else if (p < end && *p == (object ? '}' : ']'))
+				return p + 1;
+			else
+				return NULL;
+		}
+		return NULL;
+	}
+	if (*p == '"')
+	{
+		out.type = Json::STRING;
+		return parseJsonString(p, end, out.text);
+	}
+	if (end - p >= 4 && strncmp(p, "true", 4) == 0)
+	{
+		out.type = Json::BOOLEAN;
+		out.number = 1.0;
+		return p + 4;
+	}
+	if (end - p >= 5 && strncmp(p, "false", 5) == 0)
+	{
+		out.type = Json::BOOLEAN;
+		return p + 5;
+	}
+	if (end - p >= 4 && strncmp(p, "null", 4) == 0)
+		return p + 4;
+	//offsets need doubles, strtod wants the number on its own
+	char number[64];
+	size_t length = 0;
+	while (p + length < end && length < sizeof(number) - 1 &&
+		strchr("+-.eE0123456789", p[length]) != NULL && p[length] != 0)
+		length ++;
+	if (length == 0)
+		return NULL;
+	memcpy(number, p, length);
+	number[length] = 0;
+	out.type = Json::NUMBER;
+	out.number = strtod(number, NULL);
+	return p + length;
+}
+
+//-----------------------------------glTF-----------------------------------//
+
+static bool decodeBase64(const string &text, size_t start, vector<unsigned char> &out){
+	unsigned bits = 0;
+	int count = 0;
+	for (size_t i = start; i < text.size() && text[i] != '='; i ++) {
+		char c = text[i];
+		int value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 :
+			c >= '0' && c <= '9' ? c - '0' + 52 : c == '+' ? 62 : c == '/' ? 63 : -1;
+		if (value < 0)
+			return false;
+		bits = bits << 6 | value;
+		if ((count += 6) >= 8)
+		{
+			count -= 8;
+			out.push_back((unsigned char)(bits >> count));
+		}
+	}
+	return true;
+}
+
+struct GltfBuffer {
+	const unsigned char *data;
+	size_t size;
+	AssetData file;	//external buffers
+	vector<unsigned char> decoded;	//data: URIs
+};
+
+struct Gltf {
+	Json json;
+	vector<GltfBuffer> buffers;
+};
+
+static int componentCount(const string &type){
+	return type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 :
+		type == "VEC4" ? 4 : type == "MAT4" ? 16 : 0;
+}
+
+static int componentBytes(int componentType){
+	switch (componentType) {
+		case 5120: case 5121: return 1;	//byte, unsigned byte
+		case 5122: case 5123: return 2;	//short, unsigned short
+		case 5125: case 5126: return 4;	//unsigned int, float
+		default: return 0;
+	}
+}
+
+//where the elements of an accessor are
+struct GltfView {
+	const unsigned char *data;
+	size_t count, stride;
+	int components, componentType;
+	bool normalized;
+};
+
+static bool accessorView(const Gltf &gltf, const Json *index, GltfView &view){
+	const Json *accessors = gltf.json.get("accessors");
+	const Json *accessor = index && index->type == Json::NUMBER && accessors ?
+		accessors->at(index->index()) : NULL;
+	if (accessor == NULL)
+		return false;
+	const Json *type = accessor->get("type");
+	view.components = type ? componentCount(type->text) : 0;
+	view.componentType = (int)accessor->num("componentType", 0);
+	view.count = accessor->count("count", 0);
+	const Json *normalized = accessor->get("normalized");
+	view.normalized = normalized && normalized->number != 0.0;
+	int bytes = componentBytes(view.componentType);
+	const Json *views = gltf.json.get("bufferViews");
+	const Json *buffer_view = views ? views->at(accessor->count("bufferView", (size_t)-1)) : NULL;
+	//sparse accessors and accessors without a view aren't supported
+	if (view.components == 0 || bytes == 0 || buffer_view == NULL || accessor->get("sparse"))
+		return false;
+	size_t buffer = buffer_view->count("buffer", (size_t)-1);
+	size_t offset = buffer_view->count("byteOffset", 0);
+	size_t length = buffer_view->count("byteLength", 0);
+	size_t element = (size_t)bytes * view.components;
+	view.stride = buffer_view->count("byteStride", 0);
+	if (view.stride == 0)
+		view.stride = element;
+	size_t start = accessor->count("byteOffset", 0);
+	if (buffer >= gltf.buffers.size() || offset > gltf.buffers[buffer].size ||
+		length > gltf.buffers[buffer].size - offset || view.stride < element)
+		return false;
+	//the count is divided into the bytes instead of multiplied, a huge one would wrap
+	if (view.count > 0 && (start > length || element > length - start ||
+		view.count - 1 > (length - start - element) / view.stride))
+		return false;
+	view.data = gltf.buffers[buffer].data + offset + start;
+	return true;
+}
+
+static float component(const unsigned char *p, int componentType, bool normalized){
+	switch (componentType) {
+		case 5126: { float f; memcpy(&f, p, 4); return f; }
+		case 5121: return normalized ? *p / 255.0f : *p;
+		case 5120: return normalized ? max(*(const int8_t *)p / 127.0f, -1.0f) : *(const int8_t *)p;
+		case 5123: { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.0f : v; }
+		case 5122:
+		{
+			int16_t v;
+			memcpy(&v, p, 2);
+			return normalized ? max(v / 32767.0f, -1.0f) : v;
+		}
+		default: { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+	}
+}
+
+//the elements of an accessor as floats, components past its own are 0
+static bool readFloats(const Gltf &gltf, const Json *index, int components, size_t count,
+	vector<float> &out){
+	GltfView view;
+	if (!accessorView(gltf, index, view) || view.count != count)
+		return false;
+	int bytes = componentBytes(view.componentType);
+	if (count > (size_t)-1 / sizeof(float) / components)
+		return false;
+	out.assign(count * components, 0.0f);
+	for (size_t i = 0; i < count; i ++)
+		for (int c = 0; c < components && c < view.components; c ++)
+			out[i * components + c] = component(view.data + i * view.stride + c * bytes,
+				view.componentType, view.normalized);
+	return true;
+}
+
+static bool readIndices(const Gltf &gltf, const Json *index, vector<uint32_t> &out){
+	GltfView view;
+	if (!accessorView(gltf, index, view) || view.components != 1 ||
+		(view.componentType != 5121 && view.componentType != 5123 && view.componentType != 5125))
+		return false;
+	out.resize(view.count);
+	for (size_t i = 0; i < view.count; i ++)
+		out[i] = (uint32_t)component(view.data + i * view.stride, view.componentType, false);
+	//floats are exact up to 2^24, larger 32 bit indices are read again as they are
+	if (view.componentType == 5125)
+		for (size_t i = 0; i < view.count; i ++)
+			memcpy(&out[i], view.data + i * view.stride, 4);
+	return true;
+}
+
+static glm::mat4 nodeMatrix(const Json &node){
+	glm::mat4 matrix;
+	const Json *values = node.get("matrix");
+	if (values != NULL && values->size() == 16)
+	{
+		for (int i = 0; i < 16; i ++)
+			glm::value_ptr(matrix)[i] = (float)values->items[i].number;
+		return matrix;
+	}
+	const Json *t = node.get("translation"), *r = node.get("rotation"), *s = node.get("scale");
+	glm::vec3 translation(0.0f), scale(1.0f);
+	glm::quat rotation;
+	for (int i = 0; i < 3; i ++) {
+		if (t != NULL && t->size() == 3)
+			translation[i] = (float)t->items[i].number;
+		if (s != NULL && s->size() == 3)
+			scale[i] = (float)s->items[i].number;
+	}
+	if (r != NULL && r->size() == 4)
+		rotation = glm::quat((float)r->items[3].number, (float)r->items[0].number,
+			(float)r->items[1].number, (float)r->items[2].number);
+	matrix = glm::translate(glm::mat4(), translation) * glm::mat4_cast(rotation);
+	return glm::scale(matrix, scale);
+}
+
+//a mesh placed by a node
+struct GltfInstance {
+	const Json *mesh;
+	glm::mat4 matrix;
+};
+
+static void collectNodes(const Json &nodes, const Json &meshes, size_t index,
+	const glm::mat4 &parent, int depth, vector<GltfInstance> &out){
+	const Json *node = nodes.at(index);
+	if (node == NULL || depth > 64)
+		return;
+	glm::mat4 matrix = parent * nodeMatrix(*node);
+	const Json *mesh = node->get("mesh");
+	if (mesh != NULL && meshes.at(mesh->index()) != NULL)
+	{
+		GltfInstance instance = {meshes.at(mesh->index()), matrix};
+		out.push_back(instance);
+	}
+	const Json *children = node->get("children");
+	for (size_t i = 0; children != NULL && i < children->size(); i ++)
+		collectNodes(nodes, meshes, children->items[i].index(), matrix, depth + 1, out);
+}
+
+bool MeshImporter::parseGltf(const unsigned char *data, size_t size, const string &directory,
+	MeshData &out){
+	Gltf gltf;
+	const char *json = (const char *)data;
+	size_t json_size = size;
+	const unsigned char *binary = NULL;
+	size_t binary_size = 0;
+	//a .glb is a 12 byte header and chunks of JSON and binary data
+	if (size >= 12 && memcmp(data, "glTF", 4) == 0)
+	{
+		json = NULL;
+		size_t at = 12;
+		while (at + 8 <= size) {
+			uint32_t length, type;
+			memcpy(&length, data + at, 4);
+			memcpy(&type, data + at + 4, 4);
+			if (length > size - at - 8)
+				break;
+			if (type == 0x4E4F534A && json == NULL)
+			{
+				json = (const char *)data + at + 8;
+				json_size = length;
+			}
+			else if (type == 0x004E4942 && binary == NULL)
+			{
+				binary = data + at + 8;
+				binary_size = length;
+			}
+			at += 8 + (length + 3) / 4 * 4;
+		}
+	}
+	if (json == NULL || parseJson(json, json + json_size, gltf.json, 0) == NULL ||
+		gltf.json.type != Json::OBJECT)
+	{
+		cout << "ERROR::MESH_IMPORT::GLTF_INVALID_JSON" << endl;
+		return false;
+	}
+
+	const Json *buffers = gltf.json.get("buffers");
+	//AssetData can't be moved, the buffers are made where they stay
+	vector<GltfBuffer> sized(buffers ? buffers->size() : 0);
+	gltf.buffers.swap(sized);
+	for (size_t i = 0; i < gltf.buffers.size(); i ++) {
+		GltfBuffer &buffer = gltf.buffers[i];
+		const Json *uri = buffers->items[i].get("uri");
+		buffer.data = NULL;
+		buffer.size = 0;
+		if (uri == NULL)
+		{
+			//the binary chunk of a .glb
+			buffer.data = binary;
+			buffer.size = i == 0 ? binary_size : 0;
+		}
+		else if (uri->text.compare(0, 5, "data:") == 0)
+		{
+			size_t comma = uri->text.find(";base64,");
+			if (comma == string::npos || !decodeBase64(uri->text, comma + 8, buffer.decoded))
+			{
+				cout << "ERROR::MESH_IMPORT::GLTF_BAD_DATA_URI: buffer " << i << endl;
+				return false;
+			}
+			buffer.data = buffer.decoded.empty() ? NULL : &buffer.decoded[0];
+			buffer.size = buffer.decoded.size();
+		}
+		else if (Vfs::read(directory + uri->text, buffer.file))
+		{
+			buffer.data = buffer.file.data();
+			buffer.size = buffer.file.size();
+		}
+		else
+		{
+			cout << "ERROR::MESH_IMPORT::FILE_NOT_SUCCESFULLY_READ: " << directory + uri->text
+				<< endl;
+			return false;
+		}
+		buffer.size = min(buffer.size, buffers->items[i].count("byteLength", 0));
+	}
+
+	//the nodes of the default scene with their transforms, or every mesh as it is
+	vector<GltfInstance> instances;
+	const Json *meshes = gltf.json.get("meshes"), *nodes = gltf.json.get("nodes");
+	const Json *scenes = gltf.json.get("scenes");
+	const Json *scene = scenes ? scenes->at(gltf.json.count("scene", 0)) : NULL;
+	const Json *roots = scene ? scene->get("nodes") : NULL;
+	if (meshes != NULL && nodes != NULL && roots != NULL)
+		for (size_t i = 0; i < roots->size(); i ++)
+			collectNodes(*nodes, *meshes, roots->items[i].index(), glm::mat4(), 0,
+				instances);
+	else
+		for (size_t i = 0; meshes != NULL && i < meshes->size(); i ++) {
+			GltfInstance instance = {&meshes->items[i], glm::mat4()};
+			instances.push_back(instance);
+		}
+
+	//the mesh has texture coordinates and normals if any primitive does
+	MeshData mesh;
+	for (size_t i = 0; i < instances.size(); i ++) {
+		const Json *primitives = instances[i].mesh->get("primitives");
+		for (size_t p = 0; primitives != NULL && p < primitives->size(); p ++) {
+			const Json *attributes = primitives->items[p].get("attributes");
+			if (attributes != NULL && attributes->get("TEXCOORD_0"))
+				mesh.layout[MESH_TEXCOORD] = 2;
+			if (attributes != NULL && attributes->get("NORMAL"))
+				mesh.layout[MESH_NORMAL] = 3;
+		}
+	}
+	int stride = mesh.stride();
+	size_t skipped = 0;
+	for (size_t i = 0; i < instances.size(); i ++) {
+		const glm::mat4 &matrix = instances[i].matrix;
+		glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+		//a mirroring transform turns the triangles inside out
+		bool mirrored = glm::determinant(glm::mat3(matrix)) < 0.0f;
+		const Json *primitives = instances[i].mesh->get("primitives");
+		for (size_t p = 0; primitives != NULL && p < primitives->size(); p ++) {
+			const Json &primitive = primitives->items[p];
+			const Json *attributes = primitive.get("attributes");
+			if (primitive.num("mode", 4) != 4 || attributes == NULL ||
+				attributes->get("POSITION") == NULL)
+			{
+				skipped ++;
+				continue;
+			}
+			GltfView position_view;
+			if (!accessorView(gltf, attributes->get("POSITION"), position_view))
+			{
+				cout << "ERROR::MESH_IMPORT::GLTF_BAD_ACCESSOR: POSITION" << endl;
+				return false;
+			}
+			size_t count = position_view.count;
+			vector<float> positions, texcoords, normals;
+			vector<uint32_t> indices;
+			bool ok = readFloats(gltf, attributes->get("POSITION"), 3, count, positions);
+			if (ok && attributes->get("TEXCOORD_0"))
+				ok = readFloats(gltf, attributes->get("TEXCOORD_0"), 2, count, texcoords);
+			if (ok && attributes->get("NORMAL"))
+				ok = readFloats(gltf, attributes->get("NORMAL"), 3, count, normals);
+			if (ok && primitive.get("indices"))
+				ok = readIndices(gltf, primitive.get("indices"), indices);
+			else if (ok)
+				for (size_t v = 0; v < count; v ++)
+					indices.push_back((uint32_t)v);
+			if (!ok)
+			{
+				cout << "ERROR::MESH_IMPORT::GLTF_BAD_ACCESSOR: mesh primitive " << p << endl;
+				return false;
+			}
+
+			size_t base = mesh.vertices.size() / stride;
+			if (base + count > UINT32_MAX)
+			{
+				cout << "ERROR::MESH_IMPORT::TOO_LARGE" << endl;
+				return false;
+			}
+			for (size_t v = 0; v < count; v ++) {
+				glm::vec3 position = glm::vec3(matrix * glm::vec4(positions[v * 3],
+					positions[v * 3 + 1], positions[v * 3 + 2], 1.0f));
+				mesh.vertices.insert(mesh.vertices.end(), &position[0], &position[0] + 3);
+				if (mesh.layout[MESH_TEXCOORD])
+				{
+					float uv[2] = {0.0f, 0.0f};
+					if (!texcoords.empty())
+					{
+						uv[0] = texcoords[v * 2];
+						uv[1] = 1.0f - texcoords[v * 2 + 1];
+					}
+					mesh.vertices.insert(mesh.vertices.end(), uv, uv + 2);
+				}
+				if (mesh.layout[MESH_NORMAL])
+				{
+					glm::vec3 normal(0.0f);
+					if (!normals.empty())
+					{
+						normal = normal_matrix * glm::vec3(normals[v * 3], normals[v * 3 + 1],
+							normals[v * 3 + 2]);
+						if (glm::length(normal) > 0.0f)
+							normal = glm::normalize(normal);
+					}
+					mesh.vertices.insert(mesh.vertices.end(), &normal[0], &normal[0] + 3);
+				}
+			}
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				if (indices[t] >= count || indices[t + 1] >= count || indices[t + 2] >= count)
+				{
+					cout << "ERROR::MESH_IMPORT::GLTF_INDEX_OUT_OF_RANGE" << endl;
+					return false;
+				}
+				mesh.indices.push_back((uint32_t)base + indices[t]);
+				mesh.indices.push_back((uint32_t)base + indices[mirrored ? t + 2 : t + 1]);
+				mesh.indices.push_back((uint32_t)base + indices[mirrored ? t + 1 : t + 2]);
+			}
+		}
+	}
+	if (skipped > 0)
+		cout << "mesh import: skipped " << skipped << " primitives that aren't triangles" << endl;
+	mesh.computeBounds();
+	swap(out, mesh);
+	return true;
+}
+
+//--------------------------------welding-----------------------------------//
+
+void MeshImporter::weld(MeshData &mesh){
+	int stride = mesh.stride();
+	size_t count = mesh.vertexCount();
+	size_t bytes = stride * sizeof(float);
+	vector<uint32_t> table(tableSize(count), EMPTY);
+	size_t mask = table.size() - 1;
+	vector<uint32_t> remap(count);
+	vector<float> welded;
+	welded.reserve(mesh.vertices.size());
+	for (size_t v = 0; v < count; v ++) {
+		const float *vertex = &mesh.vertices[v * stride];
+		size_t slot = hash64(vertex, bytes) & mask;
+		while (table[slot] != EMPTY && memcmp(&welded[(size_t)table[slot] * stride], vertex,
+			bytes) != 0)
+			slot = (slot + 1) & mask;
+		if (table[slot] == EMPTY)
+		{
+			table[slot] = (uint32_t)(welded.size() / stride);
+			welded.insert(welded.end(), vertex, vertex + stride);
+		}
+		remap[v] = table[slot];
+	}
+	//triangles that lost a corner to the welding draw nothing
+	size_t kept = 0;
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+		uint32_t a = remap[mesh.indices[t]], b = remap[mesh.indices[t + 1]];
+		uint32_t c = remap[mesh.indices[t + 2]];
+		if (a == b || b == c || a == c)
+			continue;
+		mesh.indices[kept ++] = a;
+		mesh.indices[kept ++] = b;
+		mesh.indices[kept ++] = c;
+	}
+	mesh.indices.resize(kept);
+	mesh.vertices.swap(welded);
+}
+
+//-------------------------------optimizing---------------------------------//
+
+void MeshImporter::optimize(MeshData &mesh, int cacheSize){
+	size_t count = mesh.vertexCount();
+	size_t triangles = mesh.indices.size() / 3;
+	const vector<uint32_t> &indices = mesh.indices;
+	//triangles of every vertex
+	vector<uint32_t> offsets(count + 1, 0), adjacency(triangles * 3);
+	for (size_t i = 0; i < triangles * 3; i ++)
+		offsets[indices[i] + 1] ++;
+	for (size_t v = 0; v < count; v ++)
+		offsets[v + 1] += offsets[v];
+	vector<uint32_t> live(count), fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangles * 3; i ++)
+		adjacency[fill[indices[i]] ++] = (uint32_t)(i / 3);
+	for (size_t v = 0; v < count; v ++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	vector<uint32_t> stamps(count, 0), dead_ends, candidates, ordered;
+	vector<bool> emitted(triangles, false);
+	ordered.reserve(triangles * 3);
+	long fan = count > 0 ? 0 : -1;
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	while (fan >= 0) {
+		candidates.clear();
+		//every triangle around the fanning vertex
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a ++) {
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+			for (int c = 0; c < 3; c ++) {
+				uint32_t v = indices[t * 3 + c];
+				ordered.push_back(v);
+				dead_ends.push_back(v);
+				candidates.push_back(v);
+				live[v] --;
+				if (time - stamps[v] > (uint32_t)cacheSize)
+					stamps[v] = time ++;
+			}
+			emitted[t] = true;
+		}
+		//the candidate that is still in the cache and will be the longest
+		fan = -1;
+		long best = -1;
+		for (size_t i = 0; i < candidates.size(); i ++) {
+			uint32_t v = candidates[i];
+			if (live[v] == 0)
+				continue;
+			long priority = 0;
+			if (time - stamps[v] + 2 * live[v] <= (uint32_t)cacheSize)
+				priority = time - stamps[v];
+			if (priority > best)
+			{
+				best = priority;
+				fan = v;
+			}
+		}
+		//a dead end, go back to a recent vertex or on to the next one with triangles left
+		while (fan < 0 && !dead_ends.empty()) {
+			uint32_t v = dead_ends.back();
+			dead_ends.pop_back();
+			if (live[v] > 0)
+				fan = v;
+		}
+		for (; fan < 0 && cursor < count; cursor ++)
+			if (live[cursor] > 0)
+				fan = (long)cursor;
+	}
+
+	//vertices in the order they are first used, unused ones are dropped
+	int stride = mesh.stride();
+	vector<uint32_t> remap(count, EMPTY);
+	vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	uint32_t next = 0;
+	for (size_t i = 0; i < ordered.size(); i ++) {
+		uint32_t &target = remap[ordered[i]];
+		if (target == EMPTY)
+		{
+			target = next ++;
+			const float *vertex = &mesh.vertices[(size_t)ordered[i] * stride];
+			vertices.insert(vertices.end(), vertex, vertex + stride);
+		}
+		ordered[i] = target;
+	}
+	mesh.indices.swap(ordered);
+	mesh.vertices.swap(vertices);
+}
+
+double MeshImporter::acmr(const vector<uint32_t> &indices, int cacheSize){
+	if (indices.size() < 3)
+		return 0.0;
+	uint32_t largest = *max_element(indices.begin(), indices.end());
+	//a vertex is in the FIFO if it was loaded within the last cacheSize misses
+	vector<size_t> loaded(largest + 1, SIZE_MAX);
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i ++) {
+		size_t &at = loaded[indices[i]];
+		if (at == SIZE_MAX || misses - at > (size_t)cacheSize)
+			at = misses ++;
+	}
+	return (double)misses / (indices.size() / 3);
+}
+
+//--------------------------------importing---------------------------------//
+
+bool MeshImporter::import(const char *path, MeshData &out, MeshImportStats *stats,
+	int threads){
+	if (threads <= 0)
+		threads = max(1, (int)thread::hardware_concurrency());
+	string name = path;
+	size_t dot = name.rfind('.');
+	string extension = dot == string::npos ? "" : name.substr(dot + 1);
+	for (size_t i = 0; i < extension.size(); i ++)
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	AssetData data;
+	if (!Vfs::read(path, data))
+	{
+		cout << "ERROR::MESH_IMPORT::FILE_NOT_SUCCESFULLY_READ: " << path << endl;
+		return false;
+	}
+
+	MeshImportStats result;
+	memset(&result, 0, sizeof(result));
+	result.sourceBytes = data.size();
+	result.threads = extension == "obj" && data.size() >= PARALLEL_MIN_BYTES ? threads : 1;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool ok;
+	if (extension == "obj")
+		ok = parseObj((const char *)data.data(), data.size(), out, threads);
+	else if (extension == "gltf" || extension == "glb")
+	{
+		size_t slash = name.find_last_of("/\\");
+		ok = parseGltf(data.data(), data.size(),
+			slash == string::npos ? "" : name.substr(0, slash + 1), out);
+	}
+	else
+	{
+		cout << "ERROR::MESH_IMPORT::UNKNOWN_FORMAT: " << path << endl;
+		return false;
+	}
+	if (!ok)
+		return false;
+	result.parseSeconds = seconds(start);
+	result.corners = out.indices.size();
+
+	start = chrono::steady_clock::now();
+	weld(out);
+	result.weldSeconds = seconds(start);
+	result.acmrBefore = acmr(out.indices);
+	start = chrono::steady_clock::now();
+	optimize(out);
+	result.optimizeSeconds = seconds(start);
+	result.acmrAfter = acmr(out.indices);
+	out.computeBounds();
+	result.vertices = out.vertexCount();
+	result.triangles = out.indices.size() / 3;
+	if (stats != NULL)
+		*stats = result;
+	return true;
+}
+
+void MeshImportStats::report(ostream &out) const {
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1) << "mesh import: " << triangles << " triangles, "
+		<< vertices << " vertices from " << corners << " corners, parsed "
+		<< sourceBytes / 1048576.0 << " MB in " << parseSeconds * 1000.0 << " ms ("
+		<< (parseSeconds > 0.0 ? sourceBytes / 1048576.0 / parseSeconds : 0.0) << " MB/s, "
+		<< threads << " threads), welded in " << weldSeconds * 1000.0 << " ms, optimized in "
+		<< optimizeSeconds * 1000.0 << " ms, " << setprecision(2) << acmrBefore << " -> "
+		<< acmrAfter << " cache misses per triangle" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,395 @@
+//this file contains the CPU mipmap builder
+#include "../include/mip_builder.h"
+#include "../include/job_system.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+//the Kaiser filter reaches KAISER_WIDTH texels of the smaller level on each side
+static const float KAISER_WIDTH = 3.0f;
+static const float KAISER_ALPHA = 4.0f;
+//linear to sRGB table, fine enough that dark values round like the exact curve
+static const int LINEAR_STEPS = 16384;
+//levels smaller than this are filtered on the calling thread only
+static const int PARALLEL_MIN_PIXELS = 128 * 128;
+//rows a thread takes at a time
+static const int BAND_ROWS = 8;
+//most a level's alpha is scaled up to keep its coverage
+static const float MAX_ALPHA_SCALE = 4.0f;
+
+struct Tables {
+	float srgbToLinear[256];
+	float unorm[256];
+	unsigned char linearToSrgb[LINEAR_STEPS + 1];
+	Tables(){
+		for (int i = 0; i < 256; i ++) {
+			float c = i / 255.0f;
+			srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			unorm[i] = c;
+		}
+		for (int i = 0; i <= LINEAR_STEPS; i ++) {
+			float l = (float)i / LINEAR_STEPS;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			linearToSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+	}
+};
+
+//built on first use, function statics are thread safe
+static const Tables &tables(){
+	static Tables instance;
+	return instance;
+}
+
+//source texels of a level, every texel is 4 floats. Level 0 is converted from 8 bit
+//one row at a time instead of keeping a float copy of the largest level
+struct Source {
+	int width, height;
+	const float *texels;	//levels below 0
+	const unsigned char *bytes;	//level 0
+	int stride, channels;
+	const float *tables[4];	//byte to float table of each channel
+
+	const float *row(int y, float *scratch) const {
+		if (texels != NULL)
+			return texels + (size_t)y * width * 4;
+		const unsigned char *in = bytes + (size_t)y * stride;
+		for (int x = 0; x < width; x ++, in += channels, scratch += 4) {
+			scratch[0] = scratch[1] = scratch[2] = scratch[3] = 0.0f;
+			for (int c = 0; c < channels; c ++)
+				scratch[c] = tables[c][in[c]];
+		}
+		return scratch - width * 4;
+	}
+};
+
+//weights of a 1D resampling, the texels of destination i are
+//first[i] .. first[i] + count[i] - 1, weights are stored with a stride of maxCount
+struct Taps {
+	vector<int> first, count;
+	vector<float> weights;
+	int maxCount;
+};
+
+static float sinc(float x){
+	if (fabsf(x) < 1e-6f)
+		return 1.0f;
+	x *= 3.14159265f;
+	return sinf(x) / x;
+}
+
+//zeroth order modified Bessel function of the first kind
+static float bessel0(float x){
+	float sum = 1.0f, term = 1.0f;
+	for (int k = 1; k < 32 && term > sum * 1e-8f; k ++) {
+		term *= (x * x * 0.25f) / (k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+//windowed sinc, t in texels of the smaller level
+static float kaiser(float t){
+	float r = t / KAISER_WIDTH;
+	if (r * r >= 1.0f)
+		return 0.0f;
+	return sinc(t) * bessel0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / bessel0(KAISER_ALPHA);
+}
+
+static void buildTaps(int src, int dst, MipFilter filter, Taps &taps){
+	float ratio = (float)src / dst;
+	vector<vector<float> > weights(dst);
+	taps.first.resize(dst);
+	taps.count.resize(dst);
+	taps.maxCount = 1;
+	for (int i = 0; i < dst; i ++) {
+		float lo, hi;
+		if (src == dst)
+			lo = (float)i, hi = i + 1.0f;
+		else if (filter == MIP_BOX)
+			lo = i * ratio, hi = (i + 1) * ratio;
+		else
+		{
+			float center = (i + 0.5f) * ratio;
+			lo = center - KAISER_WIDTH * ratio;
+			hi = center + KAISER_WIDTH * ratio;
+		}
+		int first = (int)floorf(lo), last = (int)ceilf(hi) - 1;
+		//texels past the edge repeat the edge texel, so their weight goes to it
+		int clamp_first = max(0, first), clamp_last = min(src - 1, last);
+		vector<float> &w = weights[i];
+		w.assign(clamp_last - clamp_first + 1, 0.0f);
+		float total = 0.0f;
+		for (int s = first; s <= last; s ++) {
+			float weight;
+			if (src == dst)
+				weight = 1.0f;
+			else if (filter == MIP_BOX)
+				weight = max(0.0f, min(hi, s + 1.0f) - max(lo, (float)s));
+			else
+				weight = kaiser((s + 0.5f - (i + 0.5f) * ratio) / ratio);
+			w[min(max(s, 0), src - 1) - clamp_first] += weight;
+			total += weight;
+		}
+		for (size_t k = 0; k < w.size(); k ++)
+			w[k] /= total;
+		taps.first[i] = clamp_first;
+		taps.count[i] = (int)w.size();
+		taps.maxCount = max(taps.maxCount, taps.count[i]);
+	}
+	taps.weights.assign((size_t)dst * taps.maxCount, 0.0f);
+	for (int i = 0; i < dst; i ++)
+		memcpy(&taps.weights[(size_t)i * taps.maxCount], &weights[i][0],
+			weights[i].size() * sizeof(float));
+}
+
+//resample one row horizontally, one texel (4 channels) per SSE register
+static void filterRow(const float *src, const Taps &taps, int width, float *dst){
+	for (int x = 0; x < width; x ++, dst += 4) {
+		const float *w = &taps.weights[(size_t)x * taps.maxCount];
+		const float *s = src + (size_t)taps.first[x] * 4;
+		int count = taps.count[x];
+#ifdef __SSE2__
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < count; k ++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(s + k * 4)));
+		_mm_storeu_ps(dst, sum);
+#else
+		float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		for (int k = 0; k < count; k ++)
+			for (int c = 0; c < 4; c ++)
+				sum[c] += w[k] * s[k * 4 + c];
+		memcpy(dst, sum, sizeof(sum));
+#endif
+	}
+}
+
+//weighted sum of count rows of n floats
+static void blendRows(const float *const *rows, const float *weights, int count, int n,
+	float *dst){
+	int i = 0;
+#ifdef __AVX__
+	for (; i + 8 <= n; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < count; k ++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]),
+				_mm256_loadu_ps(rows[k] + i)));
+		_mm256_storeu_ps(dst + i, sum);
+	}
+#endif
+#ifdef __SSE2__
+	for (; i + 4 <= n; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < count; k ++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+		_mm_storeu_ps(dst + i, sum);
+	}
+#endif
+	for (; i < n; i ++) {
+		float sum = 0.0f;
+		for (int k = 0; k < count; k ++)
+			sum += weights[k] * rows[k][i];
+		dst[i] = sum;
+	}
+}
+
+//the caller works too, like the other thread pools of the project. Every copy of work
+//takes bands until none is left, the job system runs them when it is up
+static void runThreads(int threads, const function<void()> &work){
+	if (JobSystem::running() && threads > 1)
+	{
+		JobSystem::parallelFor(0, min(threads, JobSystem::threads()),
+			[&](size_t, size_t) { work(); }, 1);
+		return;
+	}
+	vector<thread> workers;
+	for (int t = 1; t < threads; t ++)
+		workers.push_back(thread(work));
+	work();
+	for (size_t t = 0; t < workers.size(); t ++)
+		workers[t].join();
+}
+
+static int levelThreads(int threads, int width, int height){
+	if (width * height < PARALLEL_MIN_PIXELS)
+		return 1;
+	return max(1, min(threads, (height + BAND_ROWS - 1) / BAND_ROWS));
+}
+
+//filter a level of width x height texels from source
+static void filterLevel(const Source &source, int width, int height, MipFilter filter,
+	int threads, vector<float> &out){
+	Taps horizontal, vertical;
+	buildTaps(source.width, width, filter, horizontal);
+	buildTaps(source.height, height, filter, vertical);
+	out.resize((size_t)width * height * 4);
+
+	atomic<int> next_band(0);
+	runThreads(levelThreads(threads, width, height), [&]() {
+		//horizontally filtered source rows, consecutive output rows share most of them
+		int slots = vertical.maxCount;
+		vector<float> cache((size_t)slots * width * 4);
+		vector<int> cached_row(slots, -1);
+		vector<float> scratch((size_t)source.width * 4);
+		vector<const float *> rows(slots);
+		for (int band = next_band++; band * BAND_ROWS < height; band = next_band++) {
+			int end = min(height, (band + 1) * BAND_ROWS);
+			for (int y = band * BAND_ROWS; y < end; y ++) {
+				for (int k = 0; k < vertical.count[y]; k ++) {
+					int sy = vertical.first[y] + k, slot = sy % slots;
+					float *row = &cache[(size_t)slot * width * 4];
+					if (cached_row[slot] != sy)
+					{
+						filterRow(source.row(sy, &scratch[0]), horizontal, width, row);
+						cached_row[slot] = sy;
+					}
+					rows[k] = row;
+				}
+				blendRows(&rows[0], &vertical.weights[(size_t)y * vertical.maxCount],
+					vertical.count[y], width * 4, &out[(size_t)y * width * 4]);
+			}
+		}
+	});
+}
+
+//scale for the alpha of a level so that the fraction of texels over the cutoff
+//matches target. Texels are tested the way the GPU sees them, after rounding to 8 bit:
+//a texel passes when alpha * scale reaches threshold, so the scale follows from the
+//alpha of the texel at the target quantile.
+static float coverageScale(const vector<float> &texels, int alpha, float cutoff,
+	double target){
+	size_t count = texels.size() / 4;
+	size_t needed = (size_t)ceil(target * count - 1e-9);
+	if (needed == 0)
+		return 0.0f;
+	vector<float> alphas(count);
+	for (size_t i = 0; i < count; i ++)
+		alphas[i] = texels[i * 4 + alpha];
+	nth_element(alphas.begin(), alphas.begin() + (count - needed), alphas.end());
+	float quantile = alphas[count - needed];
+	//texels with the same alpha all pass or all fail, keep them out when that is
+	//closer to the target
+	size_t above = 0, equal = 0;
+	for (size_t i = 0; i < count; i ++) {
+		above += alphas[i] > quantile;
+		equal += alphas[i] == quantile;
+	}
+	bool exclude = target * count - above < above + equal - target * count;
+	//smallest 8 bit value over the cutoff, and the alpha that rounds to it
+	float threshold = ((int)floorf(cutoff * 255.0f) + 0.5f) / 255.0f;
+	if (quantile * MAX_ALPHA_SCALE <= threshold)
+		return MAX_ALPHA_SCALE;
+	return threshold / quantile * (exclude ? 1.0f - 1e-5f : 1.0f + 1e-5f);
+}
+
+//store a filtered level as 8 bit
+static void storeLevel(const vector<float> &texels, int channels, bool srgb, int alpha,
+	float alpha_scale, int threads, MipLevel &level){
+	const Tables &table = tables();
+	atomic<int> next_band(0);
+	runThreads(levelThreads(threads, level.width, level.height), [&]() {
+		for (int band = next_band++; band * BAND_ROWS < level.height; band = next_band++) {
+			int end = min(level.height, (band + 1) * BAND_ROWS);
+			for (int y = band * BAND_ROWS; y < end; y ++) {
+				const float *in = &texels[(size_t)y * level.width * 4];
+				unsigned char *out = &level.pixels[(size_t)y * level.stride];
+				for (int x = 0; x < level.width; x ++, in += 4, out += channels)
+					for (int c = 0; c < channels; c ++) {
+						float v = c == alpha ? in[c] * alpha_scale : in[c];
+						v = min(1.0f, max(0.0f, v));
+						if (srgb && c != alpha)
+							out[c] = table.linearToSrgb[(int)(v * LINEAR_STEPS + 0.5f)];
+						else
+							out[c] = (unsigned char)(v * 255.0f + 0.5f);
+					}
+			}
+		}
+	});
+}
+
+void MipBuilder::build(const unsigned char *pixels, int width, int height, int stride,
+	int channels, vector<MipLevel> &levels, const MipOptions &options, MipStats *stats){
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const Tables &table = tables();
+	int threads = options.threads;
+	if (threads <= 0)
+		threads = max(1u, thread::hardware_concurrency());
+	int alpha = channels == 2 || channels == 4 ? channels - 1 : -1;
+
+	Source source;
+	source.width = width;
+	source.height = height;
+	source.texels = NULL;
+	source.bytes = pixels;
+	source.stride = stride;
+	source.channels = channels;
+	for (int c = 0; c < 4; c ++)
+		source.tables[c] = options.srgb && c != alpha ? table.srgbToLinear : table.unorm;
+
+	//fraction of level 0 that passes the alpha test
+	bool keep_coverage = options.alphaCutoff > 0.0f && alpha >= 0;
+	double coverage = 0.0;
+	if (keep_coverage)
+	{
+		size_t passed = 0;
+		for (int y = 0; y < height; y ++)
+			for (int x = 0; x < width; x ++)
+				passed += pixels[(size_t)y * stride + x * channels + alpha] / 255.0f >
+					options.alphaCutoff;
+		coverage = (double)passed / ((size_t)width * height);
+	}
+
+	levels.clear();
+	levels.reserve(levelCount(width, height) - 1);
+	vector<float> current, next;
+	while (source.width > 1 || source.height > 1) {
+		int level_width = max(1, source.width / 2), level_height = max(1, source.height / 2);
+		filterLevel(source, level_width, level_height, options.filter, threads, next);
+
+		float alpha_scale = 1.0f;
+		if (keep_coverage)
+			alpha_scale = coverageScale(next, alpha, options.alphaCutoff, coverage);
+		levels.push_back(MipLevel());
+		MipLevel &level = levels.back();
+		level.width = level_width;
+		level.height = level_height;
+		level.stride = (level_width * channels + options.alignment - 1) / options.alignment *
+			options.alignment;
+		level.pixels.assign((size_t)level.stride * level_height, 0);
+		storeLevel(next, channels, options.srgb, alpha, alpha_scale, threads, level);
+
+		//the next level is filtered from the unscaled floats
+		current.swap(next);
+		source.width = level_width;
+		source.height = level_height;
+		source.texels = &current[0];
+	}
+
+	if (stats != NULL)
+	{
+		stats->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		stats->mpixelsPerSecond = stats->seconds > 0.0 ?
+			(double)width * height / 1e6 / stats->seconds : 0.0;
+	}
+}
+
+int MipBuilder::levelCount(int width, int height){
+	int levels = 1;
+	while (width > 1 || height > 1) {
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+		levels ++;
+	}
+	return levels;
+}
@@ -0,0 +1,359 @@
+//this file contains the tiled depth buffer of the CPU occlusion culler
+#include "../include/occlusion_culler.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+typedef chrono::steady_clock Clock;
+
+const int OcclusionCuller::TILE_WIDTH;
+const int OcclusionCuller::TILE_HEIGHT;
+
+static double secondsSince(Clock::time_point start){
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, int threads){
+	_tiles_x = max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+	_tiles_y = max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+	_width = _tiles_x * TILE_WIDTH;
+	_height = _tiles_y * TILE_HEIGHT;
+	_depth.assign((size_t)_width * _height, 0.0f);
+	_tile_far.assign((size_t)_tiles_x * _tiles_y, 0.0f);
+	memset(&_stats, 0, sizeof(_stats));
+	_generation = 0;
+	_running = 0;
+	_quit = false;
+
+	if (threads <= 0)
+		threads = max(1u, thread::hardware_concurrency());
+	//every thread needs a row of tiles
+	threads = min(threads, _tiles_y);
+	for (int t = 1; t < threads; t ++)
+		_workers.push_back(thread(&OcclusionCuller::workerLoop, this, t));
+}
+
+OcclusionCuller::~OcclusionCuller(){
+	{
+		lock_guard<mutex> guard(_lock);
+		_quit = true;
+	}
+	_start.notify_all();
+	for (size_t t = 0; t < _workers.size(); t ++)
+		_workers[t].join();
+}
+
+void OcclusionCuller::begin(const glm::mat4 &viewProj){
+	_view_proj = viewProj;
+	_triangles.clear();
+	_stats.frames ++;
+}
+
+//-------------------------------occluders----------------------------------//
+
+void OcclusionCuller::addOccluder(const float *positions, int vertexCount, int stride,
+	const glm::mat4 &model){
+	glm::mat4 mvp = _view_proj * model;
+	for (int v = 0; v + 2 < vertexCount; v += 3) {
+		glm::vec4 clip[3];
+		for (int i = 0; i < 3; i ++) {
+			const float *p = positions + (size_t)(v + i) * stride;
+			clip[i] = mvp * glm::vec4(p[0], p[1], p[2], 1.0f);
+		}
+		//cut the triangle at the near plane, z >= -w, it may become a quad
+		glm::vec4 poly[4];
+		int count = 0;
+		for (int i = 0; i < 3; i ++) {
+			const glm::vec4 &a = clip[i], &b = clip[(i + 1) % 3];
+			float da = a.z + a.w, db = b.z + b.w;
+			if (da >= 0.0f)
+				poly[count ++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+				poly[count ++] = a + (b - a) * (da / (da - db));
+		}
+		if (count >= 3)
+			addClipped(poly, count);
+	}
+}
+
+void OcclusionCuller::addClipped(const glm::vec4 *clip, int count){
+	float x[4], y[4], z[4];
+	for (int i = 0; i < count; i ++) {
+		if (clip[i].w <= 0.0f)
+			return;
+		float inverse_w = 1.0f / clip[i].w;
+		x[i] = (clip[i].x * inverse_w * 0.5f + 0.5f) * _width;
+		y[i] = (clip[i].y * inverse_w * 0.5f + 0.5f) * _height;
+		z[i] = inverse_w;
+	}
+	//fan of the clipped polygon
+	for (int i = 1; i + 1 < count; i ++) {
+		int index[3] = {0, i, i + 1};
+		Triangle triangle;
+		bool left = true, right = true, below = true, above = true;
+		for (int k = 0; k < 3; k ++) {
+			triangle.x[k] = x[index[k]];
+			triangle.y[k] = y[index[k]];
+			triangle.z[k] = z[index[k]];
+			left = left && triangle.x[k] < 0.0f;
+			right = right && triangle.x[k] > _width;
+			below = below && triangle.y[k] < 0.0f;
+			above = above && triangle.y[k] > _height;
+		}
+		if (!(left || right || below || above))
+			_triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize(){
+	Clock::time_point start = Clock::now();
+	{
+		lock_guard<mutex> guard(_lock);
+		_generation ++;
+		_running = (int)_workers.size();
+	}
+	_start.notify_all();
+	rasterizeBand(0);
+	{
+		unique_lock<mutex> guard(_lock);
+		_done.wait(guard, [this]() { return _running == 0; });
+	}
+	_stats.occluderTriangles += _triangles.size();
+	_stats.rasterSeconds += secondsSince(start);
+}
+
+void OcclusionCuller::workerLoop(int band){
+	unsigned seen = 0;
+	for (;;) {
+		{
+			unique_lock<mutex> guard(_lock);
+			_start.wait(guard, [&]() { return _quit || _generation != seen; });
+			if (_quit)
+				return;
+			seen = _generation;
+		}
+		rasterizeBand(band);
+		lock_guard<mutex> guard(_lock);
+		if (-- _running == 0)
+			_done.notify_all();
+	}
+}
+
+//keep the larger 1 / w, the closer surface, of 8 pixels where they are covered
+static void depthRow(float *row, float e0, float e1, float e2, float a0, float a1, float a2,
+	float z, float dz){
+#if defined(__AVX__)
+	const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e0),
+		_mm256_mul_ps(_mm256_set1_ps(a0), lanes)), zero, _CMP_GE_OQ);
+	inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e1),
+		_mm256_mul_ps(_mm256_set1_ps(a1), lanes)), zero, _CMP_GE_OQ));
+	inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e2),
+		_mm256_mul_ps(_mm256_set1_ps(a2), lanes)), zero, _CMP_GE_OQ));
+	__m256 depth = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(_mm256_set1_ps(dz), lanes));
+	//pixels outside get 0, which never wins
+	_mm256_storeu_ps(row, _mm256_max_ps(_mm256_loadu_ps(row), _mm256_and_ps(inside, depth)));
+#elif defined(__SSE2__)
+	for (int half = 0; half < 2; half ++) {
+		const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		float offset = 4.0f * half;
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e0 + a0 * offset),
+			_mm_mul_ps(_mm_set1_ps(a0), lanes)), _mm_setzero_ps());
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e1 + a1 * offset),
+			_mm_mul_ps(_mm_set1_ps(a1), lanes)), _mm_setzero_ps()));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e2 + a2 * offset),
+			_mm_mul_ps(_mm_set1_ps(a2), lanes)), _mm_setzero_ps()));
+		__m128 depth = _mm_add_ps(_mm_set1_ps(z + dz * offset), _mm_mul_ps(_mm_set1_ps(dz), lanes));
+		float *p = row + 4 * half;
+		_mm_storeu_ps(p, _mm_max_ps(_mm_loadu_ps(p), _mm_and_ps(inside, depth)));
+	}
+#else
+	for (int i = 0; i < OcclusionCuller::TILE_WIDTH; i ++)
+		if (e0 + a0 * i >= 0.0f && e1 + a1 * i >= 0.0f && e2 + a2 * i >= 0.0f)
+			row[i] = max(row[i], z + dz * i);
+#endif
+}
+
+void OcclusionCuller::rasterizeBand(int band){
+	int bands = threads();
+	int tile_y0 = band * _tiles_y / bands, tile_y1 = (band + 1) * _tiles_y / bands;
+	int band_y0 = tile_y0 * TILE_HEIGHT, band_y1 = tile_y1 * TILE_HEIGHT;
+	const int tile_size = TILE_WIDTH * TILE_HEIGHT;
+	fill(_depth.begin() + (size_t)tile_y0 * _tiles_x * tile_size,
+		_depth.begin() + (size_t)tile_y1 * _tiles_x * tile_size, 0.0f);
+
+	for (size_t t = 0; t < _triangles.size(); t ++) {
+		const Triangle &tri = _triangles[t];
+		//clamp before converting, vertices close to the near plane are far off screen
+		int x0 = (int)max(0.0f, floor(min(tri.x[0], min(tri.x[1], tri.x[2]))));
+		int x1 = (int)min((float)_width, ceil(max(tri.x[0], max(tri.x[1], tri.x[2]))));
+		int y0 = (int)max((float)band_y0, floor(min(tri.y[0], min(tri.y[1], tri.y[2]))));
+		int y1 = (int)min((float)band_y1, ceil(max(tri.y[0], max(tri.y[1], tri.y[2]))));
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		//set up in double, vertices far outside the buffer would lose the pixels
+		double vx[3] = {tri.x[0], tri.x[1], tri.x[2]};
+		double vy[3] = {tri.y[0], tri.y[1], tri.y[2]};
+		double area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vx[2] - vx[0]) * (vy[1] - vy[0]);
+		if (fabs(area) < 1e-12)
+			continue;
+		int order[3] = {0, 1, 2};
+		if (area < 0.0)
+		{
+			//clockwise, walk the edges the other way
+			order[1] = 2;
+			order[2] = 1;
+		}
+		//edge i is positive inside, shifted by half a pixel so that it is only
+		//positive where the whole pixel is inside
+		double a[3], b[3], c[3];
+		for (int i = 0; i < 3; i ++) {
+			int from = order[i], to = order[(i + 1) % 3];
+			a[i] = -(vy[to] - vy[from]);
+			b[i] = vx[to] - vx[from];
+			c[i] = -(a[i] * vx[from] + b[i] * vy[from]) - 0.5 * (fabs(a[i]) + fabs(b[i]));
+		}
+		//plane of 1 / w, lowered to the farthest value it takes in a pixel
+		double z10 = (double)tri.z[1] - tri.z[0], z20 = (double)tri.z[2] - tri.z[0];
+		double dzdx = (z10 * (vy[2] - vy[0]) - z20 * (vy[1] - vy[0])) / area;
+		double dzdy = (z20 * (vx[1] - vx[0]) - z10 * (vx[2] - vx[0])) / area;
+		double z0 = tri.z[0] - dzdx * vx[0] - dzdy * vy[0] - 0.5 * (fabs(dzdx) + fabs(dzdy));
+
+		for (int ty = y0 / TILE_HEIGHT; ty <= (y1 - 1) / TILE_HEIGHT; ty ++)
+			for (int tx = x0 / TILE_WIDTH; tx <= (x1 - 1) / TILE_WIDTH; tx ++) {
+				float *tile = &_depth[((size_t)ty * _tiles_x + tx) * tile_size];
+				for (int r = 0; r < TILE_HEIGHT; r ++) {
+					int py = ty * TILE_HEIGHT + r;
+					if (py < y0 || py >= y1)
+						continue;
+					//pixel centers
+					double px = tx * TILE_WIDTH + 0.5, cy = py + 0.5;
+					depthRow(tile + r * TILE_WIDTH,
+						(float)(a[0] * px + b[0] * cy + c[0]), (float)(a[1] * px + b[1] * cy + c[1]),
+						(float)(a[2] * px + b[2] * cy + c[2]), (float)a[0], (float)a[1], (float)a[2],
+						(float)(z0 + dzdx * px + dzdy * cy), (float)dzdx);
+				}
+			}
+	}
+
+	//the farthest depth of each tile lets visible() skip whole tiles
+	for (int ty = tile_y0; ty < tile_y1; ty ++)
+		for (int tx = 0; tx < _tiles_x; tx ++) {
+			size_t index = (size_t)ty * _tiles_x + tx;
+			const float *tile = &_depth[index * tile_size];
+			_tile_far[index] = *min_element(tile, tile + tile_size);
+		}
+}
+
+//-------------------------------occludees----------------------------------//
+
+bool OcclusionCuller::visible(const glm::vec3 &min_corner, const glm::vec3 &max_corner){
+	Clock::time_point start = Clock::now();
+	_stats.tested ++;
+	float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f, closest = 0.0f;
+	bool in_front = true;
+	for (int i = 0; i < 8 && in_front; i ++) {
+		glm::vec4 corner(i & 1 ? max_corner.x : min_corner.x, i & 2 ? max_corner.y : min_corner.y,
+			i & 4 ? max_corner.z : min_corner.z, 1.0f);
+		glm::vec4 clip = _view_proj * corner;
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+		{
+			in_front = false;
+			break;
+		}
+		float inverse_w = 1.0f / clip.w;
+		float x = (clip.x * inverse_w * 0.5f + 0.5f) * _width;
+		float y = (clip.y * inverse_w * 0.5f + 0.5f) * _height;
+		x0 = min(x0, x);
+		x1 = max(x1, x);
+		y0 = min(y0, y);
+		y1 = max(y1, y);
+		closest = max(closest, inverse_w);
+	}
+	//the box reaches the near plane, nothing in front of it can hide it all
+	if (!in_front)
+	{
+		_stats.testSeconds += secondsSince(start);
+		return true;
+	}
+
+	//every pixel the rectangle touches
+	int px0 = (int)max(0.0f, floor(x0)), px1 = (int)min((float)_width, ceil(x1));
+	int py0 = (int)max(0.0f, floor(y0)), py1 = (int)min((float)_height, ceil(y1));
+	if (px0 >= px1 || py0 >= py1)
+	{
+		//off screen, that is up to frustum culling
+		_stats.testSeconds += secondsSince(start);
+		return true;
+	}
+
+	bool hidden = true;
+	const int tile_size = TILE_WIDTH * TILE_HEIGHT;
+	for (int ty = py0 / TILE_HEIGHT; ty <= (py1 - 1) / TILE_HEIGHT && hidden; ty ++)
+		for (int tx = px0 / TILE_WIDTH; tx <= (px1 - 1) / TILE_WIDTH && hidden; tx ++) {
+			size_t index = (size_t)ty * _tiles_x + tx;
+			//every occluder in the tile is closer than the box
+			if (_tile_far[index] > closest)
+				continue;
+			const float *tile = &_depth[index * tile_size];
+			int cx0 = max(px0 - tx * TILE_WIDTH, 0), cx1 = min(px1 - tx * TILE_WIDTH, TILE_WIDTH);
+			for (int r = 0; r < TILE_HEIGHT && hidden; r ++) {
+				int py = ty * TILE_HEIGHT + r;
+				if (py < py0 || py >= py1)
+					continue;
+				const float *row = tile + r * TILE_WIDTH;
+#ifdef __SSE2__
+				//lanes of the row inside the rectangle where the box is in front
+				for (int half = 0; half < TILE_WIDTH && hidden; half += 4) {
+					const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+					__m128 column = _mm_add_ps(_mm_set1_ps((float)half), lanes);
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(column, _mm_set1_ps((float)cx0)),
+						_mm_cmplt_ps(column, _mm_set1_ps((float)cx1)));
+					__m128 behind = _mm_cmple_ps(_mm_loadu_ps(row + half), _mm_set1_ps(closest));
+					if (_mm_movemask_ps(_mm_and_ps(inside, behind)) != 0)
+						hidden = false;
+				}
+#else
+				for (int x = cx0; x < cx1; x ++)
+					if (row[x] <= closest)
+						hidden = false;
+#endif
+			}
+		}
+	if (hidden)
+		_stats.occluded ++;
+	_stats.testSeconds += secondsSince(start);
+	return !hidden;
+}
+
+float OcclusionCuller::depth(int x, int y) const{
+	if (x < 0 || y < 0 || x >= _width || y >= _height)
+		return 0.0f;
+	int tx = x / TILE_WIDTH, ty = y / TILE_HEIGHT;
+	return _depth[((size_t)ty * _tiles_x + tx) * TILE_WIDTH * TILE_HEIGHT +
+		(y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH];
+}
+
+void OcclusionCuller::report(ostream &out){
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	double frames = max((size_t)1, _stats.frames);
+	out << fixed << setprecision(1) << "occlusion: " << _stats.occluderTriangles / frames
+		<< " occluder triangles, " << _stats.occluded / frames << " of " << _stats.tested / frames
+		<< " boxes hidden per frame, " << setprecision(3) << _stats.rasterSeconds / frames * 1000.0
+		<< " ms rasterizing and " << _stats.testSeconds / frames * 1000.0 << " ms testing on "
+		<< threads() << " threads" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,67 @@
+//this file contains the stencil based overdraw counter
+#include "../include/overdraw.h"
+
+#include <algorithm>
+#include <iomanip>
+
+void OverdrawSample::add(const OverdrawSample &other){
+	frames += other.frames;
+	fragments += other.fragments;
+	pixels += other.pixels;
+	maxLayers = max(maxLayers, other.maxLayers);
+}
+
+bool OverdrawCounter::begin(){
+	//the size can only be asked for when there is a stencil attachment
+	GLint type = GL_NONE, bits = 0;
+	glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_STENCIL,
+		GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+	if (type != GL_NONE)
+		glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_STENCIL,
+			GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &bits);
+	if (bits == 0)
+		return false;
+	glClearStencil(0);
+	glStencilMask(0xFF);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	glEnable(GL_STENCIL_TEST);
+	//count on depth pass, fragments that fail it are never shaded with early depth
+	//testing
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+	return true;
+}
+
+OverdrawSample OverdrawCounter::end(int width, int height){
+	glDisable(GL_STENCIL_TEST);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	OverdrawSample sample = {1, 0, 0, 0};
+	if (width <= 0 || height <= 0)
+		return sample;
+	static vector<unsigned char> counts;
+	counts.resize((size_t)width * height);
+	GLint alignment = 4;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &counts[0]);
+	glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+	for (size_t i = 0; i < counts.size(); i ++) {
+		if (counts[i] == 0)
+			continue;
+		sample.fragments += counts[i];
+		sample.pixels ++;
+		sample.maxLayers = max(sample.maxLayers, (int)counts[i]);
+	}
+	return sample;
+}
+
+void OverdrawCounter::report(const OverdrawSample &sample, const char *label, ostream &out){
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(2) << "overdraw (" << label << "): " << sample.perPixel()
+		<< " fragments shaded per covered pixel, " << sample.pixels / max(sample.frames, (size_t)1)
+		<< " pixels covered, at most " << sample.maxLayers << " layers over "
+		<< sample.frames << " frames" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,54 @@
+//this file contains the stb_image parallel_for hook
+#include "../include/parallel_decode.h"
+#include "../include/stb_image.h"
+#include "../include/job_system.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+int ParallelDecode::_threads = 1;
+
+//threads take the next task until every task is done, the caller works too. The
+//workers of the job system take them when it runs, instead of new threads per image
+static void parallelFor(void *user, int count, stbi_parallel_task *task, void *taskUser){
+	if (JobSystem::running())
+	{
+		JobSystem::parallelFor(0, count, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i ++)
+				task(taskUser, (int)i);
+		}, 1);
+		return;
+	}
+	int threads = min(*(int *)user, count);
+	atomic<int> next_task(0);
+	auto work = [&]() {
+		for (int i = next_task++; i < count; i = next_task++)
+			task(taskUser, i);
+	};
+	vector<thread> workers;
+	for (int t = 1; t < threads; t ++)
+		workers.push_back(thread(work));
+	work();
+	for (size_t t = 0; t < workers.size(); t ++)
+		workers[t].join();
+}
+
+void ParallelDecode::enable(int threads){
+	if (threads <= 0)
+		threads = max(1u, thread::hardware_concurrency());
+	_threads = threads;
+	stbi_set_parallel_for(threads > 1 ? parallelFor : NULL, &_threads);
+}
+
+void ParallelDecode::disable(){
+	_threads = 1;
+	stbi_set_parallel_for(NULL, NULL);
+}
+
+int ParallelDecode::threads(){
+	return _threads;
+}
@@ -0,0 +1,288 @@
+//this file contains the texture and mesh cache
+#include "../include/resource_manager.h"
+#include "../include/config.h"
+#include "../include/gpu_memory.h"
+#include "../include/hash.h"
+#include "../include/asset_pack.h"
+#include "../include/mesh_file.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <iomanip>
+#ifdef _WIN32
+#include <ctype.h>
+#endif
+
+static ResourceStats texture_stats = {0, 0, 0, 0, 0};
+static ResourceStats mesh_stats = {0, 0, 0, 0, 0};
+
+//function statics so that handles held by globals can still be released at exit
+static map<string, weak_ptr<TextureResource> > &texturePaths(){
+	static map<string, weak_ptr<TextureResource> > cache;
+	return cache;
+}
+
+static map<uint64_t, weak_ptr<TextureResource> > &textureContents(){
+	static map<uint64_t, weak_ptr<TextureResource> > cache;
+	return cache;
+}
+
+static map<uint64_t, weak_ptr<MeshResource> > &meshContents(){
+	static map<uint64_t, weak_ptr<MeshResource> > cache;
+	return cache;
+}
+
+//drop the entries of resources whose last handle is gone
+template <class Key, class T>
+static void prune(map<Key, weak_ptr<T> > &cache){
+	for (typename map<Key, weak_ptr<T> >::iterator it = cache.begin(); it != cache.end();)
+		if (it->second.expired())
+			cache.erase(it ++);
+		else
+			++ it;
+}
+
+TextureResource::~TextureResource(){
+	GpuMemory::deleteTexture(id);
+}
+
+MeshResource::~MeshResource(){
+	glDeleteVertexArrays(1, &vao);
+	GpuMemory::deleteBuffer(vbo);
+	if (ebo != 0)
+		GpuMemory::deleteBuffer(ebo);
+}
+
+string ResourceManager::canonicalPath(const char *path){
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, path, _MAX_PATH) == NULL)
+		return path;
+	//file names are case insensitive and both slashes separate directories
+	string result = buffer;
+	for (size_t i = 0; i < result.size(); i ++)
+		result[i] = result[i] == '/' ? '\\' : (char)tolower((unsigned char)result[i]);
+	return result;
+#else
+	char *resolved = realpath(path, NULL);
+	if (resolved == NULL)
+		return path;
+	string result = resolved;
+	free(resolved);
+	return result;
+#endif
+}
+
+//--------------------------------textures----------------------------------//
+
+TextureHandle ResourceManager::texture(const char *path, BCFormat compression, bool srgb,
+	MipFilter mipFilter){
+	string canonical = canonicalPath(path);
+	//the same file loaded with other settings is another texture
+	uint64_t settings = (uint64_t)compression << 8 | (uint64_t)srgb << 4 | (uint64_t)mipFilter;
+	string key = canonical + "|" + to_string(settings);
+
+	map<string, weak_ptr<TextureResource> >::iterator found = texturePaths().find(key);
+	TextureHandle handle;
+	if (found != texturePaths().end() && (handle = found->second.lock()))
+	{
+		texture_stats.pathHits ++;
+		texture_stats.bytesSaved += GpuMemory::textureBytes(handle->id);
+		texture_stats.decodeBytesSaved += handle->fileBytes;
+		return handle;
+	}
+
+	//read once, a prefetched file arrives here and is hashed and decoded from memory
+	AssetData file;
+	uint64_t content = 0;
+	if (Vfs::read(path, file) && file.size() > 0)
+	{
+		content = hash64(file.data(), file.size(), settings);
+		map<uint64_t, weak_ptr<TextureResource> >::iterator same = textureContents().find(content);
+		//the size guards against the unlikely hash collision
+		if (same != textureContents().end() && (handle = same->second.lock()) &&
+			handle->fileBytes == file.size())
+		{
+			texture_stats.contentHits ++;
+			texture_stats.bytesSaved += GpuMemory::textureBytes(handle->id);
+			texture_stats.decodeBytesSaved += file.size();
+			texturePaths()[key] = handle;
+			cout << path << " has the same content as " << handle->path
+				<< ", sharing its texture" << endl;
+			return handle;
+		}
+	}
+
+	prune(texturePaths());
+	prune(textureContents());
+	handle = make_shared<TextureResource>();
+	handle->id = GpuMemory::genTexture(GPU_TEXTURE, canonical);
+	handle->path = canonical;
+	handle->hash = content;
+	handle->fileBytes = file.size();
+	configTexture(path, file, handle->id, compression, srgb, true, mipFilter);
+	texture_stats.loads ++;
+	//a texture that failed to load isn't cached, so that a later request tries again,
+	//dropping the handle deletes its GL texture
+	if (file.size() == 0 || GpuMemory::textureBytes(handle->id) == 0)
+		return TextureHandle();
+	texturePaths()[key] = handle;
+	textureContents()[content] = handle;
+	return handle;
+}
+
+//---------------------------------meshes-----------------------------------//
+
+MeshHandle ResourceManager::mesh(const string &label, const float *vertices, int vertexCount,
+	const vector<int> &layout){
+	int stride = 0;
+	for (size_t i = 0; i < layout.size(); i ++)
+		stride += layout[i];
+	size_t bytes = (size_t)vertexCount * stride * sizeof(float);
+	//the layout seeds the hash, the same floats read another way are another mesh
+	uint64_t content = hash64(layout.empty() ? NULL : &layout[0], layout.size() * sizeof(int));
+	content = hash64(vertices, bytes, content);
+
+	map<uint64_t, weak_ptr<MeshResource> >::iterator same = meshContents().find(content);
+	MeshHandle handle;
+	if (same != meshContents().end() && (handle = same->second.lock()) &&
+		handle->vertexCount == vertexCount)
+	{
+		mesh_stats.contentHits ++;
+		mesh_stats.bytesSaved += GpuMemory::bufferBytes(handle->vbo);
+		return handle;
+	}
+
+	prune(meshContents());
+	handle = make_shared<MeshResource>();
+	handle->vertexCount = vertexCount;
+	handle->hash = content;
+	handle->ebo = 0;
+	handle->indexCount = 0;
+	handle->indexType = GL_UNSIGNED_INT;
+	memset(handle->boundsMin, 0, sizeof(handle->boundsMin));
+	memset(handle->boundsMax, 0, sizeof(handle->boundsMax));
+	glGenVertexArrays(1, &handle->vao);
+	handle->vbo = GpuMemory::genBuffer(GPU_GEOMETRY, label);
+	glBindVertexArray(handle->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, handle->vbo);
+	GpuMemory::bufferData(GL_ARRAY_BUFFER, handle->vbo, bytes, vertices, GL_STATIC_DRAW);
+	int offset = 0;
+	for (size_t i = 0; i < layout.size(); i ++) {
+		glVertexAttribPointer(i, layout[i], GL_FLOAT, GL_FALSE, stride * sizeof(float),
+			(void*)(offset * sizeof(float)));
+		glEnableVertexAttribArray(i);
+		offset += layout[i];
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	mesh_stats.loads ++;
+	meshContents()[content] = handle;
+	return handle;
+}
+
+MeshHandle ResourceManager::meshAttribute(const string &label, const float *vertices,
+	int vertexCount, const vector<int> &layout, int attribute){
+	if (attribute < 0 || attribute >= (int)layout.size())
+		return MeshHandle();
+	int stride = 0, offset = 0;
+	for (size_t i = 0; i < layout.size(); i ++) {
+		if ((int)i < attribute)
+			offset += layout[i];
+		stride += layout[i];
+	}
+	//copy the attribute out of every vertex, back to back
+	int size = layout[attribute];
+	vector<float> packed((size_t)vertexCount * size);
+	for (int v = 0; v < vertexCount; v ++)
+		for (int c = 0; c < size; c ++)
+			packed[(size_t)v * size + c] = vertices[(size_t)v * stride + offset + c];
+	return mesh(label, packed.empty() ? NULL : &packed[0], vertexCount, vector<int>(1, size));
+}
+
+MeshHandle ResourceManager::meshFile(const char *path){
+	AssetData file;
+	const MeshFileHeader *header = NULL;
+	if (Vfs::read(path, file))
+		header = MeshFile::validate(file.data(), file.size());
+	if (header == NULL)
+	{
+		cout << "ERROR::RESOURCE_MANAGER::INVALID_MESH_FILE: " << path << endl;
+		return MeshHandle();
+	}
+	//the cooker hashed the blobs already, the layout seeds it like in mesh()
+	uint64_t content = hash64(header->layout, sizeof(header->layout), header->hash);
+	map<uint64_t, weak_ptr<MeshResource> >::iterator same = meshContents().find(content);
+	MeshHandle handle;
+	if (same != meshContents().end() && (handle = same->second.lock()) &&
+		handle->vertexCount == (int)header->vertexCount &&
+		handle->indexCount == (int)header->indexCount)
+	{
+		mesh_stats.contentHits ++;
+		mesh_stats.bytesSaved += GpuMemory::bufferBytes(handle->vbo) +
+			GpuMemory::bufferBytes(handle->ebo);
+		return handle;
+	}
+
+	prune(meshContents());
+	handle = make_shared<MeshResource>();
+	handle->vertexCount = (int)header->vertexCount;
+	handle->hash = content;
+	handle->indexCount = (int)header->indexCount;
+	handle->indexType = header->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	memcpy(handle->boundsMin, header->boundsMin, sizeof(handle->boundsMin));
+	memcpy(handle->boundsMax, header->boundsMax, sizeof(handle->boundsMax));
+	string canonical = canonicalPath(path);
+	glGenVertexArrays(1, &handle->vao);
+	handle->vbo = GpuMemory::genBuffer(GPU_GEOMETRY, canonical);
+	handle->ebo = GpuMemory::genBuffer(GPU_GEOMETRY, canonical + " indices");
+	glBindVertexArray(handle->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, handle->vbo);
+	GpuMemory::bufferData(GL_ARRAY_BUFFER, handle->vbo, (size_t)header->vertexBytes,
+		MeshFile::vertices(header), GL_STATIC_DRAW);
+	//the element buffer binding is part of the vertex array
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle->ebo);
+	GpuMemory::bufferData(GL_ELEMENT_ARRAY_BUFFER, handle->ebo, (size_t)header->indexBytes,
+		MeshFile::indices(header), GL_STATIC_DRAW);
+	int stride = MeshFile::stride(header), offset = 0;
+	for (int i = 0; i < MESH_ATTRIBUTE_COUNT; i ++) {
+		if (header->layout[i] == 0)
+			continue;
+		glVertexAttribPointer(i, header->layout[i], GL_FLOAT, GL_FALSE, stride * sizeof(float),
+			(void*)(offset * sizeof(float)));
+		glEnableVertexAttribArray(i);
+		offset += header->layout[i];
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	mesh_stats.loads ++;
+	meshContents()[content] = handle;
+	return handle;
+}
+
+//-------------------------------reporting----------------------------------//
+
+ResourceStats ResourceManager::textureStats(){
+	return texture_stats;
+}
+
+ResourceStats ResourceManager::meshStats(){
+	return mesh_stats;
+}
+
+void ResourceManager::report(ostream &out){
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	double mb = 1024.0 * 1024.0;
+	out << fixed << setprecision(2) << "resources: " << texture_stats.loads
+		<< " textures loaded, " << texture_stats.pathHits << " path hits, "
+		<< texture_stats.contentHits << " content hits, "
+		<< texture_stats.bytesSaved / mb << " MB video memory and "
+		<< texture_stats.decodeBytesSaved / mb << " MB of decoding saved; "
+		<< mesh_stats.loads << " meshes uploaded, " << mesh_stats.contentHits
+		<< " content hits, " << mesh_stats.bytesSaved / mb << " MB saved" << endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -1,5 +1,10 @@
 // this is the shader source code for the shader class
 #include "../include/shader.h"
+#include "../include/asset_pack.h"
+
+PFNGLGETPROGRAMBINARYPROC glGetProgramBinaryPtr = NULL;
+PFNGLPROGRAMBINARYPROC glProgramBinaryPtr = NULL;
+PFNGLPROGRAMPARAMETERIPROC glProgramParameteriPtr = NULL;
 
 //use this shader program
 void Shader::use(){
@@ -31,62 +36,76 @@ void Shader::setMat4(const string &name, mat4 value) const {
 Shader::Shader(const char* vertexPath, const char* fragmentPath){
 		string vertexCode;
 		string fragmentCode;
-		ifstream vShaderFile;
-		ifstream fShaderFile;
-		//check ifstream objects can throw exception
-		vShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
-		fShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
-		try {
-			//open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			stringstream vShaderStream, fShaderStream;
-			//read file's buffer contentes into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			//close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			//cout << vertexCode << endl;
-			fragmentCode = fShaderStream.str();
-			//cout << fragmentCode << endl;
-		} catch (ifstream::failure e) {
-			cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << endl;
+		//read both files, from the asset pack when it is mounted
+		AssetData vShaderFile, fShaderFile;
+		if (Vfs::read(vertexPath, vShaderFile) && Vfs::read(fragmentPath, fShaderFile)) {
+			vertexCode.assign((const char *)vShaderFile.data(), vShaderFile.size());
+			fragmentCode.assign((const char *)fShaderFile.data(), fShaderFile.size());
+		} else {
+			cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << vertexPath << ", "
+				<< fragmentPath << endl;
 		}
 
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+		compile(vertexCode.c_str(), fragmentCode.c_str());
+}
+
+//constructor of an empty shader
+Shader::Shader(){
+	ID = 0;
+}
 
+//compile and link shader source code
+bool Shader::compile(const char *vShaderCode, const char *fShaderCode, bool retrievable){
 		//compile shader
 		int vertex, fragment;
+		bool success = true;
 
 		//vertex shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vShaderCode, NULL);
 		glCompileShader(vertex);
-		checkShaderSuccess(vertex);
+		success &= checkShaderSuccess(vertex);
 		//fragment shader
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
 		glShaderSource(fragment, 1, &fShaderCode, NULL);
 		glCompileShader(fragment);
-		checkShaderSuccess(fragment);
+		success &= checkShaderSuccess(fragment);
 
 		//shader programs
 		ID = glCreateProgram();
+		if (retrievable && glProgramParameteriPtr != NULL)
+			glProgramParameteriPtr(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
 		glLinkProgram(ID);
-		checkLinkSuccess(ID);
+		success &= checkLinkSuccess(ID);
 
 		//delete the shaders as they're linked into the shader program
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+		return success;
+}
+
+//build the program from a driver binary
+bool Shader::loadBinary(GLenum format, const void *binary, int length){
+	if (glProgramBinaryPtr == NULL)
+		return false;
+	ID = glCreateProgram();
+	glProgramBinaryPtr(ID, format, binary, length);
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		//the driver was updated or the binary is broken, fall back to compiling
+		glDeleteProgram(ID);
+		ID = 0;
+		return false;
+	}
+	return true;
 }
 
 // check whether shader is compiled succesfully
-void Shader::checkShaderSuccess(unsigned int shader){
+bool Shader::checkShaderSuccess(unsigned int shader){
 	int success;
 	char infoLog[512];
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -95,12 +114,13 @@ void Shader::checkShaderSuccess(unsigned int shader){
 	{
 		glGetShaderInfoLog(shader, 512, NULL, infoLog);
 		cout << "Shader compilation error\n" << infoLog << endl;
-		return;
+		return false;
 	}
 	cout << "Shader compilation successful" << endl;
+	return true;
 }
 // check whether shader program is succesfully linked
-void Shader::checkLinkSuccess(unsigned int ID){
+bool Shader::checkLinkSuccess(unsigned int ID){
 	int success;
 	char infoLog[512];
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -108,8 +128,9 @@ void Shader::checkLinkSuccess(unsigned int ID){
 	{
 		glGetProgramInfoLog(ID, 512, NULL, infoLog);
 		cout << "Shader Program Linking Error\n" << infoLog << endl;
-		return;
+		return false;
 	}
 
 	cout << "Shader program linking successful" << endl;
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+// this file contains the shader preprocessor and the shader variant cache
+#include "../include/shader_cache.h"
+#include "../include/config.h"
+#include "../include/asset_pack.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+//deepest #include nesting before we assume the includes are recursive
+const int MAX_INCLUDE_DEPTH = 32;
+
+ShaderVariant::ShaderVariant(const string &vertex, const string &fragment,
+	const vector<string> &defs){
+	vertexPath = vertex;
+	fragmentPath = fragment;
+	defines = defs;
+}
+
+//----------------------------preprocessor----------------------------------//
+
+uint64_t ShaderPreprocessor::hash(const string &text, uint64_t seed){
+	uint64_t h = seed;
+	for (size_t i = 0; i < text.size(); i ++) {
+		h ^= (unsigned char)text[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+bool ShaderPreprocessor::expand(const string &path, const vector<string> &defines,
+	string &out, string &error){
+	vector<string> files;
+	string body;
+	out.clear();
+	if (!expandFile(path, 0, files, body, error))
+		return false;
+
+	//put the defines right after #version, glsl requires #version to come first
+	string define_block;
+	for (size_t i = 0; i < defines.size(); i ++)
+		define_block += "#define " + defines[i] + "\n";
+
+	size_t version = body.find("#version");
+	if (version == string::npos) {
+		out = define_block + "#line 1 0\n" + body;
+		return true;
+	}
+	size_t line_end = body.find('\n', version);
+	if (line_end == string::npos) {
+		out = body + "\n" + define_block;
+		return true;
+	}
+	//count lines up to #version so that the #line below keeps numbers correct
+	int version_line = 1;
+	for (size_t i = 0; i < version; i ++)
+		if (body[i] == '\n')
+			version_line ++;
+	out = body.substr(0, line_end + 1) + define_block;
+	out += "#line " + to_string(version_line + 1) + " 0\n";
+	out += body.substr(line_end + 1);
+	return true;
+}
+
+bool ShaderPreprocessor::expandFile(const string &path, int depth, vector<string> &files,
+	string &out, string &error){
+	if (depth > MAX_INCLUDE_DEPTH) {
+		error = "ERROR::SHADER::INCLUDE_TOO_DEEP: " + path;
+		return false;
+	}
+	//include every file only once
+	for (size_t i = 0; i < files.size(); i ++)
+		if (files[i] == path)
+			return true;
+
+	AssetData asset;
+	if (!Vfs::read(path, asset)) {
+		error = "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " + path;
+		return false;
+	}
+	istringstream file(string((const char *)asset.data(), asset.size()));
+	int file_index = files.size();
+	files.push_back(path);
+	//glsl #line takes a source string number, we use the file's index
+	if (depth > 0)
+		out += "#line 1 " + to_string(file_index) + "\n";
+
+	string dir;
+	size_t slash = path.find_last_of("/\\");
+	if (slash != string::npos)
+		dir = path.substr(0, slash + 1);
+
+	string line;
+	int line_number = 0;
+	while (getline(file, line)) {
+		line_number ++;
+		size_t start = line.find_first_not_of(" \t");
+		if (start == string::npos || line.compare(start, 8, "#include") != 0) {
+			out += line;
+			out += '\n';
+			continue;
+		}
+		size_t open = line.find('"', start + 8);
+		size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+		if (close == string::npos) {
+			error = "ERROR::SHADER::BAD_INCLUDE: " + path + ":" + to_string(line_number);
+			return false;
+		}
+		string include_path = dir + line.substr(open + 1, close - open - 1);
+		if (!expandFile(include_path, depth + 1, files, out, error))
+			return false;
+		out += "#line " + to_string(line_number + 1) + " " + to_string(file_index) + "\n";
+	}
+	return true;
+}
+
+//-------------------------------cache-------------------------------------//
+
+ShaderCache::ShaderCache(const char *diskCacheDir){
+	_binary_supported = false;
+	_disk_hits = 0;
+	_compiled = 0;
+	if (diskCacheDir == NULL)
+		return;
+
+	_disk_dir = diskCacheDir;
+	if (hasExtension("GL_ARB_get_program_binary"))
+	{
+		glGetProgramBinaryPtr = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+		glProgramBinaryPtr = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+		glProgramParameteriPtr = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+		_binary_supported = glGetProgramBinaryPtr != NULL && glProgramBinaryPtr != NULL;
+	}
+	if (!_binary_supported)
+	{
+		cout << "Program binaries are not supported, shader disk cache is disabled" << endl;
+		return;
+	}
+#ifdef _WIN32
+	_mkdir(diskCacheDir);
+#else
+	mkdir(diskCacheDir, 0755);
+#endif
+}
+
+ShaderCache::~ShaderCache(){
+	for (map<uint64_t, Shader*>::iterator it = _programs.begin(); it != _programs.end(); ++it) {
+		glDeleteProgram(it->second->ID);
+		delete it->second;
+	}
+}
+
+string ShaderCache::variantKey(const ShaderVariant &variant){
+	string key = variant.vertexPath + "|" + variant.fragmentPath;
+	for (size_t i = 0; i < variant.defines.size(); i ++)
+		key += "|" + variant.defines[i];
+	return key;
+}
+
+Shader *ShaderCache::get(const ShaderVariant &variant){
+	//fast path, this variant has been expanded before
+	string key = variantKey(variant);
+	map<string, uint64_t>::iterator known = _variant_hash.find(key);
+	if (known != _variant_hash.end())
+		return _programs[known->second];
+
+	string vertex_code, fragment_code, error;
+	if (!ShaderPreprocessor::expand(variant.vertexPath, variant.defines, vertex_code, error) ||
+		!ShaderPreprocessor::expand(variant.fragmentPath, variant.defines, fragment_code, error))
+	{
+		cout << error << endl;
+		return NULL;
+	}
+	uint64_t hash = ShaderPreprocessor::hash(fragment_code,
+		ShaderPreprocessor::hash(vertex_code));
+	_variant_hash[key] = hash;
+
+	//another variant may expand to exactly the same source
+	map<uint64_t, Shader*>::iterator found = _programs.find(hash);
+	if (found != _programs.end())
+		return found->second;
+
+	Shader *shader = loadFromDisk(hash);
+	if (shader == NULL)
+	{
+		shader = new Shader();
+		_compiled ++;
+		if (shader->compile(vertex_code.c_str(), fragment_code.c_str(), _binary_supported))
+			saveToDisk(hash, shader);
+	}
+	_programs[hash] = shader;
+	return shader;
+}
+
+void ShaderCache::prewarm(const vector<ShaderVariant> &variants){
+	for (size_t i = 0; i < variants.size(); i ++)
+		get(variants[i]);
+}
+
+int ShaderCache::size(){
+	return _programs.size();
+}
+
+int ShaderCache::diskHits(){
+	return _disk_hits;
+}
+
+int ShaderCache::compiled(){
+	return _compiled;
+}
+
+string ShaderCache::binaryPath(uint64_t hash){
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	return _disk_dir + "/" + name;
+}
+
+//disk cache file layout: GLenum binary format, int length, then the binary
+Shader *ShaderCache::loadFromDisk(uint64_t hash){
+	if (!_binary_supported)
+		return NULL;
+	FILE *file = fopen(binaryPath(hash).c_str(), "rb");
+	if (file == NULL)
+		return NULL;
+
+	GLenum format;
+	int length;
+	Shader *shader = NULL;
+	if (fread(&format, sizeof(format), 1, file) == 1 &&
+		fread(&length, sizeof(length), 1, file) == 1 && length > 0)
+	{
+		vector<char> binary(length);
+		if (fread(&binary[0], 1, length, file) == (size_t)length)
+		{
+			shader = new Shader();
+			if (shader->loadBinary(format, &binary[0], length))
+				_disk_hits ++;
+			else
+			{
+				delete shader;
+				shader = NULL;
+			}
+		}
+	}
+	fclose(file);
+	return shader;
+}
+
+void ShaderCache::saveToDisk(uint64_t hash, Shader *shader){
+	if (!_binary_supported || shader->ID == 0)
+		return;
+	int length = 0;
+	glGetProgramiv(shader->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinaryPtr(shader->ID, length, &length, &format, &binary[0]);
+	FILE *file = fopen(binaryPath(hash).c_str(), "wb");
+	if (file == NULL)
+		return;
+	fwrite(&format, sizeof(format), 1, file);
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(&binary[0], 1, length, file);
+	fclose(file);
+}
@@ -0,0 +1,368 @@
+//this file contains the texture streamer, mips are decoded on a worker thread and
+//uploaded on the GL thread in update()
+#include "../include/texture_streamer.h"
+#include "../include/stb_image.h"
+#include "../include/gpu_memory.h"
+#include "../include/mip_builder.h"
+#include "../include/asset_pack.h"
+
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+TextureStreamer::TextureStreamer(size_t budgetBytes, int initialMips, size_t uploadPerFrame){
+	_budget = budgetBytes;
+	_init_mips = max(1, initialMips);
+	_upload_per_frame = uploadPerFrame;
+	_resident_bytes = 0;
+	_failed_loads = 0;
+	_frame = 0;
+	_in_flight = 0;
+	_quit = false;
+	//every texture is loaded upside down so that (0, 0) is the bottom left corner
+	stbi_set_flip_vertically_on_load(true);
+	_worker = thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer(){
+	{
+		lock_guard<mutex> guard(_lock);
+		_quit = true;
+	}
+	_wake.notify_all();
+	_worker.join();
+	for (size_t i = 0; i < _textures.size(); i ++)
+		GpuMemory::deleteTexture(_textures[i].id);
+}
+
+size_t TextureStreamer::levelBytes(const Texture &texture, int level){
+	size_t width = max(1, texture.width >> level);
+	size_t height = max(1, texture.height >> level);
+	return width * height * 4;
+}
+
+int TextureStreamer::load(const char *path){
+	int width, height, channels;
+	AssetData file;
+	if (!Vfs::read(path, file) ||
+		!stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &channels))
+	{
+		cout << "Failed to load texture " << path << endl;
+		return -1;
+	}
+
+	Texture texture;
+	texture.path = path;
+	texture.width = width;
+	texture.height = height;
+	texture.levels = 1 + (int)floor(log2((double)max(width, height)));
+	texture.resident = texture.levels - 1;
+	texture.desired = texture.levels - 1;
+	texture.requested = texture.levels;
+	texture.lastUsed = _frame;
+	texture.bytes = 4;
+	texture.placeholder = true;
+	texture.failed = false;
+
+	//a grey 1x1 placeholder in the smallest mip keeps the texture complete until the
+	//first mips arrive
+	const unsigned char grey[4] = {128, 128, 128, 255};
+	texture.id = GpuMemory::genTexture(GPU_TEXTURE, path);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.resident);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+	GpuMemory::texImage2D(GL_TEXTURE_2D, texture.id, texture.levels - 1, GL_RGBA, 1, 1,
+		GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	_resident_bytes += texture.bytes;
+
+	int handle = _textures.size();
+	_textures.push_back(texture);
+	//the initial mips are always wanted
+	if (texture.levels > 1)
+		_textures[handle].desired = max(0, texture.levels - _init_mips);
+	return handle;
+}
+
+void TextureStreamer::requestSize(int handle, float screenPixels){
+	Texture &texture = _textures[handle];
+	texture.lastUsed = _frame;
+	//one texel per pixel is enough, finer mips would be minified anyway
+	float texels = (float)max(texture.width, texture.height);
+	int level = 0;
+	if (screenPixels > 0.0f && texels > screenPixels)
+		level = (int)floor(log2(texels / screenPixels));
+	texture.desired = min(level, max(0, texture.levels - _init_mips));
+}
+
+void TextureStreamer::update(){
+	//upload finished mips, limited per frame so a burst of loads doesn't stall a frame
+	size_t uploaded = 0;
+	while (uploaded < _upload_per_frame)
+	{
+		Result result;
+		{
+			lock_guard<mutex> guard(_lock);
+			if (_results.empty())
+				break;
+			result = std::move(_results.front());
+			_results.pop_front();
+			_in_flight --;
+		}
+		for (size_t i = 0; i < result.mips.size(); i ++)
+			uploaded += result.mips[i].size();
+		upload(result);
+	}
+
+	//drop mips of textures that were not used for the longest time
+	if (_resident_bytes > _budget)
+		evict(_budget);
+
+	//bytes that could be freed from textures that were not used this frame
+	size_t stale = 0;
+	for (size_t i = 0; i < _textures.size(); i ++) {
+		const Texture &texture = _textures[i];
+		if (texture.lastUsed != _frame)
+			for (int level = texture.resident; level < texture.levels - _init_mips; level ++)
+				stale += levelBytes(texture, level);
+	}
+
+	//queue loads for textures that need finer mips and fit into the budget
+	size_t expected = _resident_bytes;
+	vector<Request> requests;
+	for (size_t i = 0; i < _textures.size(); i ++) {
+		Texture &texture = _textures[i];
+		if (texture.requested != texture.levels || texture.failed ||
+			(texture.desired >= texture.resident && !texture.placeholder))
+			continue;
+		//recently used textures may push stale ones out, but never each other, so
+		//when the wanted mips don't fit we settle for the finest ones that do
+		size_t available = _budget + stale > expected ? _budget + stale - expected : 0;
+		size_t bytes = 0;
+		int first = texture.resident;
+		while (first > texture.desired) {
+			size_t next = bytes + levelBytes(texture, first - 1);
+			if (next > available && texture.lastUsed == _frame &&
+				first - 1 < texture.levels - _init_mips)
+				break;
+			bytes = next;
+			first --;
+		}
+		if (first == texture.resident && !texture.placeholder)
+			continue;
+		expected += bytes;
+		Request request;
+		request.handle = i;
+		request.path = texture.path;
+		request.width = texture.width;
+		request.height = texture.height;
+		request.first = first;
+		request.last = lastMissing(texture);
+		texture.requested = first;
+		requests.push_back(request);
+	}
+	if (!requests.empty())
+	{
+		{
+			lock_guard<mutex> guard(_lock);
+			_in_flight += requests.size();
+		}
+		//the files of this frame are read in one batch, each one goes to the decode
+		//thread as soon as it arrives
+		for (size_t i = 0; i < requests.size(); i ++) {
+			Request request = requests[i];
+			_io.read(request.path, [this, request](const string &, AssetData &data, bool) {
+				Request loaded = request;
+				loaded.file = make_shared<AssetData>();
+				loaded.file->swap(data);
+				{
+					lock_guard<mutex> guard(_lock);
+					_requests.push_back(loaded);
+				}
+				_wake.notify_one();
+			});
+		}
+		_io.submit();
+	}
+
+	_frame ++;
+}
+
+void TextureStreamer::upload(Result &result){
+	Texture &texture = _textures[result.handle];
+	texture.requested = texture.levels;
+	//a corrupt file would be read and decoded again every frame
+	if (result.mips.empty())
+	{
+		texture.failed = true;
+		_failed_loads ++;
+		return;
+	}
+	//mips evicted while this load was in flight would leave a hole in the chain
+	int last = lastMissing(texture);
+	if (result.last < last)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = last; level >= result.first; level --) {
+		int width = max(1, texture.width >> level);
+		int height = max(1, texture.height >> level);
+		GpuMemory::texImage2D(GL_TEXTURE_2D, texture.id, level, GL_RGBA, width, height,
+			GL_RGBA, GL_UNSIGNED_BYTE, &result.mips[level - result.first][0]);
+		//the placeholder took the same 1x1 texel
+		if (level >= texture.resident)
+			continue;
+		texture.bytes += levelBytes(texture, level);
+		_resident_bytes += levelBytes(texture, level);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	texture.placeholder = false;
+	texture.resident = min(texture.resident, result.first);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.resident);
+}
+
+//the coarsest level a load has to bring, the placeholder is replaced by the first one
+int TextureStreamer::lastMissing(const Texture &texture){
+	return texture.placeholder ? texture.levels - 1 : texture.resident - 1;
+}
+
+//comparison used to sort textures from least to most recently used
+struct LeastRecentlyUsed {
+	const vector<unsigned long> *lastUsed;
+	bool operator()(int a, int b) const {
+		return (*lastUsed)[a] < (*lastUsed)[b];
+	}
+};
+
+void TextureStreamer::evict(size_t target){
+	vector<int> order;
+	vector<unsigned long> last_used(_textures.size());
+	for (size_t i = 0; i < _textures.size(); i ++) {
+		last_used[i] = _textures[i].lastUsed;
+		if (_textures[i].resident < _textures[i].levels - _init_mips)
+			order.push_back(i);
+	}
+	LeastRecentlyUsed compare;
+	compare.lastUsed = &last_used;
+	sort(order.begin(), order.end(), compare);
+
+	for (size_t i = 0; i < order.size() && _resident_bytes > target; i ++) {
+		Texture &texture = _textures[order[i]];
+		glBindTexture(GL_TEXTURE_2D, texture.id);
+		//drop the finest mips one by one, but keep the initial mips
+		while (_resident_bytes > target && texture.resident < texture.levels - _init_mips) {
+			size_t bytes = levelBytes(texture, texture.resident);
+			//respecifying a level with size 0 releases its storage
+			GpuMemory::texImage2D(GL_TEXTURE_2D, texture.id, texture.resident, GL_RGBA,
+				0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			texture.resident ++;
+			texture.bytes -= bytes;
+			_resident_bytes -= bytes;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.resident);
+		}
+		if (texture.desired < texture.resident && texture.lastUsed != _frame)
+			texture.desired = texture.resident;
+	}
+}
+
+void TextureStreamer::workerLoop(){
+	while (true)
+	{
+		Request request;
+		{
+			unique_lock<mutex> guard(_lock);
+			while (!_quit && _requests.empty())
+				_wake.wait(guard);
+			if (_quit)
+				return;
+			request = _requests.front();
+			_requests.pop_front();
+		}
+		Result result;
+		decode(request, result);
+		_io.recycle(*request.file);
+		lock_guard<mutex> guard(_lock);
+		_results.push_back(std::move(result));
+	}
+}
+
+void TextureStreamer::decode(const Request &request, Result &result){
+	result.handle = request.handle;
+	result.first = request.first;
+	result.last = request.last;
+
+	//start at the finest requested mip, JPEGs decode straight to 1/2, 1/4 or 1/8
+	//size with a reduced IDCT
+	int scale = min(request.first, 3);
+	int width, height, channels;
+	const AssetData &file = *request.file;
+	unsigned char *data = NULL;
+	if (file.size() > 0)
+		data = stbi_load_scaled_from_memory(file.data(), (int)file.size(), scale, &width,
+			&height, &channels, STBI_rgb_alpha);
+	//the decoder rounds sizes up, mips round down, so crop the extra row/column
+	int mip_width = max(1, request.width >> scale), mip_height = max(1, request.height >> scale);
+	if (data == NULL || width < mip_width || height < mip_height)
+	{
+		cout << "Failed to stream texture " << request.path << endl;
+		stbi_image_free(data);
+		return;
+	}
+	//the image is flipped, so the partial row of the file's last one is first in memory
+	const unsigned char *top = data + (size_t)(height - mip_height) * width * 4;
+	//the coarser mips are filtered from the decoded one, on this thread only
+	vector<MipLevel> levels;
+	MipOptions options;
+	options.threads = 1;
+	MipBuilder::build(top, mip_width, mip_height, width * 4, 4, levels, options);
+	for (int level = request.first; level <= request.last; level ++) {
+		result.mips.push_back(vector<unsigned char>());
+		if (level > scale)
+		{
+			result.mips.back().swap(levels[level - scale - 1].pixels);
+			continue;
+		}
+		vector<unsigned char> &level_data = result.mips.back();
+		level_data.resize((size_t)mip_width * mip_height * 4);
+		for (int y = 0; y < mip_height; y ++)
+			memcpy(&level_data[(size_t)y * mip_width * 4], top + (size_t)y * width * 4,
+				(size_t)mip_width * 4);
+	}
+	stbi_image_free(data);
+}
+
+unsigned int TextureStreamer::textureID(int handle){
+	return _textures[handle].id;
+}
+
+int TextureStreamer::residentLevel(int handle){
+	return _textures[handle].resident;
+}
+
+size_t TextureStreamer::residentBytes(){
+	return _resident_bytes;
+}
+
+int TextureStreamer::queueDepth(){
+	lock_guard<mutex> guard(_lock);
+	return _in_flight;
+}
+
+int TextureStreamer::failedLoads(){
+	return _failed_loads;
+}
+
+void TextureStreamer::setBudget(size_t budgetBytes){
+	_budget = budgetBytes;
+}
+
+float TextureStreamer::projectedSize(float worldSize, float distance, float fov, int viewportHeight){
+	if (distance <= 0.0001f)
+		return (float)viewportHeight;
+	return worldSize / (2.0f * distance * tan(fov * 0.5f)) * viewportHeight;
+}
@@ -0,0 +1,94 @@
+//this file contains the packer that bundles a directory into an asset pack, see
+//asset_pack.h. The build runs it on resources/:
+//	asset_packer [--store] directory pack
+//--store keeps every entry uncompressed
+#include "../include/asset_pack.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+//every file under dir, names relative to the packed root with '/' separators
+static void listFiles(const string &dir, const string &prefix, vector<PackSource> &files){
+#ifdef _WIN32
+	_finddata_t data;
+	intptr_t find = _findfirst((dir + "\\*").c_str(), &data);
+	if (find == -1)
+		return;
+	do {
+		string name = data.name;
+		if (name == "." || name == "..")
+			continue;
+		if (data.attrib & _A_SUBDIR)
+			listFiles(dir + "\\" + name, prefix + name + "/", files);
+		else
+		{
+			PackSource source = {dir + "\\" + name, prefix + name};
+			files.push_back(source);
+		}
+	} while (_findnext(find, &data) == 0);
+	_findclose(find);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (d == NULL)
+		return;
+	while (dirent *e = readdir(d)) {
+		string name = e->d_name;
+		if (name == "." || name == "..")
+			continue;
+		string path = dir + "/" + name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			listFiles(path, prefix + name + "/", files);
+		else if (S_ISREG(st.st_mode))
+		{
+			PackSource source = {path, prefix + name};
+			files.push_back(source);
+		}
+	}
+	closedir(d);
+#endif
+}
+
+static bool nameLess(const PackSource &a, const PackSource &b){
+	return a.name < b.name;
+}
+
+int main(int argc, char **argv){
+	bool compress = true;
+	vector<string> args;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "--store") == 0)
+			compress = false;
+		else
+			args.push_back(argv[i]);
+	}
+	if (args.size() != 2)
+	{
+		cout << "usage: asset_packer [--store] directory pack" << endl;
+		return 1;
+	}
+
+	vector<PackSource> files;
+	listFiles(args[0], "", files);
+	if (files.empty())
+	{
+		cout << "ERROR::ASSET_PACK::NO_FILES: " << args[0] << endl;
+		return 1;
+	}
+	//files of a directory end up next to each other in the pack
+	sort(files.begin(), files.end(), nameLess);
+	return AssetPack::write(args[1].c_str(), files, compress) ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+//this file contains the cooker that turns an OBJ or glTF mesh into the binary format the
+//program loads, see mesh_file.h:
+//	mesh_cooker [-t threads] input.obj|input.gltf|input.glb output.mesh
+//-t sets the threads that parse OBJ text, every core by default
+#include "../include/mesh_import.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+int main(int argc, char **argv){
+	int threads = 0;
+	vector<string> args;
+	for (int i = 1; i < argc; i ++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else
+			args.push_back(argv[i]);
+	}
+	if (args.size() != 2)
+	{
+		cout << "usage: mesh_cooker [-t threads] input.obj|input.gltf|input.glb output.mesh"
+			<< endl;
+		return 1;
+	}
+
+	MeshData mesh;
+	MeshImportStats stats;
+	if (!MeshImporter::import(args[0].c_str(), mesh, &stats, threads))
+		return 1;
+	stats.report();
+	if (!MeshFile::write(args[1].c_str(), mesh))
+	{
+		cout << "ERROR::MESH_FILE::NOT_WRITTEN: " << args[1] << endl;
+		return 1;
+	}
+	return 0;
+}